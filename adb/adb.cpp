@@ -33,6 +33,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -176,13 +177,18 @@ void print_packet(const char *label, apacket *p)
 }
 #endif
 
-static void send_ready(unsigned local, unsigned remote, atransport *t)
-{
+static void send_ready(unsigned local, unsigned remote, atransport* t,
+                       std::optional<uint32_t> acked_bytes = std::nullopt) {
     D("Calling send_ready");
     apacket *p = get_apacket();
     p->msg.command = A_OKAY;
     p->msg.arg0 = local;
     p->msg.arg1 = remote;
+    if (acked_bytes) {
+        p->payload.resize(sizeof(*acked_bytes));
+        memcpy(p->payload.data(), &*acked_bytes, sizeof(*acked_bytes));
+        p->msg.data_length = p->payload.size();
+    }
     send_packet(p, t);
 }
 
@@ -346,7 +352,7 @@ void handle_packet(apacket *p, atransport *t)
             ((char*) (&(p->msg.command)))[2],
             ((char*) (&(p->msg.command)))[3]);
     print_packet("recv", p);
-    CHECK_EQ(p->payload.size(), p->msg.data_length);
+    CHECK_EQ(p->payload_size(), p->msg.data_length);
 
     switch(p->msg.command){
     case A_CNXN:  // CONNECT(version, maxdata, "system-id-string")
@@ -404,8 +410,16 @@ void handle_packet(apacket *p, atransport *t)
         }
         break;
 
-    case A_OPEN: /* OPEN(local-id, 0, "destination") */
-        if (t->online && p->msg.arg0 != 0 && p->msg.arg1 == 0) {
+    case A_OPEN: /* OPEN(local-id, [receive-window], "destination") */
+        if (t->online && p->msg.arg0 != 0) {
+            // With delayed acks, arg1 is the opener's receive window. Otherwise, it's always 0.
+            if (t->SupportsDelayedAck() != (p->msg.arg1 != 0)) {
+                LOG(ERROR) << "unexpected A_OPEN arg1 " << p->msg.arg1 << " (delayed acks "
+                           << (t->SupportsDelayedAck() ? "enabled" : "disabled") << ")";
+                send_close(0, p->msg.arg0, t);
+                break;
+            }
+
             std::string_view address(p->payload.begin(), p->payload.size());
 
             // Historically, we received service names as a char*, and stopped at the first NUL
@@ -419,24 +433,54 @@ void handle_packet(apacket *p, atransport *t)
             } else {
                 s->peer = create_remote_socket(p->msg.arg0, t);
                 s->peer->peer = s;
-                send_ready(s->id, s->peer->id, t);
+                if (t->SupportsDelayedAck()) {
+                    s->peer->available_send_bytes = p->msg.arg1;
+                    send_ready(s->id, s->peer->id, t, INITIAL_DELAYED_ACK_BYTES);
+                } else {
+                    send_ready(s->id, s->peer->id, t);
+                }
                 s->ready(s);
             }
         }
         break;
 
-    case A_OKAY: /* READY(local-id, remote-id, "") */
+    case A_OKAY: /* READY(local-id, remote-id, [acknowledged-bytes]) */
         if (t->online && p->msg.arg0 != 0 && p->msg.arg1 != 0) {
+            // With delayed acks, the payload is the number of bytes being acknowledged, or the
+            // size of the sender's receive window in the first READY message of a stream.
+            std::optional<uint32_t> acked_bytes;
+            if (t->SupportsDelayedAck()) {
+                if (p->payload.size() != sizeof(uint32_t)) {
+                    LOG(ERROR) << "invalid A_OKAY payload size: " << p->payload.size();
+                    break;
+                }
+                acked_bytes.emplace();
+                memcpy(&*acked_bytes, p->payload.data(), sizeof(*acked_bytes));
+            }
+
             asocket* s = find_local_socket(p->msg.arg1, 0);
             if (s) {
                 if(s->peer == nullptr) {
                     /* On first READY message, create the connection. */
                     s->peer = create_remote_socket(p->msg.arg0, t);
                     s->peer->peer = s;
+                    if (acked_bytes) {
+                        s->peer->available_send_bytes = *acked_bytes;
+                    }
                     s->ready(s);
                 } else if (s->peer->id == p->msg.arg0) {
                     /* Other READY messages must use the same local-id */
-                    s->ready(s);
+                    if (acked_bytes && s->peer->available_send_bytes) {
+                        // Only wake the socket up if it was waiting for the window to open.
+                        int64_t& available = *s->peer->available_send_bytes;
+                        bool was_blocked = available <= 0;
+                        available += *acked_bytes;
+                        if (was_blocked && available > 0) {
+                            s->ready(s);
+                        }
+                    } else {
+                        s->ready(s);
+                    }
                 } else {
                     D("Invalid A_OKAY(%d,%d), expected A_OKAY(%d,%d) on transport %s", p->msg.arg0,
                       p->msg.arg1, s->peer->id, p->msg.arg1, t->serial.c_str());
@@ -479,9 +523,30 @@ void handle_packet(apacket *p, atransport *t)
             asocket* s = find_local_socket(p->msg.arg1, p->msg.arg0);
             if (s) {
                 unsigned rid = p->msg.arg0;
-                if (s->enqueue(s, std::move(p->payload)) == 0) {
+
+                // With delayed acks, received bytes are acknowledged once they've been delivered,
+                // rather than one WRITE at a time.
+                asocket* remote = s->peer;
+                bool delayed_ack = remote && remote->available_send_bytes;
+                if (delayed_ack) {
+                    remote->unacknowledged_bytes += p->payload_size();
+                }
+
+                int rc;
+                if (p->payload_chain.empty()) {
+                    rc = s->enqueue(s, std::move(p->payload));
+                } else if (s->enqueue_chain) {
+                    rc = s->enqueue_chain(s, std::move(p->payload_chain));
+                } else {
+                    rc = s->enqueue(s, std::move(p->payload_chain).coalesce());
+                }
+                if (rc == 0) {
                     D("Enqueue the socket");
-                    send_ready(s->id, rid, t);
+                    if (delayed_ack) {
+                        remote->ready(remote);
+                    } else {
+                        send_ready(s->id, rid, t);
+                    }
                 }
             }
         }
@@ -34,6 +34,9 @@ constexpr size_t MAX_PAYLOAD_V1 = 4 * 1024;
 constexpr size_t MAX_PAYLOAD = 1024 * 1024;
 constexpr size_t MAX_FRAMEWORK_PAYLOAD = 64 * 1024;
 
+// The receive window each side of a stream grants the other when delayed acks are in use.
+constexpr size_t INITIAL_DELAYED_ACK_BYTES = 8 * 1024 * 1024;
+
 constexpr size_t LINUX_MAX_SOCKET_SIZE = 4194304;
 
 #define A_SYNC 0x434e5953
@@ -64,7 +67,7 @@ constexpr size_t LINUX_MAX_SOCKET_SIZE = 4194304;
 std::string adb_version();
 
 // Increment this when we want to force users to start a new adb server.
-#define ADB_SERVER_VERSION 41
+#define ADB_SERVER_VERSION 43
 
 using TransportId = uint64_t;
 class atransport;
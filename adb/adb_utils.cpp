@@ -224,7 +224,11 @@ std::string dump_packet(const char* name, const char* func, const apacket* p) {
     result += func;
     result += ": ";
     result += dump_header(&p->msg);
-    result += dump_hex(p->payload.data(), p->payload.size());
+    if (p->payload_chain.empty()) {
+        result += dump_hex(p->payload.data(), p->payload.size());
+    } else {
+        result += dump_hex(p->payload_chain.front_data(), p->payload_chain.front_size());
+    }
     return result;
 }
 
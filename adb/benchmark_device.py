@@ -93,7 +93,11 @@ def benchmark_source(device=None, size_mb=100):
 
     analyze("source %dMiB" % size_mb, speeds)
 
-def benchmark_push(device=None, file_size_mb=100):
+def link_type(device):
+    # Network devices are serials of the form host:port.
+    return "tcp" if device.serial and ":" in device.serial else "usb"
+
+def benchmark_push(device=None, file_size_mb=100, compression="any"):
     if device == None:
         device = adb.get_device()
 
@@ -106,13 +110,44 @@ def benchmark_push(device=None, file_size_mb=100):
     speeds = list()
     for _ in range(0, 10):
         begin = time.time()
-        device.push(local=local_path, remote=remote_path)
+        subprocess.check_call(device.adb_cmd + ["push", "-z", compression, local_path, remote_path],
+                              stdout=subprocess.DEVNULL)
         end = time.time()
         speeds.append(file_size_mb / float(end - begin))
 
-    analyze("push %dMiB" % file_size_mb, speeds)
+    analyze("push %dMiB (%s, %s)" % (file_size_mb, compression, link_type(device)), speeds)
+
+def benchmark_push_small_files(device=None, file_count=4096, file_size_kb=4):
+    if device == None:
+        device = adb.get_device()
+
+    remote_path = "/data/local/tmp/adb_benchmark_small_files"
+
+    with tempfile.TemporaryDirectory() as local_path:
+        # Spread the files over a tree of directories, like a native test suite.
+        for i in range(0, file_count):
+            directory = os.path.join(local_path, "dir%d" % (i % 64), "sub%d" % (i % 8))
+            os.makedirs(directory, exist_ok=True)
+            with open(os.path.join(directory, "file%d" % i), "wb") as f:
+                f.write(os.urandom(file_size_kb * 1024))
+
+        speeds = list()
+        for _ in range(0, 10):
+            device.shell(["rm", "-rf", remote_path])
+            begin = time.time()
+            device.push(local=local_path, remote=remote_path)
+            end = time.time()
+            speeds.append(file_count / float(end - begin))
+
+        device.shell(["rm", "-rf", remote_path])
 
-def benchmark_pull(device=None, file_size_mb=100):
+    median = statistics.median(speeds)
+    mean = harmonic_mean(speeds)
+    stddev = statistics.stdev(speeds)
+    msg = "push %d x %dKiB: %d runs: median %.1f files/s, mean %.1f files/s, stddev: %.1f files/s"
+    print(msg % (file_count, file_size_kb, len(speeds), median, mean, stddev))
+
+def benchmark_pull(device=None, file_size_mb=100, compression="any"):
     if device == None:
         device = adb.get_device()
 
@@ -124,11 +159,12 @@ def benchmark_pull(device=None, file_size_mb=100):
     speeds = list()
     for _ in range(0, 10):
         begin = time.time()
-        device.pull(remote=remote_path, local=local_path)
+        subprocess.check_call(device.adb_cmd + ["pull", "-z", compression, remote_path, local_path],
+                              stdout=subprocess.DEVNULL)
         end = time.time()
         speeds.append(file_size_mb / float(end - begin))
 
-    analyze("pull %dMiB" % file_size_mb, speeds)
+    analyze("pull %dMiB (%s, %s)" % (file_size_mb, compression, link_type(device)), speeds)
 
 def benchmark_shell(device=None, file_size_mb=100):
     if device == None:
@@ -144,13 +180,39 @@ def benchmark_shell(device=None, file_size_mb=100):
 
     analyze("shell %dMiB" % file_size_mb, speeds)
 
+def benchmark_shell_latency(device=None, count=1000):
+    if device == None:
+        device = adb.get_device()
+
+    # Time single-byte round trips through `cat`, like keystrokes echoed by an interactive shell.
+    proc = subprocess.Popen(device.adb_cmd + ["shell", "cat"], stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE, bufsize=0)
+    latencies = list()
+    for _ in range(0, count):
+        begin = time.time()
+        proc.stdin.write(b"x")
+        proc.stdout.read(1)
+        end = time.time()
+        latencies.append((end - begin) * 1000.0)
+    proc.stdin.close()
+    proc.wait()
+
+    latencies.sort()
+    msg = "shell latency: %d round trips: median %.2f ms, p99 %.2f ms, max %.2f ms"
+    print(msg % (count, statistics.median(latencies), latencies[int(count * 0.99)], latencies[-1]))
+
 def main():
     device = adb.get_device()
     unlock(device)
     benchmark_sink(device)
     benchmark_source(device)
-    benchmark_push(device)
-    benchmark_pull(device)
+    for compression in ["none", "brotli", "lz4", "zstd"]:
+        benchmark_push(device, compression=compression)
+    benchmark_push_small_files(device)
+    for compression in ["none", "brotli", "lz4", "zstd"]:
+        benchmark_pull(device, compression=compression)
+    benchmark_shell(device)
+    benchmark_shell_latency(device)
 
 if __name__ == "__main__":
     main()
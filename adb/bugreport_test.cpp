@@ -24,6 +24,7 @@
 
 #include "sysdeps.h"
 #include "adb_utils.h"
+#include "compression_utils.h"
 
 using ::testing::_;
 using ::testing::Action;
@@ -43,7 +44,7 @@ using ::testing::internal::GetCapturedStdout;
 // Empty function so tests don't need to be linked against file_sync_service.cpp, which requires
 // SELinux and its transitive dependencies...
 bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst, bool copy_attrs,
-                  const char* name) {
+                  CompressionType compression, const char* name) {
     ADD_FAILURE() << "do_sync_pull() should have been mocked";
     return false;
 }
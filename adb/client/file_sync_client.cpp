@@ -29,11 +29,16 @@
 #include <utime.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "sysdeps.h"
@@ -42,7 +47,7 @@
 #include "adb_client.h"
 #include "adb_io.h"
 #include "adb_utils.h"
-#include "brotli_utils.h"
+#include "compression_utils.h"
 #include "file_sync_protocol.h"
 #include "line_printer.h"
 #include "sysdeps/errno.h"
@@ -54,6 +59,8 @@
 #include <android-base/strings.h>
 #include <android-base/stringprintf.h>
 
+#include <lz4.h>
+
 using namespace std::literals;
 
 typedef void(sync_ls_cb)(unsigned mode, uint64_t size, uint64_t time, const char* name);
@@ -222,6 +229,135 @@ struct TransferLedger {
     }
 };
 
+static uint32_t CompressionFlag(CompressionType compression) {
+    switch (compression) {
+        case CompressionType::Brotli:
+            return kSyncFlagBrotli;
+        case CompressionType::LZ4:
+            return kSyncFlagLZ4;
+        case CompressionType::Zstd:
+            return kSyncFlagZstd;
+        default:
+            return kSyncFlagNone;
+    }
+}
+
+// Compressing data that doesn't compress (compressed images, media, archives) only costs CPU
+// time, so check how well the start of a file compresses before choosing to compress it.
+static bool IsCompressible(const std::string& lpath) {
+    static constexpr size_t kSampleSize = 64 * 1024;
+
+    unique_fd fd(adb_open(lpath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        // Let the transfer report the error.
+        return true;
+    }
+
+    std::vector<char> sample(kSampleSize);
+    int sample_size = adb_read(fd.get(), sample.data(), sample.size());
+    if (sample_size <= 0) {
+        return true;
+    }
+
+    std::vector<char> compressed(LZ4_compressBound(sample_size));
+    int compressed_size = LZ4_compress_default(sample.data(), compressed.data(), sample_size,
+                                               compressed.size());
+    return compressed_size > 0 && compressed_size < sample_size * 9 / 10;
+}
+
+static constexpr unsigned kMaxCompressionThreads = 8;
+static constexpr size_t kCompressionChunkSize = 512 * 1024;
+
+// Compresses chunks of a file as independent LZ4 or Zstd frames on a pool of threads. The results
+// are returned in the order the chunks were submitted.
+class ParallelCompressor {
+  public:
+    ParallelCompressor(CompressionType compression, size_t thread_count)
+        : compression_(compression) {
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this]() { ThreadMain(); });
+        }
+    }
+
+    ~ParallelCompressor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void Submit(Block input) {
+        auto job = std::make_shared<Job>();
+        job->input = std::move(input);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(job);
+        queue_.push_back(std::move(job));
+        cv_.notify_all();
+    }
+
+    // Returns the number of chunks that have been submitted but not returned by Next.
+    size_t Pending() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_.size();
+    }
+
+    // Waits for the oldest pending chunk to be compressed.
+    bool Next(Block* output) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        CHECK(!pending_.empty());
+        std::shared_ptr<Job> job = std::move(pending_.front());
+        pending_.pop_front();
+
+        cv_.wait(lock, [&job]() { return job->done; });
+        *output = std::move(job->output);
+        return job->success;
+    }
+
+  private:
+    struct Job {
+        Block input;
+        Block output;
+        bool done = false;
+        bool success = false;
+    };
+
+    void ThreadMain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+            if (quit_) return;
+
+            std::shared_ptr<Job> job = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            Block output;
+            bool success = CompressFrame(compression_, job->input, &output);
+            job->input.clear();
+
+            lock.lock();
+            job->output = std::move(output);
+            job->success = success;
+            job->done = true;
+            cv_.notify_all();
+        }
+    }
+
+    const CompressionType compression_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<Job>> queue_;
+    std::deque<std::shared_ptr<Job>> pending_;
+    bool quit_ = false;
+};
+
 class SyncConnection {
   public:
     SyncConnection() : acknowledgement_buffer_(sizeof(sync_status) + SYNC_DATA_MAX) {
@@ -236,6 +372,8 @@ class SyncConnection {
             have_ls_v2_ = CanUseFeature(features_, kFeatureLs2);
             have_sendrecv_v2_ = CanUseFeature(features_, kFeatureSendRecv2);
             have_sendrecv_v2_brotli_ = CanUseFeature(features_, kFeatureSendRecv2Brotli);
+            have_sendrecv_v2_lz4_ = CanUseFeature(features_, kFeatureSendRecv2LZ4);
+            have_sendrecv_v2_zstd_ = CanUseFeature(features_, kFeatureSendRecv2Zstd);
             fd.reset(adb_connect("sync:", &error));
             if (fd < 0) {
                 Error("connect failed: %s", error.c_str());
@@ -261,6 +399,30 @@ class SyncConnection {
 
     bool HaveSendRecv2() const { return have_sendrecv_v2_; }
     bool HaveSendRecv2Brotli() const { return have_sendrecv_v2_brotli_; }
+    bool HaveSendRecv2LZ4() const { return have_sendrecv_v2_lz4_; }
+    bool HaveSendRecv2Zstd() const { return have_sendrecv_v2_zstd_; }
+
+    // Returns the compression type to use for a transfer, given the one the user asked for.
+    // Falls back to no compression if the device doesn't support it.
+    CompressionType ResolveCompressionType(CompressionType compression) const {
+        switch (compression) {
+            case CompressionType::Any:
+                // Zstd compresses about as well as brotli at a fraction of the CPU cost, and
+                // large pushes of it are compressed on several threads.
+                if (HaveSendRecv2Zstd()) return CompressionType::Zstd;
+                if (HaveSendRecv2LZ4()) return CompressionType::LZ4;
+                if (HaveSendRecv2Brotli()) return CompressionType::Brotli;
+                return CompressionType::None;
+            case CompressionType::Brotli:
+                return HaveSendRecv2Brotli() ? compression : CompressionType::None;
+            case CompressionType::LZ4:
+                return HaveSendRecv2LZ4() ? compression : CompressionType::None;
+            case CompressionType::Zstd:
+                return HaveSendRecv2Zstd() ? compression : CompressionType::None;
+            case CompressionType::None:
+                return CompressionType::None;
+        }
+    }
 
     const FeatureSet& Features() const { return features_; }
 
@@ -323,7 +485,7 @@ class SyncConnection {
         return WriteFdExactly(fd, buf.data(), buf.size());
     }
 
-    bool SendSend2(std::string_view path, mode_t mode, bool compressed) {
+    bool SendSend2(std::string_view path, mode_t mode, CompressionType compression) {
         if (path.length() > 1024) {
             Error("SendRequest failed: path too long: %zu", path.length());
             errno = ENAMETOOLONG;
@@ -339,7 +501,7 @@ class SyncConnection {
         syncmsg msg;
         msg.send_v2_setup.id = ID_SEND_V2;
         msg.send_v2_setup.mode = mode;
-        msg.send_v2_setup.flags = compressed ? kSyncFlagBrotli : kSyncFlagNone;
+        msg.send_v2_setup.flags = CompressionFlag(compression);
 
         buf.resize(sizeof(SyncRequest) + path.length() + sizeof(msg.send_v2_setup));
 
@@ -352,7 +514,7 @@ class SyncConnection {
         return WriteFdExactly(fd, buf.data(), buf.size());
     }
 
-    bool SendRecv2(const std::string& path) {
+    bool SendRecv2(const std::string& path, CompressionType compression) {
         if (path.length() > 1024) {
             Error("SendRequest failed: path too long: %zu", path.length());
             errno = ENAMETOOLONG;
@@ -367,7 +529,7 @@ class SyncConnection {
 
         syncmsg msg;
         msg.recv_v2_setup.id = ID_RECV_V2;
-        msg.recv_v2_setup.flags = kSyncFlagBrotli;
+        msg.recv_v2_setup.flags = CompressionFlag(compression);
 
         buf.resize(sizeof(SyncRequest) + path.length() + sizeof(msg.recv_v2_setup));
 
@@ -534,8 +696,9 @@ class SyncConnection {
     }
 
     bool SendLargeFileCompressed(const std::string& path, mode_t mode, const std::string& lpath,
-                                 const std::string& rpath, unsigned mtime) {
-        if (!SendSend2(path, mode, true)) {
+                                 const std::string& rpath, unsigned mtime,
+                                 CompressionType compression) {
+        if (!SendSend2(path, mode, compression)) {
             Error("failed to send ID_SEND_V2 message '%s': %s", path.c_str(), strerror(errno));
             return false;
         }
@@ -558,47 +721,97 @@ class SyncConnection {
         syncsendbuf sbuf;
         sbuf.id = ID_DATA;
 
-        BrotliEncoder<SYNC_DATA_MAX> encoder;
-        bool sending = true;
-        while (sending) {
-            Block input(SYNC_DATA_MAX);
-            int r = adb_read(lfd.get(), input.data(), input.size());
-            if (r < 0) {
-                Error("reading '%s' locally failed: %s", lpath.c_str(), strerror(errno));
-                return false;
-            }
+        if (compression == CompressionType::Brotli) {
+            std::unique_ptr<Encoder> encoder = CreateEncoder(compression, SYNC_DATA_MAX);
+            bool sending = true;
+            while (sending) {
+                Block input(SYNC_DATA_MAX);
+                int r = adb_read(lfd.get(), input.data(), input.size());
+                if (r < 0) {
+                    Error("reading '%s' locally failed: %s", lpath.c_str(), strerror(errno));
+                    return false;
+                }
 
-            if (r == 0) {
-                encoder.Finish();
-            } else {
-                input.resize(r);
-                encoder.Append(std::move(input));
-                RecordBytesTransferred(r);
-                bytes_copied += r;
-                ReportProgress(rpath, bytes_copied, total_size);
-            }
+                if (r == 0) {
+                    encoder->Finish();
+                } else {
+                    input.resize(r);
+                    encoder->Append(std::move(input));
+                    RecordBytesTransferred(r);
+                    bytes_copied += r;
+                    ReportProgress(rpath, bytes_copied, total_size);
+                }
 
+                while (true) {
+                    Block output;
+                    EncodeResult result = encoder->Encode(&output);
+                    if (result == EncodeResult::Error) {
+                        Error("compressing '%s' locally failed", lpath.c_str());
+                        return false;
+                    }
+
+                    if (!output.empty()) {
+                        sbuf.size = output.size();
+                        memcpy(sbuf.data, output.data(), output.size());
+                        WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + output.size());
+                    }
+
+                    if (result == EncodeResult::Done) {
+                        sending = false;
+                        break;
+                    } else if (result == EncodeResult::NeedInput) {
+                        break;
+                    } else if (result == EncodeResult::MoreOutput) {
+                        continue;
+                    }
+                }
+            }
+        } else {
+            // LZ4 and Zstd streams can be a series of independent frames, so the file is split
+            // into chunks that are compressed on several threads.
+            size_t thread_count = std::clamp(std::thread::hardware_concurrency(), 1U,
+                                             kMaxCompressionThreads);
+            ParallelCompressor compressor(compression, thread_count);
+            bool reading = true;
             while (true) {
+                // Keep a chunk queued up behind each one that's being compressed.
+                while (reading && compressor.Pending() < 2 * thread_count) {
+                    Block input(kCompressionChunkSize);
+                    size_t length = 0;
+                    while (length < input.size()) {
+                        int r = adb_read(lfd.get(), input.data() + length, input.size() - length);
+                        if (r < 0) {
+                            Error("reading '%s' locally failed: %s", lpath.c_str(),
+                                  strerror(errno));
+                            return false;
+                        } else if (r == 0) {
+                            reading = false;
+                            break;
+                        }
+                        length += r;
+                    }
+
+                    if (length == 0) break;
+                    input.resize(length);
+                    compressor.Submit(std::move(input));
+                    RecordBytesTransferred(length);
+                    bytes_copied += length;
+                    ReportProgress(rpath, bytes_copied, total_size);
+                }
+
+                if (compressor.Pending() == 0) break;
+
                 Block output;
-                BrotliEncodeResult result = encoder.Encode(&output);
-                if (result == BrotliEncodeResult::Error) {
+                if (!compressor.Next(&output)) {
                     Error("compressing '%s' locally failed", lpath.c_str());
                     return false;
                 }
 
-                if (!output.empty()) {
-                    sbuf.size = output.size();
-                    memcpy(sbuf.data, output.data(), output.size());
-                    WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + output.size());
-                }
-
-                if (result == BrotliEncodeResult::Done) {
-                    sending = false;
-                    break;
-                } else if (result == BrotliEncodeResult::NeedInput) {
-                    break;
-                } else if (result == BrotliEncodeResult::MoreOutput) {
-                    continue;
+                for (size_t offset = 0; offset < output.size(); offset += max) {
+                    size_t length = std::min(output.size() - offset, max);
+                    sbuf.size = length;
+                    memcpy(sbuf.data, output.data() + offset, length);
+                    WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + length);
                 }
             }
         }
@@ -611,9 +824,10 @@ class SyncConnection {
     }
 
     bool SendLargeFile(const std::string& path, mode_t mode, const std::string& lpath,
-                       const std::string& rpath, unsigned mtime, bool compressed) {
-        if (compressed && HaveSendRecv2Brotli()) {
-            return SendLargeFileCompressed(path, mode, lpath, rpath, mtime);
+                       const std::string& rpath, unsigned mtime, CompressionType compression) {
+        compression = ResolveCompressionType(compression);
+        if (compression != CompressionType::None && IsCompressible(lpath)) {
+            return SendLargeFileCompressed(path, mode, lpath, rpath, mtime, compression);
         }
 
         std::string path_and_mode = android::base::StringPrintf("%s,%d", path.c_str(), mode);
@@ -840,6 +1054,8 @@ class SyncConnection {
     bool have_ls_v2_;
     bool have_sendrecv_v2_;
     bool have_sendrecv_v2_brotli_;
+    bool have_sendrecv_v2_lz4_;
+    bool have_sendrecv_v2_zstd_;
 
     TransferLedger global_ledger_;
     TransferLedger current_ledger_;
@@ -920,8 +1136,10 @@ static bool sync_stat_fallback(SyncConnection& sc, const std::string& path, stru
     return true;
 }
 
+// If `prefetched` is set, it's the contents of `lpath`, read ahead by a SyncPrefetcher.
 static bool sync_send(SyncConnection& sc, const std::string& lpath, const std::string& rpath,
-                      unsigned mtime, mode_t mode, bool sync, bool compressed) {
+                      unsigned mtime, mode_t mode, bool sync, CompressionType compression,
+                      std::optional<std::string> prefetched = std::nullopt) {
     if (sync) {
         struct stat st;
         if (sync_lstat(sc, rpath, &st)) {
@@ -949,6 +1167,14 @@ static bool sync_send(SyncConnection& sc, const std::string& lpath, const std::s
 #endif
     }
 
+    if (prefetched && prefetched->size() < SYNC_DATA_MAX) {
+        if (!sc.SendSmallFile(rpath, mode, lpath, rpath, mtime, prefetched->data(),
+                              prefetched->size())) {
+            return false;
+        }
+        return sc.ReadAcknowledgements();
+    }
+
     struct stat st;
     if (stat(lpath.c_str(), &st) == -1) {
         sc.Error("failed to stat local file '%s': %s", lpath.c_str(), strerror(errno));
@@ -964,7 +1190,7 @@ static bool sync_send(SyncConnection& sc, const std::string& lpath, const std::s
             return false;
         }
     } else {
-        if (!sc.SendLargeFile(rpath, mode, lpath, rpath, mtime, compressed)) {
+        if (!sc.SendLargeFile(rpath, mode, lpath, rpath, mtime, compression)) {
             return false;
         }
     }
@@ -1027,8 +1253,8 @@ static bool sync_recv_v1(SyncConnection& sc, const char* rpath, const char* lpat
 }
 
 static bool sync_recv_v2(SyncConnection& sc, const char* rpath, const char* lpath, const char* name,
-                         uint64_t expected_size) {
-    if (!sc.SendRecv2(rpath)) return false;
+                         uint64_t expected_size, CompressionType compression) {
+    if (!sc.SendRecv2(rpath, compression)) return false;
 
     adb_unlink(lpath);
     unique_fd lfd(adb_creat(lpath, 0644));
@@ -1040,7 +1266,8 @@ static bool sync_recv_v2(SyncConnection& sc, const char* rpath, const char* lpat
     uint64_t bytes_copied = 0;
 
     Block buffer(SYNC_DATA_MAX);
-    BrotliDecoder decoder(std::span(buffer.data(), buffer.size()));
+    std::unique_ptr<Decoder> decoder =
+            CreateDecoder(compression, std::span(buffer.data(), buffer.size()));
     bool reading = true;
     while (reading) {
         syncmsg msg;
@@ -1072,13 +1299,13 @@ static bool sync_recv_v2(SyncConnection& sc, const char* rpath, const char* lpat
             adb_unlink(lpath);
             return false;
         }
-        decoder.Append(std::move(block));
+        decoder->Append(std::move(block));
 
         while (true) {
             std::span<char> output;
-            BrotliDecodeResult result = decoder.Decode(&output);
+            DecodeResult result = decoder->Decode(&output);
 
-            if (result == BrotliDecodeResult::Error) {
+            if (result == DecodeResult::Error) {
                 sc.Error("decompress failed");
                 adb_unlink(lpath);
                 return false;
@@ -1097,15 +1324,15 @@ static bool sync_recv_v2(SyncConnection& sc, const char* rpath, const char* lpat
             sc.RecordBytesTransferred(msg.data.size);
             sc.ReportProgress(name != nullptr ? name : rpath, bytes_copied, expected_size);
 
-            if (result == BrotliDecodeResult::NeedInput) {
+            if (result == DecodeResult::NeedInput) {
                 break;
-            } else if (result == BrotliDecodeResult::MoreOutput) {
+            } else if (result == DecodeResult::MoreOutput) {
                 continue;
-            } else if (result == BrotliDecodeResult::Done) {
+            } else if (result == DecodeResult::Done) {
                 reading = false;
                 break;
             } else {
-                LOG(FATAL) << "invalid BrotliDecodeResult: " << static_cast<int>(result);
+                LOG(FATAL) << "invalid DecodeResult: " << static_cast<int>(result);
             }
         }
     }
@@ -1126,9 +1353,10 @@ static bool sync_recv_v2(SyncConnection& sc, const char* rpath, const char* lpat
 }
 
 static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath, const char* name,
-                      uint64_t expected_size, bool compressed) {
-    if (sc.HaveSendRecv2() && compressed) {
-        return sync_recv_v2(sc, rpath, lpath, name, expected_size);
+                      uint64_t expected_size, CompressionType compression) {
+    compression = sc.ResolveCompressionType(compression);
+    if (sc.HaveSendRecv2() && compression != CompressionType::None) {
+        return sync_recv_v2(sc, rpath, lpath, name, expected_size, compression);
     } else {
         return sync_recv_v1(sc, rpath, lpath, name, expected_size);
     }
@@ -1209,8 +1437,101 @@ static bool is_root_dir(std::string_view path) {
     return true;
 }
 
+// Reads the small files in a push on a few worker threads, ahead of the thread that's sending
+// them, so that reading files overlaps with sending earlier ones (and with adbd writing them).
+class SyncPrefetcher {
+  public:
+    static constexpr size_t kThreads = 4;
+    static constexpr size_t kWindow = 64;
+
+    explicit SyncPrefetcher(const std::vector<copyinfo>& file_list) {
+        for (size_t i = 0; i < file_list.size(); ++i) {
+            const copyinfo& ci = file_list[i];
+            if (!ci.skip && S_ISREG(ci.mode) && ci.size < SYNC_DATA_MAX) {
+                file_entries_[i] = entries_.size();
+                entries_.push_back({.path = ci.lpath});
+            }
+        }
+
+        // Not worth it for a handful of files.
+        if (entries_.size() < 2) return;
+        for (size_t i = 0; i < kThreads; ++i) {
+            threads_.emplace_back([this]() { ThreadMain(); });
+        }
+    }
+
+    ~SyncPrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Returns the contents of file_list[index], if it was read ahead. Files must be taken in
+    // order. If this returns nullopt, the caller should read the file itself.
+    std::optional<std::string> Take(size_t index) {
+        auto it = file_entries_.find(index);
+        if (it == file_entries_.end() || threads_.empty()) return std::nullopt;
+
+        size_t entry_index = it->second;
+        std::unique_lock<std::mutex> lock(mutex_);
+        Entry& entry = entries_[entry_index];
+        cv_.wait(lock, [&entry]() { return entry.done; });
+        next_take_ = entry_index + 1;
+        cv_.notify_all();
+
+        if (!entry.success) return std::nullopt;
+        return std::move(entry.data);
+    }
+
+  private:
+    struct Entry {
+        std::string path;
+        std::string data;
+        bool done = false;
+        bool success = false;
+    };
+
+    void ThreadMain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() {
+                return quit_ || (next_read_ < entries_.size() && next_read_ < next_take_ + kWindow);
+            });
+            if (quit_) return;
+
+            Entry& entry = entries_[next_read_++];
+            lock.unlock();
+
+            // Failures are reported when the sending thread retries the read.
+            std::string data;
+            bool success = android::base::ReadFileToString(entry.path, &data, true);
+
+            lock.lock();
+            entry.data = std::move(data);
+            entry.success = success;
+            entry.done = true;
+            cv_.notify_all();
+        }
+    }
+
+    std::vector<Entry> entries_;
+    std::unordered_map<size_t, size_t> file_entries_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t next_read_ = 0;
+    size_t next_take_ = 0;
+    bool quit_ = false;
+};
+
 static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath, std::string rpath,
-                                  bool check_timestamps, bool list_only, bool compressed) {
+                                  bool check_timestamps, bool list_only, CompressionType compression) {
     sc.NewTransfer();
 
     // Make sure that both directory paths end in a slash.
@@ -1287,12 +1608,19 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath, std::st
 
     sc.ComputeExpectedTotalBytes(file_list);
 
-    for (const copyinfo& ci : file_list) {
+    std::optional<SyncPrefetcher> prefetcher;
+    if (!list_only) {
+        prefetcher.emplace(file_list);
+    }
+
+    for (size_t i = 0; i < file_list.size(); ++i) {
+        const copyinfo& ci = file_list[i];
         if (!ci.skip) {
             if (list_only) {
                 sc.Println("would push: %s -> %s", ci.lpath.c_str(), ci.rpath.c_str());
             } else {
-                if (!sync_send(sc, ci.lpath, ci.rpath, ci.time, ci.mode, false, compressed)) {
+                if (!sync_send(sc, ci.lpath, ci.rpath, ci.time, ci.mode, false, compression,
+                               prefetcher->Take(i))) {
                     return false;
                 }
             }
@@ -1308,7 +1636,7 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath, std::st
 }
 
 bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sync,
-                  bool compressed) {
+                  CompressionType compression) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
 
@@ -1373,7 +1701,7 @@ bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sy
                 dst_dir.append(android::base::Basename(src_path));
             }
 
-            success &= copy_local_dir_remote(sc, src_path, dst_dir, sync, false, compressed);
+            success &= copy_local_dir_remote(sc, src_path, dst_dir, sync, false, compression);
             continue;
         } else if (!should_push_file(st.st_mode)) {
             sc.Warning("skipping special file '%s' (mode = 0o%o)", src_path, st.st_mode);
@@ -1394,7 +1722,7 @@ bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sy
 
         sc.NewTransfer();
         sc.SetExpectedTotalBytes(st.st_size);
-        success &= sync_send(sc, src_path, dst_path, st.st_mtime, st.st_mode, sync, compressed);
+        success &= sync_send(sc, src_path, dst_path, st.st_mtime, st.st_mode, sync, compression);
         sc.ReportTransferRate(src_path, TransferDirection::push);
     }
 
@@ -1480,7 +1808,7 @@ static int set_time_and_mode(const std::string& lpath, time_t time,
 }
 
 static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath, std::string lpath,
-                                  bool copy_attrs, bool compressed) {
+                                  bool copy_attrs, CompressionType compression) {
     sc.NewTransfer();
 
     // Make sure that both directory paths end in a slash.
@@ -1510,7 +1838,7 @@ static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath, std::st
                 continue;
             }
 
-            if (!sync_recv(sc, ci.rpath.c_str(), ci.lpath.c_str(), nullptr, ci.size, compressed)) {
+            if (!sync_recv(sc, ci.rpath.c_str(), ci.lpath.c_str(), nullptr, ci.size, compression)) {
                 return false;
             }
 
@@ -1528,7 +1856,7 @@ static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath, std::st
 }
 
 bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst, bool copy_attrs,
-                  bool compressed, const char* name) {
+                  CompressionType compression, const char* name) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
 
@@ -1602,7 +1930,7 @@ bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst, bool co
                 dst_dir.append(android::base::Basename(src_path));
             }
 
-            success &= copy_remote_dir_local(sc, src_path, dst_dir, copy_attrs, compressed);
+            success &= copy_remote_dir_local(sc, src_path, dst_dir, copy_attrs, compression);
             continue;
         } else if (!should_pull_file(src_st.st_mode)) {
             sc.Warning("skipping special file '%s' (mode = 0o%o)", src_path, src_st.st_mode);
@@ -1621,7 +1949,7 @@ bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst, bool co
 
         sc.NewTransfer();
         sc.SetExpectedTotalBytes(src_st.st_size);
-        if (!sync_recv(sc, src_path, dst_path, name, src_st.st_size, compressed)) {
+        if (!sync_recv(sc, src_path, dst_path, name, src_st.st_size, compression)) {
             success = false;
             continue;
         }
@@ -1638,11 +1966,11 @@ bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst, bool co
 }
 
 bool do_sync_sync(const std::string& lpath, const std::string& rpath, bool list_only,
-                  bool compressed) {
+                  CompressionType compression) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
 
-    bool success = copy_local_dir_remote(sc, lpath, rpath, true, list_only, compressed);
+    bool success = copy_local_dir_remote(sc, lpath, rpath, true, list_only, compression);
     if (!list_only) {
         sc.ReportOverallTransferRate(TransferDirection::push);
     }
@@ -19,17 +19,28 @@
 #include "incremental_server.h"
 
 #include <android-base/endian.h>
+#include <android-base/file.h>
+#include <android-base/mapped_file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <dirent.h>
 #include <inttypes.h>
 #include <lz4.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <utime.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <thread>
 #include <type_traits>
 #include <unordered_set>
@@ -53,6 +64,12 @@ static constexpr int8_t kCompressionLZ4 = 1;
 static constexpr int kCompressBound = std::max(kBlockSize, LZ4_COMPRESSBOUND(kBlockSize));
 static constexpr auto kReadBufferSize = 128 * 1024;
 static constexpr int kPollTimeoutMillis = 300000;  // 5 minutes
+static constexpr size_t kMaxEncoderThreads = 4;
+static constexpr size_t kMinBlocksForThreads = 16;
+// Access profiles that haven't been used for this long are removed, and only the most recently used
+// ones are kept.
+static constexpr auto kAccessProfileMaxAge = std::chrono::hours(24 * 30);
+static constexpr size_t kMaxAccessProfiles = 64;
 
 using BlockSize = int16_t;
 using FileId = int16_t;
@@ -145,6 +162,80 @@ struct BlockBuffer {
     char data[Size];
 } __attribute__((packed));
 
+// The access profile records the order in which the device asked for blocks that hadn't been sent
+// yet, so that the next install of the same file can prefetch them in that order. Profiles live in
+// the adb directory and are keyed by file name, size and modification time.
+static std::string AccessProfileDir() {
+    return adb_get_android_dir_path() + OS_PATH_SEPARATOR + "incremental";
+}
+
+static std::string AccessProfilePath(const char* filepath, int64_t size) {
+    struct stat st;
+    if (stat(filepath, &st)) {
+        return {};
+    }
+    std::string dir = AccessProfileDir();
+    if (adb_mkdir(dir, 0750) != 0 && errno != EEXIST) {
+        D("Failed to create access profile directory %s: %s", dir.c_str(), strerror(errno));
+        return {};
+    }
+    return android::base::StringPrintf("%s%c%s.%" PRId64 ".%" PRId64 ".profile", dir.c_str(),
+                                       OS_PATH_SEPARATOR, android::base::Basename(filepath).c_str(),
+                                       size, static_cast<int64_t>(st.st_mtime));
+}
+
+static std::vector<BlockIdx> LoadAccessProfile(const std::string& path, NumBlocks block_count) {
+    std::vector<BlockIdx> blocks;
+    std::string content;
+    if (path.empty() || !android::base::ReadFileToString(path, &content)) {
+        return blocks;
+    }
+    for (const auto& line : android::base::Split(content, "\n")) {
+        BlockIdx block_idx;
+        if (android::base::ParseInt(line, &block_idx, 0, block_count - 1)) {
+            blocks.push_back(block_idx);
+        }
+    }
+    D("Loaded %zu blocks from access profile %s", blocks.size(), path.c_str());
+    return blocks;
+}
+
+// Every rebuild of a file gets a new profile, so drop the ones that are unlikely to be used again.
+static void PruneAccessProfiles() {
+    std::string dir = AccessProfileDir();
+    std::unique_ptr<DIR, int (*)(DIR*)> dirp(opendir(dir.c_str()), closedir);
+    if (!dirp) {
+        return;
+    }
+
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    auto max_age = std::chrono::duration_cast<std::chrono::seconds>(kAccessProfileMaxAge).count();
+    std::vector<std::pair<time_t, std::string>> profiles;
+    while (struct dirent* dent = readdir(dirp.get())) {
+        std::string name = dent->d_name;
+        if (!android::base::EndsWith(name, ".profile")) {
+            continue;
+        }
+        std::string path = dir + OS_PATH_SEPARATOR + name;
+        struct stat st;
+        if (stat(path.c_str(), &st)) {
+            continue;
+        }
+        if (now - st.st_mtime > max_age) {
+            adb_unlink(path.c_str());
+        } else {
+            profiles.emplace_back(st.st_mtime, std::move(path));
+        }
+    }
+
+    if (profiles.size() > kMaxAccessProfiles) {
+        std::sort(profiles.begin(), profiles.end(), std::greater<>());
+        for (size_t i = kMaxAccessProfiles; i < profiles.size(); ++i) {
+            adb_unlink(profiles[i].second.c_str());
+        }
+    }
+}
+
 // Holds streaming state for a file
 class File {
   public:
@@ -154,13 +245,35 @@ class File {
         : File(filepath, id, size, tree_offset) {
         this->fd_ = std::move(fd);
         this->tree_fd_ = std::move(tree_fd);
-        priority_blocks_ = PriorityBlocksForFile(filepath, fd_.get(), size);
+        if (size > 0) {
+            mapping_ = android::base::MappedFile::FromOsHandle(adb_get_os_handle(fd_), 0, size,
+                                                               PROT_READ);
+        }
+        profile_path_ = AccessProfilePath(filepath, size);
+        profile_ = LoadAccessProfile(profile_path_, sentBlocks.size());
+        if (!profile_.empty()) {
+            // Mark the profile as used, so that it isn't pruned.
+            utime(profile_path_.c_str(), nullptr);
+        }
+
+        // Blocks the device asked for last time go first, then the ones that the zip layout
+        // suggests.
+        priority_blocks_ = profile_;
+        auto zip_priority_blocks = PriorityBlocksForFile(filepath, fd_.get(), size);
+        priority_blocks_.insert(priority_blocks_.end(), zip_priority_blocks.begin(),
+                                zip_priority_blocks.end());
     }
-    int64_t ReadDataBlock(BlockIdx block_idx, void* buf, bool* is_zip_compressed) const {
-        int64_t bytes_read = -1;
+
+    // Returns a pointer to the block's data and sets |bytes_read|, or returns nullptr on error.
+    // Mapped files are read in place; otherwise the data is read into |buf|.
+    const char* ReadDataBlock(BlockIdx block_idx, char* buf, int64_t* bytes_read) const {
         const off64_t offsetStart = blockIndexToOffset(block_idx);
-        bytes_read = adb_pread(fd_, buf, kBlockSize, offsetStart);
-        return bytes_read;
+        if (mapping_) {
+            *bytes_read = std::min<int64_t>(kBlockSize, size - offsetStart);
+            return mapping_->data() + offsetStart;
+        }
+        *bytes_read = adb_pread(fd_, buf, kBlockSize, offsetStart);
+        return *bytes_read < 0 ? nullptr : buf;
     }
     int64_t ReadTreeBlock(BlockIdx block_idx, void* buf) const {
         int64_t bytes_read = -1;
@@ -171,11 +284,37 @@ class File {
 
     const std::vector<BlockIdx>& PriorityBlocks() const { return priority_blocks_; }
 
+    // Appends the blocks missed during this install to the access profile and writes it out.
+    void SaveAccessProfile() {
+        if (missedBlocks.empty() || profile_path_.empty()) {
+            return;
+        }
+        std::unordered_set<BlockIdx> known(profile_.begin(), profile_.end());
+        for (BlockIdx block_idx : missedBlocks) {
+            if (known.insert(block_idx).second) {
+                profile_.push_back(block_idx);
+            }
+        }
+        missedBlocks.clear();
+
+        std::string content;
+        for (BlockIdx block_idx : profile_) {
+            content += std::to_string(block_idx);
+            content += '\n';
+        }
+        if (!android::base::WriteStringToFile(content, profile_path_)) {
+            D("Failed to write access profile %s: %s", profile_path_.c_str(), strerror(errno));
+        }
+    }
+
     std::vector<bool> sentBlocks;
     NumBlocks sentBlocksCount = 0;
 
     std::vector<bool> sentTreeBlocks;
 
+    // Blocks the device reported missing before we got to them, in request order.
+    std::vector<BlockIdx> missedBlocks;
+
     const char* const filepath;
     const FileId id;
     const int64_t size;
@@ -187,12 +326,96 @@ class File {
         sentTreeBlocks.resize(verity_tree_blocks_for_file(size));
     }
     unique_fd fd_;
+    std::unique_ptr<android::base::MappedFile> mapping_;
     std::vector<BlockIdx> priority_blocks_;
 
+    std::string profile_path_;
+    std::vector<BlockIdx> profile_;
+
     unique_fd tree_fd_;
     const int64_t tree_offset_;
 };
 
+// Runs batches of independent jobs on the calling thread and a few workers that are started with
+// the first batch and kept until the pool is destroyed.
+class EncoderPool {
+  public:
+    explicit EncoderPool(size_t threads) : threads_count_(threads) {}
+
+    ~EncoderPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Calls |job| with every index below |count| and returns once all of them are done.
+    void Run(size_t count, std::function<void(size_t)> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (threads_.empty()) {
+                for (size_t i = 1; i < threads_count_; ++i) {
+                    threads_.emplace_back([this]() { WorkerMain(); });
+                }
+            }
+            job_ = std::move(job);
+            count_ = count;
+            next_ = 0;
+            busy_ = threads_.size();
+            ++generation_;
+        }
+        cv_.notify_all();
+
+        Work();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]() { return busy_ == 0; });
+        job_ = nullptr;
+    }
+
+  private:
+    void Work() {
+        for (size_t i; (i = next_++) < count_;) {
+            job_(i);
+        }
+    }
+
+    void WorkerMain() {
+        size_t generation = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this, generation]() { return quit_ || generation_ != generation; });
+            if (quit_) return;
+            generation = generation_;
+
+            lock.unlock();
+            Work();
+            lock.lock();
+            if (--busy_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+
+    const size_t threads_count_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    bool quit_ = false;
+
+    // The current batch. Only changed while no worker is running it.
+    std::function<void(size_t)> job_;
+    size_t count_ = 0;
+    std::atomic<size_t> next_ = 0;
+    size_t busy_ = 0;
+    size_t generation_ = 0;
+};
+
 class IncrementalServer {
   public:
     IncrementalServer(unique_fd adb_fd, unique_fd output_fd, std::vector<File> files)
@@ -233,8 +456,23 @@ class IncrementalServer {
 
     void erase_buffer_head(int count) { buffer_.erase(buffer_.begin(), buffer_.begin() + count); }
 
+    // A data block that has been read and, if worthwhile, compressed, ready to be sent.
+    struct EncodedBlock {
+        BlockIdx blockIdx = 0;
+        bool ok = false;
+        BlockSize blockSize = 0;
+        BlockBuffer<kCompressBound> buffer;
+    };
+
     enum class SendResult { Sent, Skipped, Error };
     SendResult SendDataBlock(FileId fileId, BlockIdx blockIdx, bool flush = false);
+    static bool EncodeDataBlock(const File& file, BlockIdx blockIdx, EncodedBlock* block);
+    void EncodeDataBlocks(const File& file, std::vector<EncodedBlock>* blocks, size_t count);
+    void SendEncodedBlock(File& file, const EncodedBlock& block, bool flush);
+    bool IsPending(const File& file, BlockIdx blockIdx) const {
+        return blockIdx < static_cast<BlockIdx>(file.sentBlocks.size()) &&
+               !file.sentBlocks[blockIdx];
+    }
 
     bool SendTreeBlock(FileId fileId, int32_t fileBlockIdx, BlockIdx blockIdx);
     bool SendTreeBlocksForDataBlock(FileId fileId, BlockIdx blockIdx);
@@ -246,6 +484,7 @@ class IncrementalServer {
     void Flush();
     using TimePoint = decltype(std::chrono::high_resolution_clock::now());
     bool ServingComplete(std::optional<TimePoint> startTime, int missesCount, int missesSent);
+    void SaveAccessProfiles();
 
     unique_fd const adb_fd_;
     unique_fd const output_fd_;
@@ -255,6 +494,9 @@ class IncrementalServer {
     std::vector<char> buffer_;
 
     std::deque<PrefetchState> prefetches_;
+    std::vector<EncodedBlock> encodedBlocks_;
+    EncoderPool encoderPool_{
+            std::clamp<size_t>(std::thread::hardware_concurrency(), 1, kMaxEncoderThreads)};
     int compressed_ = 0, uncompressed_ = 0;
     long long sentSize_ = 0;
 
@@ -417,44 +659,73 @@ auto IncrementalServer::SendDataBlock(FileId fileId, BlockIdx blockIdx, bool flu
         return SendResult::Error;
     }
 
-    BlockBuffer raw;
-    bool isZipCompressed = false;
-    const int64_t bytesRead = file.ReadDataBlock(blockIdx, raw.data, &isZipCompressed);
-    if (bytesRead < 0) {
+    EncodedBlock block;
+    if (!EncodeDataBlock(file, blockIdx, &block)) {
         fprintf(stderr, "Failed to get data for %s at blockIdx=%d (%d).\n", file.filepath, blockIdx,
                 errno);
         return SendResult::Error;
     }
+    SendEncodedBlock(file, block, flush);
 
-    BlockBuffer<kCompressBound> compressed;
-    int16_t compressedSize = 0;
-    if (!isZipCompressed) {
-        compressedSize = LZ4_compress_default(raw.data, compressed.data, bytesRead, kCompressBound);
+    return SendResult::Sent;
+}
+
+bool IncrementalServer::EncodeDataBlock(const File& file, BlockIdx blockIdx, EncodedBlock* block) {
+    BlockBuffer raw;
+    int64_t bytesRead;
+    const char* data = file.ReadDataBlock(blockIdx, raw.data, &bytesRead);
+    block->blockIdx = blockIdx;
+    block->ok = data != nullptr;
+    if (!block->ok) {
+        return false;
     }
-    int16_t blockSize;
-    ResponseHeader* header;
+
+    ResponseHeader* header = &block->buffer.header;
+    int compressedSize =
+            LZ4_compress_default(data, block->buffer.data, bytesRead, kCompressBound);
     if (compressedSize > 0 && compressedSize < kCompressedSizeMax) {
-        ++compressed_;
-        blockSize = compressedSize;
-        header = &compressed.header;
+        block->blockSize = compressedSize;
         header->compression_type = kCompressionLZ4;
     } else {
-        ++uncompressed_;
-        blockSize = bytesRead;
-        header = &raw.header;
+        memcpy(block->buffer.data, data, bytesRead);
+        block->blockSize = bytesRead;
         header->compression_type = kCompressionNone;
     }
 
     header->block_type = kTypeData;
-    header->file_id = toBigEndian(fileId);
-    header->block_size = toBigEndian(blockSize);
+    header->file_id = toBigEndian(file.id);
+    header->block_size = toBigEndian(block->blockSize);
     header->block_idx = toBigEndian(blockIdx);
+    return true;
+}
 
-    file.sentBlocks[blockIdx] = true;
-    file.sentBlocksCount += 1;
-    Send(header, ResponseHeader::responseSizeFor(blockSize), flush);
+// Reading and compressing is independent per block, so spread a batch over the encoder pool.
+// Sending stays on the serving thread and in order.
+void IncrementalServer::EncodeDataBlocks(const File& file, std::vector<EncodedBlock>* blocks,
+                                         size_t count) {
+    auto encode = [&file, blocks](size_t i) {
+        auto& block = (*blocks)[i];
+        EncodeDataBlock(file, block.blockIdx, &block);
+    };
 
-    return SendResult::Sent;
+    if (count < kMinBlocksForThreads) {
+        for (size_t i = 0; i < count; ++i) {
+            encode(i);
+        }
+        return;
+    }
+    encoderPool_.Run(count, encode);
+}
+
+void IncrementalServer::SendEncodedBlock(File& file, const EncodedBlock& block, bool flush) {
+    if (block.buffer.header.compression_type == kCompressionLZ4) {
+        ++compressed_;
+    } else {
+        ++uncompressed_;
+    }
+    file.sentBlocks[block.blockIdx] = true;
+    file.sentBlocksCount += 1;
+    Send(&block.buffer, ResponseHeader::responseSizeFor(block.blockSize), flush);
 }
 
 bool IncrementalServer::SendDone() {
@@ -471,29 +742,45 @@ bool IncrementalServer::SendDone() {
 void IncrementalServer::RunPrefetching() {
     constexpr auto kPrefetchBlocksPerIteration = 128;
 
+    if (encodedBlocks_.size() < kPrefetchBlocksPerIteration) {
+        encodedBlocks_.resize(kPrefetchBlocksPerIteration);
+    }
+
     int blocksToSend = kPrefetchBlocksPerIteration;
     while (!prefetches_.empty() && blocksToSend > 0) {
         auto& prefetch = prefetches_.front();
-        const auto& file = *prefetch.file;
+        auto& file = files_[prefetch.file->id];
         const auto& priority_blocks = file.PriorityBlocks();
-        if (!priority_blocks.empty()) {
-            for (auto& i = prefetch.priorityIndex;
-                 blocksToSend > 0 && i < (BlockIdx)priority_blocks.size(); ++i) {
-                if (auto res = SendDataBlock(file.id, priority_blocks[i]);
-                    res == SendResult::Sent) {
-                    --blocksToSend;
-                } else if (res == SendResult::Error) {
-                    fprintf(stderr, "Failed to send priority block %" PRId32 "\n", i);
-                }
+
+        // Pick the next batch of unsent blocks: priority blocks first, then the linear range.
+        std::unordered_set<BlockIdx> batch;
+        size_t count = 0;
+        auto add = [&](BlockIdx blockIdx) {
+            if (IsPending(file, blockIdx) && batch.insert(blockIdx).second) {
+                encodedBlocks_[count++].blockIdx = blockIdx;
             }
+        };
+        for (auto& i = prefetch.priorityIndex;
+             (int)count < blocksToSend && i < (BlockIdx)priority_blocks.size(); ++i) {
+            add(priority_blocks[i]);
+        }
+        for (auto& i = prefetch.overallIndex; (int)count < blocksToSend && i < prefetch.overallEnd;
+             ++i) {
+            add(i);
         }
-        for (auto& i = prefetch.overallIndex; blocksToSend > 0 && i < prefetch.overallEnd; ++i) {
-            if (auto res = SendDataBlock(file.id, i); res == SendResult::Sent) {
-                --blocksToSend;
-            } else if (res == SendResult::Error) {
-                fprintf(stderr, "Failed to send block %" PRId32 "\n", i);
+
+        EncodeDataBlocks(file, &encodedBlocks_, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            const auto& block = encodedBlocks_[i];
+            if (!block.ok || !SendTreeBlocksForDataBlock(file.id, block.blockIdx)) {
+                fprintf(stderr, "Failed to send block %" PRId32 "\n", block.blockIdx);
+                continue;
             }
+            SendEncodedBlock(file, block, /*flush=*/false);
+            --blocksToSend;
         }
+
         if (prefetch.done()) {
             prefetches_.pop_front();
         }
@@ -525,6 +812,7 @@ void IncrementalServer::Flush() {
 bool IncrementalServer::ServingComplete(std::optional<TimePoint> startTime, int missesCount,
                                         int missesSent) {
     servingComplete_ = true;
+    SaveAccessProfiles();
     using namespace std::chrono;
     auto endTime = high_resolution_clock::now();
     D("Streaming completed.\n"
@@ -536,6 +824,13 @@ bool IncrementalServer::ServingComplete(std::optional<TimePoint> startTime, int
     return true;
 }
 
+void IncrementalServer::SaveAccessProfiles() {
+    for (auto& file : files_) {
+        file.SaveAccessProfile();
+    }
+    PruneAccessProfiles();
+}
+
 bool IncrementalServer::Serve() {
     // Initial handshake to verify connection is still alive
     if (!SendOkay(adb_fd_)) {
@@ -579,6 +874,7 @@ bool IncrementalServer::Serve() {
             switch (request->request_type) {
                 case DESTROY: {
                     // Stop everything.
+                    SaveAccessProfiles();
                     return true;
                 }
                 case SERVING_COMPLETE: {
@@ -615,6 +911,7 @@ bool IncrementalServer::Serve() {
                         fprintf(stderr, "Failed to send block %" PRId32 ".\n", blockIdx);
                     } else if (res == SendResult::Sent) {
                         ++missesSent;
+                        files_[fileId].missedBlocks.push_back(blockIdx);
                         // Make sure we send more pages from this place onward, in case if the OS is
                         // reading a bigger block.
                         prefetches_.emplace_front(files_[fileId], blockIdx + 1, 7);
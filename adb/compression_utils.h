@@ -0,0 +1,445 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <android-base/logging.h>
+
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#include <lz4frame.h>
+#include <zstd.h>
+
+#include "types.h"
+
+enum class CompressionType {
+    None,
+    Any,
+    Brotli,
+    LZ4,
+    Zstd,
+};
+
+enum class DecodeResult {
+    Error,
+    Done,
+    NeedInput,
+    MoreOutput,
+};
+
+enum class EncodeResult {
+    Error,
+    Done,
+    NeedInput,
+    MoreOutput,
+};
+
+struct Decoder {
+    explicit Decoder(std::span<char> output_buffer) : output_buffer_(output_buffer) {}
+    virtual ~Decoder() = default;
+
+    void Append(Block&& block) { input_buffer_.append(std::move(block)); }
+
+    // Returns Done at the end of the compressed stream. The LZ4 and Zstd decoders also accept
+    // several concatenated streams, and return Done whenever one ends with no input left.
+    virtual DecodeResult Decode(std::span<char>* output) = 0;
+
+  protected:
+    IOVector input_buffer_;
+    std::span<char> output_buffer_;
+};
+
+struct Encoder {
+    explicit Encoder(size_t output_block_size)
+        : output_block_size_(output_block_size),
+          output_block_(output_block_size),
+          output_bytes_left_(output_block_size) {}
+    virtual ~Encoder() = default;
+
+    void Append(Block input) { input_buffer_.append(std::move(input)); }
+    void Finish() { finished_ = true; }
+
+    // Output is produced in blocks of at most output_block_size bytes.
+    virtual EncodeResult Encode(Block* output) = 0;
+
+  protected:
+    const size_t output_block_size_;
+    bool finished_ = false;
+    IOVector input_buffer_;
+    Block output_block_;
+    size_t output_bytes_left_;
+};
+
+struct BrotliDecoder final : public Decoder {
+    explicit BrotliDecoder(std::span<char> output_buffer)
+        : Decoder(output_buffer),
+          decoder_(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr),
+                   BrotliDecoderDestroyInstance) {}
+
+    DecodeResult Decode(std::span<char>* output) final {
+        size_t available_in = input_buffer_.front_size();
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input_buffer_.front_data());
+
+        size_t available_out = output_buffer_.size();
+        uint8_t* next_out = reinterpret_cast<uint8_t*>(output_buffer_.data());
+
+        BrotliDecoderResult r = BrotliDecoderDecompressStream(
+                decoder_.get(), &available_in, &next_in, &available_out, &next_out, nullptr);
+
+        size_t bytes_consumed = input_buffer_.front_size() - available_in;
+        input_buffer_.drop_front(bytes_consumed);
+
+        size_t bytes_emitted = output_buffer_.size() - available_out;
+        *output = std::span<char>(output_buffer_.data(), bytes_emitted);
+
+        switch (r) {
+            case BROTLI_DECODER_RESULT_SUCCESS:
+                return DecodeResult::Done;
+            case BROTLI_DECODER_RESULT_ERROR:
+                return DecodeResult::Error;
+            case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+                // Brotli guarantees as one of its invariants that if it returns NEEDS_MORE_INPUT,
+                // it will consume the entire input buffer passed in, so we don't have to worry
+                // about bytes left over in the front block with more input remaining.
+                return DecodeResult::NeedInput;
+            case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+                return DecodeResult::MoreOutput;
+        }
+    }
+
+  private:
+    std::unique_ptr<BrotliDecoderState, void (*)(BrotliDecoderState*)> decoder_;
+};
+
+struct BrotliEncoder final : public Encoder {
+    explicit BrotliEncoder(size_t output_block_size)
+        : Encoder(output_block_size),
+          encoder_(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr),
+                   BrotliEncoderDestroyInstance) {
+        BrotliEncoderSetParameter(encoder_.get(), BROTLI_PARAM_QUALITY, 1);
+    }
+
+    EncodeResult Encode(Block* output) final {
+        output->clear();
+        while (true) {
+            size_t available_in = input_buffer_.front_size();
+            const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input_buffer_.front_data());
+
+            size_t available_out = output_bytes_left_;
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(
+                    output_block_.data() + (output_block_size_ - output_bytes_left_));
+
+            BrotliEncoderOperation op = BROTLI_OPERATION_PROCESS;
+            if (finished_) {
+                op = BROTLI_OPERATION_FINISH;
+            }
+
+            if (!BrotliEncoderCompressStream(encoder_.get(), op, &available_in, &next_in,
+                                             &available_out, &next_out, nullptr)) {
+                return EncodeResult::Error;
+            }
+
+            size_t bytes_consumed = input_buffer_.front_size() - available_in;
+            input_buffer_.drop_front(bytes_consumed);
+
+            output_bytes_left_ = available_out;
+
+            if (BrotliEncoderIsFinished(encoder_.get())) {
+                output_block_.resize(output_block_size_ - output_bytes_left_);
+                *output = std::move(output_block_);
+                return EncodeResult::Done;
+            } else if (output_bytes_left_ == 0) {
+                *output = std::move(output_block_);
+                output_block_.resize(output_block_size_);
+                output_bytes_left_ = output_block_size_;
+                return EncodeResult::MoreOutput;
+            } else if (input_buffer_.empty()) {
+                return EncodeResult::NeedInput;
+            }
+        }
+    }
+
+  private:
+    std::unique_ptr<BrotliEncoderState, void (*)(BrotliEncoderState*)> encoder_;
+};
+
+struct LZ4Decoder final : public Decoder {
+    explicit LZ4Decoder(std::span<char> output_buffer)
+        : Decoder(output_buffer), decoder_(nullptr, nullptr) {
+        LZ4F_dctx* dctx;
+        if (LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION) != 0) {
+            LOG(FATAL) << "failed to initialize LZ4 decompression context";
+        }
+        decoder_ = std::unique_ptr<LZ4F_dctx, LZ4F_errorCode_t (*)(LZ4F_dctx*)>(
+                dctx, LZ4F_freeDecompressionContext);
+    }
+
+    DecodeResult Decode(std::span<char>* output) final {
+        size_t available_in = input_buffer_.front_size();
+        const char* next_in = input_buffer_.front_data();
+
+        size_t available_out = output_buffer_.size();
+        char* next_out = output_buffer_.data();
+
+        // On return, available_in and available_out hold the bytes consumed and emitted.
+        size_t rc = LZ4F_decompress(decoder_.get(), next_out, &available_out, next_in,
+                                    &available_in, nullptr);
+        if (LZ4F_isError(rc)) {
+            LOG(ERROR) << "LZ4F_decompress failed: " << LZ4F_getErrorName(rc);
+            return DecodeResult::Error;
+        }
+
+        input_buffer_.drop_front(available_in);
+        *output = std::span<char>(output_buffer_.data(), available_out);
+
+        // A return value of 0 means that a frame was fully decoded and flushed.
+        if (rc == 0 && input_buffer_.empty()) {
+            return DecodeResult::Done;
+        } else if (available_out == output_buffer_.size() || !input_buffer_.empty()) {
+            return DecodeResult::MoreOutput;
+        }
+        return DecodeResult::NeedInput;
+    }
+
+  private:
+    std::unique_ptr<LZ4F_dctx, LZ4F_errorCode_t (*)(LZ4F_dctx*)> decoder_;
+};
+
+struct LZ4Encoder final : public Encoder {
+    explicit LZ4Encoder(size_t output_block_size)
+        : Encoder(output_block_size), encoder_(nullptr, nullptr) {
+        LZ4F_cctx* cctx;
+        if (LZ4F_createCompressionContext(&cctx, LZ4F_VERSION) != 0) {
+            LOG(FATAL) << "failed to initialize LZ4 compression context";
+        }
+        encoder_ = std::unique_ptr<LZ4F_cctx, LZ4F_errorCode_t (*)(LZ4F_cctx*)>(
+                cctx, LZ4F_freeCompressionContext);
+
+        // LZ4F_compressUpdate needs room for the worst case of each input block, so compress
+        // into a staging buffer and hand it out in output_block_size pieces.
+        staging_.resize(std::max(LZ4F_compressBound(output_block_size, nullptr),
+                                 static_cast<size_t>(LZ4F_HEADER_SIZE_MAX)));
+    }
+
+    EncodeResult Encode(Block* output) final {
+        output->clear();
+        while (true) {
+            if (staged_offset_ < staged_size_) {
+                size_t length = std::min(staged_size_ - staged_offset_, output_block_size_);
+                output->assign(staging_.data() + staged_offset_,
+                               staging_.data() + staged_offset_ + length);
+                staged_offset_ += length;
+                if (staged_offset_ == staged_size_ && ended_) {
+                    return EncodeResult::Done;
+                }
+                return EncodeResult::MoreOutput;
+            }
+
+            size_t rc;
+            if (!begun_) {
+                rc = LZ4F_compressBegin(encoder_.get(), staging_.data(), staging_.size(), nullptr);
+                begun_ = true;
+            } else if (!input_buffer_.empty()) {
+                // Input blocks can be larger than what the staging buffer is sized for.
+                size_t length = std::min(input_buffer_.front_size(), output_block_size_);
+                rc = LZ4F_compressUpdate(encoder_.get(), staging_.data(), staging_.size(),
+                                         input_buffer_.front_data(), length, nullptr);
+                input_buffer_.drop_front(length);
+            } else if (finished_ && !ended_) {
+                rc = LZ4F_compressEnd(encoder_.get(), staging_.data(), staging_.size(), nullptr);
+                ended_ = true;
+            } else if (ended_) {
+                return EncodeResult::Done;
+            } else {
+                return EncodeResult::NeedInput;
+            }
+
+            if (LZ4F_isError(rc)) {
+                LOG(ERROR) << "LZ4F compression failed: " << LZ4F_getErrorName(rc);
+                return EncodeResult::Error;
+            }
+            staged_offset_ = 0;
+            staged_size_ = rc;
+        }
+    }
+
+  private:
+    std::unique_ptr<LZ4F_cctx, LZ4F_errorCode_t (*)(LZ4F_cctx*)> encoder_;
+    std::vector<char> staging_;
+    size_t staged_offset_ = 0;
+    size_t staged_size_ = 0;
+    bool begun_ = false;
+    bool ended_ = false;
+};
+
+struct ZstdDecoder final : public Decoder {
+    explicit ZstdDecoder(std::span<char> output_buffer)
+        : Decoder(output_buffer), decoder_(ZSTD_createDStream(), ZSTD_freeDStream) {
+        if (!decoder_) {
+            LOG(FATAL) << "failed to initialize Zstd decompression context";
+        }
+    }
+
+    DecodeResult Decode(std::span<char>* output) final {
+        ZSTD_inBuffer in = {input_buffer_.front_data(), input_buffer_.front_size(), 0};
+        ZSTD_outBuffer out = {output_buffer_.data(), output_buffer_.size(), 0};
+
+        size_t rc = ZSTD_decompressStream(decoder_.get(), &out, &in);
+        if (ZSTD_isError(rc)) {
+            LOG(ERROR) << "ZSTD_decompressStream failed: " << ZSTD_getErrorName(rc);
+            return DecodeResult::Error;
+        }
+
+        input_buffer_.drop_front(in.pos);
+        *output = std::span<char>(output_buffer_.data(), out.pos);
+
+        // A return value of 0 means that a frame was fully decoded and flushed.
+        if (rc == 0 && input_buffer_.empty()) {
+            return DecodeResult::Done;
+        } else if (out.pos == out.size || !input_buffer_.empty()) {
+            return DecodeResult::MoreOutput;
+        }
+        return DecodeResult::NeedInput;
+    }
+
+  private:
+    std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> decoder_;
+};
+
+struct ZstdEncoder final : public Encoder {
+    explicit ZstdEncoder(size_t output_block_size)
+        : Encoder(output_block_size), encoder_(ZSTD_createCStream(), ZSTD_freeCStream) {
+        if (!encoder_) {
+            LOG(FATAL) << "failed to initialize Zstd compression context";
+        }
+        ZSTD_CCtx_setParameter(encoder_.get(), ZSTD_c_compressionLevel, 1);
+    }
+
+    EncodeResult Encode(Block* output) final {
+        output->clear();
+        while (true) {
+            ZSTD_inBuffer in = {input_buffer_.front_data(), input_buffer_.front_size(), 0};
+            ZSTD_outBuffer out = {output_block_.data() + (output_block_size_ - output_bytes_left_),
+                                  output_bytes_left_, 0};
+
+            // Only end the frame once the last of the input is being passed in.
+            ZSTD_EndDirective directive = ZSTD_e_continue;
+            if (finished_ && input_buffer_.front_size() == input_buffer_.size()) {
+                directive = ZSTD_e_end;
+            }
+
+            size_t rc = ZSTD_compressStream2(encoder_.get(), &out, &in, directive);
+            if (ZSTD_isError(rc)) {
+                LOG(ERROR) << "ZSTD_compressStream2 failed: " << ZSTD_getErrorName(rc);
+                return EncodeResult::Error;
+            }
+
+            input_buffer_.drop_front(in.pos);
+            output_bytes_left_ -= out.pos;
+
+            if (directive == ZSTD_e_end && rc == 0) {
+                output_block_.resize(output_block_size_ - output_bytes_left_);
+                *output = std::move(output_block_);
+                return EncodeResult::Done;
+            } else if (output_bytes_left_ == 0) {
+                *output = std::move(output_block_);
+                output_block_.resize(output_block_size_);
+                output_bytes_left_ = output_block_size_;
+                return EncodeResult::MoreOutput;
+            } else if (input_buffer_.empty() && !finished_) {
+                return EncodeResult::NeedInput;
+            }
+        }
+    }
+
+  private:
+    std::unique_ptr<ZSTD_CStream, size_t (*)(ZSTD_CStream*)> encoder_;
+};
+
+static inline std::unique_ptr<Decoder> CreateDecoder(CompressionType type,
+                                                     std::span<char> output_buffer) {
+    switch (type) {
+        case CompressionType::Brotli:
+            return std::make_unique<BrotliDecoder>(output_buffer);
+        case CompressionType::LZ4:
+            return std::make_unique<LZ4Decoder>(output_buffer);
+        case CompressionType::Zstd:
+            return std::make_unique<ZstdDecoder>(output_buffer);
+        default:
+            LOG(FATAL) << "CreateDecoder: unsupported compression type " << static_cast<int>(type);
+            __builtin_unreachable();
+    }
+}
+
+static inline std::unique_ptr<Encoder> CreateEncoder(CompressionType type,
+                                                     size_t output_block_size) {
+    switch (type) {
+        case CompressionType::Brotli:
+            return std::make_unique<BrotliEncoder>(output_block_size);
+        case CompressionType::LZ4:
+            return std::make_unique<LZ4Encoder>(output_block_size);
+        case CompressionType::Zstd:
+            return std::make_unique<ZstdEncoder>(output_block_size);
+        default:
+            LOG(FATAL) << "CreateEncoder: unsupported compression type " << static_cast<int>(type);
+            __builtin_unreachable();
+    }
+}
+
+// Compresses `input` on its own, as a single LZ4 or Zstd frame. Concatenations of such frames can
+// be decoded by LZ4Decoder and ZstdDecoder, which lets independent chunks of a stream be
+// compressed in parallel.
+static inline bool CompressFrame(CompressionType type, const Block& input, Block* output) {
+    size_t rc;
+    switch (type) {
+        case CompressionType::LZ4: {
+            LZ4F_preferences_t preferences = {};
+            preferences.frameInfo.contentSize = input.size();
+            output->clear();
+            output->resize(LZ4F_compressFrameBound(input.size(), &preferences));
+            rc = LZ4F_compressFrame(output->data(), output->size(), input.data(), input.size(),
+                                    &preferences);
+            if (LZ4F_isError(rc)) {
+                LOG(ERROR) << "LZ4F_compressFrame failed: " << LZ4F_getErrorName(rc);
+                return false;
+            }
+            break;
+        }
+
+        case CompressionType::Zstd:
+            output->clear();
+            output->resize(ZSTD_compressBound(input.size()));
+            rc = ZSTD_compress(output->data(), output->size(), input.data(), input.size(), 1);
+            if (ZSTD_isError(rc)) {
+                LOG(ERROR) << "ZSTD_compress failed: " << ZSTD_getErrorName(rc);
+                return false;
+            }
+            break;
+
+        default:
+            LOG(FATAL) << "CompressFrame: unsupported compression type "
+                       << static_cast<int>(type);
+            __builtin_unreachable();
+    }
+
+    output->resize(rc);
+    return true;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "compression_utils.h"
+
+// Text-like input that compresses well, with some noise mixed in.
+static std::string create_input(size_t length) {
+    std::string input;
+    input.reserve(length);
+    uint32_t state = 1;
+    while (input.size() < length) {
+        state = state * 1103515245 + 12345;
+        if (state % 4 == 0) {
+            input.push_back(static_cast<char>(state >> 24));
+        } else {
+            input.append("the quick brown fox ");
+        }
+    }
+    input.resize(length);
+    return input;
+}
+
+static Block create_block(const std::string& string) {
+    return Block(string.begin(), string.end());
+}
+
+// Feeds input to the encoder in chunks of input_block_size, and returns the compressed blocks.
+static bool encode(Encoder* encoder, const std::string& input, size_t input_block_size,
+                   std::vector<Block>* output) {
+    size_t offset = 0;
+    while (true) {
+        if (offset < input.size()) {
+            size_t length = std::min(input_block_size, input.size() - offset);
+            encoder->Append(create_block(input.substr(offset, length)));
+            offset += length;
+        } else {
+            encoder->Finish();
+        }
+
+        while (true) {
+            Block block;
+            EncodeResult result = encoder->Encode(&block);
+            if (!block.empty()) {
+                output->push_back(std::move(block));
+            }
+            if (result == EncodeResult::Error) {
+                return false;
+            } else if (result == EncodeResult::Done) {
+                return true;
+            } else if (result == EncodeResult::NeedInput) {
+                break;
+            }
+        }
+    }
+}
+
+// Like the sync code, hands the decoder one block at a time and drains it before the next.
+static bool decode(Decoder* decoder, std::vector<Block>* input, std::string* output) {
+    DecodeResult result = DecodeResult::NeedInput;
+    for (Block& block : *input) {
+        if (result != DecodeResult::NeedInput && result != DecodeResult::Done) {
+            return false;
+        }
+        decoder->Append(std::move(block));
+        do {
+            std::span<char> span;
+            result = decoder->Decode(&span);
+            output->append(span.data(), span.size());
+        } while (result == DecodeResult::MoreOutput);
+    }
+    return result == DecodeResult::Done;
+}
+
+static void round_trip(CompressionType type, size_t input_size, size_t block_size) {
+    std::string input = create_input(input_size);
+
+    std::vector<Block> compressed;
+    std::unique_ptr<Encoder> encoder = CreateEncoder(type, block_size);
+    ASSERT_TRUE(encode(encoder.get(), input, block_size, &compressed));
+    size_t compressed_size = 0;
+    for (const Block& block : compressed) {
+        ASSERT_LE(block.size(), block_size);
+        compressed_size += block.size();
+    }
+    if (input_size > 0) {
+        ASSERT_LT(compressed_size, input_size);
+    }
+
+    std::vector<char> output_buffer(block_size);
+    std::unique_ptr<Decoder> decoder = CreateDecoder(type, output_buffer);
+    std::string output;
+    ASSERT_TRUE(decode(decoder.get(), &compressed, &output));
+    ASSERT_EQ(input, output);
+}
+
+class CompressionTest : public ::testing::TestWithParam<CompressionType> {};
+
+TEST_P(CompressionTest, round_trip_empty) {
+    round_trip(GetParam(), 0, 64 * 1024);
+}
+
+TEST_P(CompressionTest, round_trip) {
+    round_trip(GetParam(), 1024 * 1024, 64 * 1024);
+}
+
+TEST_P(CompressionTest, round_trip_small_blocks) {
+    round_trip(GetParam(), 256 * 1024, 1000);
+}
+
+INSTANTIATE_TEST_SUITE_P(Compression, CompressionTest,
+                         ::testing::Values(CompressionType::Brotli, CompressionType::LZ4,
+                                           CompressionType::Zstd));
+
+class CompressFrameTest : public ::testing::TestWithParam<CompressionType> {};
+
+TEST_P(CompressFrameTest, concatenated_frames) {
+    std::string input = create_input(512 * 1024);
+
+    // Compress independent chunks of the input, as the parallel sync path does.
+    std::vector<Block> compressed;
+    const size_t chunk_size = 100 * 1000;
+    for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+        Block frame;
+        ASSERT_TRUE(CompressFrame(GetParam(), create_block(input.substr(offset, chunk_size)),
+                                  &frame));
+        compressed.push_back(std::move(frame));
+    }
+
+    std::vector<char> output_buffer(64 * 1024);
+    std::unique_ptr<Decoder> decoder = CreateDecoder(GetParam(), output_buffer);
+    std::string output;
+    ASSERT_TRUE(decode(decoder.get(), &compressed, &output));
+    ASSERT_EQ(input, output);
+}
+
+INSTANTIATE_TEST_SUITE_P(Compression, CompressFrameTest,
+                         ::testing::Values(CompressionType::LZ4, CompressionType::Zstd));
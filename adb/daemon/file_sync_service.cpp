@@ -31,10 +31,16 @@
 #include <unistd.h>
 #include <utime.h>
 
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <span>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -57,7 +63,7 @@
 #include "adb_io.h"
 #include "adb_trace.h"
 #include "adb_utils.h"
-#include "brotli_utils.h"
+#include "compression_utils.h"
 #include "file_sync_protocol.h"
 #include "security_log_tags.h"
 #include "sysdeps/errno.h"
@@ -100,6 +106,11 @@ static bool update_capabilities(const char* path, uint64_t capabilities) {
 static bool secure_mkdirs(const std::string& path) {
     if (path[0] != '/') return false;
 
+    // Pushes are written by several threads. Without this, one could find a directory that
+    // another has just created and write into it before its owner, label and capabilities are set.
+    static std::mutex mkdirs_mutex;
+    std::lock_guard<std::mutex> lock(mkdirs_mutex);
+
     std::vector<std::string> path_components = android::base::Split(path, "/");
     std::string partial_path;
     for (const auto& path_component : path_components) {
@@ -266,10 +277,388 @@ static bool SendSyncFailErrno(borrowed_fd fd, const std::string& reason) {
     return SendSyncFail(fd, StringPrintf("%s: %s", reason.c_str(), strerror(errno)));
 }
 
-static bool handle_send_file_compressed(borrowed_fd s, unique_fd fd, uint32_t* timestamp) {
+// Pushes of small files are received into memory on the sync thread, and then written out by a
+// pool of worker threads. This lets the filesystem work for one file (creating it, fchown,
+// restorecon, writing it, utimes) overlap with receiving the next ones, which is what dominates
+// pushes of many small files. Responses are still sent in the order of the requests.
+static constexpr size_t kSyncWorkerThreads = 4;
+
+// Largest push (in bytes on the wire) that will be buffered and handed to the worker pool.
+static constexpr size_t kSyncMaxBufferedSendSize = 4 * SYNC_DATA_MAX;
+
+// The client stops to read responses once it has 128 outstanding (see
+// SyncConnection::ReadAcknowledgements), so keeping at most that many files in flight means that
+// writing a response never blocks on the client.
+static constexpr size_t kSyncMaxPendingSends = 128;
+static constexpr size_t kSyncMaxPendingBytes = 8 * 1024 * 1024;
+
+struct BufferedSend {
+    std::string path;
+    mode_t mode;
+    CompressionType compression;
+    uint32_t timestamp = 0;
+    size_t size = 0;
+    std::vector<Block> data;
+};
+
+static bool write_buffered_send(BufferedSend& send, std::string* error);
+
+class SyncSendPool {
+  public:
+    explicit SyncSendPool(borrowed_fd s) : s_(s) {}
+
+    // Pushes that were fully received are still written, even if the connection is going away.
+    ~SyncSendPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cv_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Queues a push to be written by a worker, waiting while too many are already in flight.
+    // Returns false if an earlier push failed.
+    bool Enqueue(BufferedSend send) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (threads_.empty()) {
+            for (size_t i = 0; i < kSyncWorkerThreads; ++i) {
+                threads_.emplace_back([this]() { WorkerMain(); });
+            }
+        }
+
+        // Pushes to the same path must happen in order, so wait for an earlier one to finish.
+        cv_.wait(lock, [this, &send]() {
+            return failed_ || (pending_sends_ < kSyncMaxPendingSends &&
+                               pending_bytes_ + send.size <= kSyncMaxPendingBytes &&
+                               pending_paths_.count(send.path) == 0);
+        });
+        if (failed_) return false;
+
+        ++pending_sends_;
+        pending_bytes_ += send.size;
+        pending_paths_.insert(send.path);
+        queue_.emplace_back(next_seq_++, std::move(send));
+        cv_.notify_all();
+        return true;
+    }
+
+    // Waits until every queued push has been written and responded to.
+    // Returns false if any of them failed.
+    bool Flush() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return failed_ || next_ack_seq_ == next_seq_; });
+        }
+
+        // Wait for a worker that's still writing the last responses.
+        std::lock_guard<std::mutex> response_lock(response_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !failed_;
+    }
+
+  private:
+    struct Result {
+        bool success;
+        std::string error;
+    };
+
+    void WorkerMain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+
+            auto [seq, send] = std::move(queue_.front());
+            queue_.pop_front();
+
+            // Don't start on anything that was queued after a failure.
+            Result result = {.success = false};
+            if (!failed_) {
+                lock.unlock();
+                result.success = write_buffered_send(send, &result.error);
+                lock.lock();
+            }
+
+            pending_bytes_ -= send.size;
+            pending_paths_.erase(send.path);
+            results_.emplace(seq, std::move(result));
+            lock.unlock();
+
+            SendResponses();
+
+            lock.lock();
+            cv_.notify_all();
+        }
+    }
+
+    // Sends the responses for the completed pushes at the head of the queue, in order.
+    void SendResponses() {
+        std::lock_guard<std::mutex> response_lock(response_mutex_);
+
+        std::vector<Result> results;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = results_.find(next_ack_seq_); it != results_.end();
+                 it = results_.find(next_ack_seq_)) {
+                results.push_back(std::move(it->second));
+                results_.erase(it);
+                ++next_ack_seq_;
+                --pending_sends_;
+            }
+            if (failed_) return;
+        }
+
+        for (const Result& result : results) {
+            if (!result.success) {
+                SendSyncFail(s_, result.error);
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                return;
+            }
+
+            syncmsg msg;
+            msg.status.id = ID_OKAY;
+            msg.status.msglen = 0;
+            if (!WriteFdExactly(s_, &msg.status, sizeof(msg.status))) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                return;
+            }
+        }
+    }
+
+    borrowed_fd s_;
+
+    // Serializes writing responses to the socket, so they go out in order.
+    std::mutex response_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::thread> threads_;
+    std::deque<std::pair<uint64_t, BufferedSend>> queue_;
+    std::map<uint64_t, Result> results_;
+    std::set<std::string> pending_paths_;
+    size_t pending_sends_ = 0;
+    size_t pending_bytes_ = 0;
+    uint64_t next_seq_ = 0;
+    uint64_t next_ack_seq_ = 0;
+    bool failed_ = false;
+    bool quit_ = false;
+};
+
+// Removes whatever is at `path` if a push with the given mode should replace it.
+// Returns whether `path` should be removed if the push fails.
+static bool prepare_send_path(const std::string& path, mode_t mode) {
+    // Don't delete files before copying if they are not "regular" or symlinks.
+    struct stat st;
+    bool do_unlink = (lstat(path.c_str(), &st) == -1) || S_ISREG(st.st_mode) ||
+                     (S_ISLNK(st.st_mode) && !S_ISLNK(mode));
+    if (do_unlink) {
+        adb_unlink(path.c_str());
+    }
+    return do_unlink;
+}
+
+// Works out the mode, ownership and capabilities of a pushed regular file.
+static void get_send_file_attributes(const std::string& path, mode_t* mode, uid_t* uid,
+                                     gid_t* gid, uint64_t* capabilities) {
+    // Copy user permission bits to "group" and "other" permissions.
+    *mode &= 0777;
+    *mode |= ((*mode >> 3) & 0070);
+    *mode |= ((*mode >> 3) & 0007);
+
+    *uid = -1;
+    *gid = -1;
+    *capabilities = 0;
+    if (should_use_fs_config(path)) {
+        adbd_fs_config(path.c_str(), 0, nullptr, uid, gid, mode, capabilities);
+    }
+}
+
+// Creates a pushed file (and any missing parent directories) and sets its ownership and mode.
+// On failure, returns an invalid fd and sets `error`.
+static unique_fd create_send_file(const char* path, uid_t uid, gid_t gid, mode_t mode,
+                                  std::string* error) {
+    unique_fd fd(adb_open_mode(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode));
+
+    if (fd < 0 && errno == ENOENT) {
+        if (!secure_mkdirs(Dirname(path))) {
+            *error = StringPrintf("secure_mkdirs failed: %s", strerror(errno));
+            return unique_fd();
+        }
+        fd.reset(adb_open_mode(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode));
+    }
+    if (fd < 0 && errno == EEXIST) {
+        fd.reset(adb_open_mode(path, O_WRONLY | O_CLOEXEC, mode));
+    }
+    if (fd < 0) {
+        *error = StringPrintf("couldn't create file: %s", strerror(errno));
+        return unique_fd();
+    }
+
+    if (fchown(fd.get(), uid, gid) == -1) {
+        *error = StringPrintf("fchown failed: %s", strerror(errno));
+        return unique_fd();
+    }
+
+#if defined(__ANDROID__)
+    // Not all filesystems support setting SELinux labels. http://b/23530370.
+    selinux_android_restorecon(path, 0);
+#endif
+
+    // fchown clears the setuid bit - restore it if present.
+    // Ignore the result of calling fchmod. It's not supported
+    // by all filesystems, so we don't check for success. b/12441485
+    fchmod(fd.get(), mode);
+
+    int rc = posix_fadvise(fd.get(), 0, 0,
+                           POSIX_FADV_SEQUENTIAL | POSIX_FADV_NOREUSE | POSIX_FADV_WILLNEED);
+    if (rc != 0) {
+        D("[ Failed to fadvise: %s ]", strerror(rc));
+    }
+    return fd;
+}
+
+static void set_send_timestamp(const std::string& path, uint32_t timestamp) {
+    struct timeval tv[2];
+    tv[0].tv_sec = timestamp;
+    tv[0].tv_usec = 0;
+    tv[1].tv_sec = timestamp;
+    tv[1].tv_usec = 0;
+    lutimes(path.c_str(), tv);
+}
+
+// Decompresses whatever input `decoder` has available to `fd`.
+static bool decode_send_data(Decoder& decoder, borrowed_fd fd, std::string* error) {
+    while (true) {
+        std::span<char> output;
+        DecodeResult result = decoder.Decode(&output);
+        if (result == DecodeResult::Error) {
+            *error = StringPrintf("decompress failed: %s", strerror(errno));
+            return false;
+        }
+
+        if (!WriteFdExactly(fd, output.data(), output.size())) {
+            *error = StringPrintf("write failed: %s", strerror(errno));
+            return false;
+        }
+
+        if (result == DecodeResult::NeedInput) {
+            return true;
+        } else if (result == DecodeResult::MoreOutput) {
+            continue;
+        } else if (result == DecodeResult::Done) {
+            return true;
+        } else {
+            LOG(FATAL) << "invalid DecodeResult: " << static_cast<int>(result);
+        }
+    }
+}
+
+static bool write_buffered_send(BufferedSend& send, std::string* error) {
+    bool do_unlink = prepare_send_path(send.path, send.mode);
+
+    mode_t mode = send.mode;
+    uid_t uid;
+    gid_t gid;
+    uint64_t capabilities;
+    get_send_file_attributes(send.path, &mode, &uid, &gid, &capabilities);
+
+    __android_log_security_bswrite(SEC_TAG_ADB_SEND_FILE, send.path.c_str());
+
+    bool result = false;
+    {
+        unique_fd fd = create_send_file(send.path.c_str(), uid, gid, mode, error);
+        if (fd >= 0) {
+            result = true;
+            if (send.compression != CompressionType::None) {
+                Block decode_buffer(SYNC_DATA_MAX);
+                std::unique_ptr<Decoder> decoder = CreateDecoder(
+                        send.compression, std::span(decode_buffer.data(), decode_buffer.size()));
+                for (Block& block : send.data) {
+                    decoder->Append(std::move(block));
+                    if (!decode_send_data(*decoder, fd, error)) {
+                        result = false;
+                        break;
+                    }
+                }
+            } else {
+                for (const Block& block : send.data) {
+                    if (!WriteFdExactly(fd, block.data(), block.size())) {
+                        *error = StringPrintf("write failed: %s", strerror(errno));
+                        result = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (result && !update_capabilities(send.path.c_str(), capabilities)) {
+        *error = StringPrintf("update_capabilities failed: %s", strerror(errno));
+        result = false;
+    }
+
+    if (!result) {
+        if (do_unlink) adb_unlink(send.path.c_str());
+        return false;
+    }
+
+    set_send_timestamp(send.path, send.timestamp);
+    return true;
+}
+
+// Receives the data of a push into memory, until either the whole file has been received (in
+// which case `done` is set) or it turns out to be too large to buffer.
+static bool receive_buffered_send(borrowed_fd s, BufferedSend* send, bool* done,
+                                  SyncSendPool& pool) {
+    syncmsg msg;
+    *done = false;
+    while (send->size <= kSyncMaxBufferedSendSize) {
+        if (!ReadFdExactly(s, &msg.data, sizeof(msg.data))) return false;
+
+        if (msg.data.id != ID_DATA) {
+            if (msg.data.id == ID_DONE) {
+                send->timestamp = msg.data.size;
+                *done = true;
+                return true;
+            }
+            if (pool.Flush()) SendSyncFail(s, "invalid data message");
+            return false;
+        }
+
+        if (msg.data.size > SYNC_DATA_MAX) {
+            if (pool.Flush()) SendSyncFail(s, "oversize data message");
+            return false;
+        }
+
+        Block block(msg.data.size);
+        if (!ReadFdExactly(s, block.data(), msg.data.size)) return false;
+        send->size += msg.data.size;
+        send->data.push_back(std::move(block));
+    }
+    return true;
+}
+
+static bool handle_send_file_compressed(borrowed_fd s, unique_fd fd, uint32_t* timestamp,
+                                        CompressionType compression,
+                                        std::vector<Block> received) {
     syncmsg msg;
     Block decode_buffer(SYNC_DATA_MAX);
-    BrotliDecoder decoder(std::span(decode_buffer.data(), decode_buffer.size()));
+    std::unique_ptr<Decoder> decoder =
+            CreateDecoder(compression, std::span(decode_buffer.data(), decode_buffer.size()));
+    std::string error;
+    for (Block& block : received) {
+        decoder->Append(std::move(block));
+        if (!decode_send_data(*decoder, fd, &error)) {
+            SendSyncFail(s, error);
+            return false;
+        }
+    }
+
     while (true) {
         if (!ReadFdExactly(s, &msg.data, sizeof(msg.data))) return false;
 
@@ -284,30 +673,11 @@ static bool handle_send_file_compressed(borrowed_fd s, unique_fd fd, uint32_t* t
 
         Block block(msg.data.size);
         if (!ReadFdExactly(s, block.data(), msg.data.size)) return false;
-        decoder.Append(std::move(block));
+        decoder->Append(std::move(block));
 
-        while (true) {
-            std::span<char> output;
-            BrotliDecodeResult result = decoder.Decode(&output);
-            if (result == BrotliDecodeResult::Error) {
-                SendSyncFailErrno(s, "decompress failed");
-                return false;
-            }
-
-            if (!WriteFdExactly(fd, output.data(), output.size())) {
-                SendSyncFailErrno(s, "write failed");
-                return false;
-            }
-
-            if (result == BrotliDecodeResult::NeedInput) {
-                break;
-            } else if (result == BrotliDecodeResult::MoreOutput) {
-                continue;
-            } else if (result == BrotliDecodeResult::Done) {
-                break;
-            } else {
-                LOG(FATAL) << "invalid BrotliDecodeResult: " << static_cast<int>(result);
-            }
+        if (!decode_send_data(*decoder, fd, &error)) {
+            SendSyncFail(s, error);
+            return false;
         }
     }
 
@@ -315,9 +685,16 @@ static bool handle_send_file_compressed(borrowed_fd s, unique_fd fd, uint32_t* t
 }
 
 static bool handle_send_file_uncompressed(borrowed_fd s, unique_fd fd, uint32_t* timestamp,
-                                          std::vector<char>& buffer) {
+                                          std::vector<char>& buffer, std::vector<Block> received) {
     syncmsg msg;
 
+    for (const Block& block : received) {
+        if (!WriteFdExactly(fd, block.data(), block.size())) {
+            SendSyncFailErrno(s, "write failed");
+            return false;
+        }
+    }
+
     while (true) {
         if (!ReadFdExactly(s, &msg.data, sizeof(msg.data))) return false;
 
@@ -343,57 +720,29 @@ static bool handle_send_file_uncompressed(borrowed_fd s, unique_fd fd, uint32_t*
 }
 
 static bool handle_send_file(borrowed_fd s, const char* path, uint32_t* timestamp, uid_t uid,
-                             gid_t gid, uint64_t capabilities, mode_t mode, bool compressed,
-                             std::vector<char>& buffer, bool do_unlink) {
-    int rc;
+                             gid_t gid, uint64_t capabilities, mode_t mode,
+                             CompressionType compression,
+                             std::vector<char>& buffer, bool do_unlink,
+                             std::vector<Block> received) {
     syncmsg msg;
+    std::string error;
 
     __android_log_security_bswrite(SEC_TAG_ADB_SEND_FILE, path);
 
-    unique_fd fd(adb_open_mode(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode));
-
-    if (fd < 0 && errno == ENOENT) {
-        if (!secure_mkdirs(Dirname(path))) {
-            SendSyncFailErrno(s, "secure_mkdirs failed");
-            goto fail;
-        }
-        fd.reset(adb_open_mode(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode));
-    }
-    if (fd < 0 && errno == EEXIST) {
-        fd.reset(adb_open_mode(path, O_WRONLY | O_CLOEXEC, mode));
-    }
+    unique_fd fd = create_send_file(path, uid, gid, mode, &error);
     if (fd < 0) {
-        SendSyncFailErrno(s, "couldn't create file");
+        SendSyncFail(s, error);
         goto fail;
-    } else {
-        if (fchown(fd.get(), uid, gid) == -1) {
-            SendSyncFailErrno(s, "fchown failed");
-            goto fail;
-        }
-
-#if defined(__ANDROID__)
-        // Not all filesystems support setting SELinux labels. http://b/23530370.
-        selinux_android_restorecon(path, 0);
-#endif
-
-        // fchown clears the setuid bit - restore it if present.
-        // Ignore the result of calling fchmod. It's not supported
-        // by all filesystems, so we don't check for success. b/12441485
-        fchmod(fd.get(), mode);
     }
 
     {
-        rc = posix_fadvise(fd.get(), 0, 0,
-                           POSIX_FADV_SEQUENTIAL | POSIX_FADV_NOREUSE | POSIX_FADV_WILLNEED);
-        if (rc != 0) {
-            D("[ Failed to fadvise: %s ]", strerror(rc));
-        }
-
         bool result;
-        if (compressed) {
-            result = handle_send_file_compressed(s, std::move(fd), timestamp);
+        if (compression != CompressionType::None) {
+            result = handle_send_file_compressed(s, std::move(fd), timestamp, compression,
+                                                 std::move(received));
         } else {
-            result = handle_send_file_uncompressed(s, std::move(fd), timestamp, buffer);
+            result = handle_send_file_uncompressed(s, std::move(fd), timestamp, buffer,
+                                                   std::move(received));
         }
 
         if (!result) {
@@ -499,55 +848,86 @@ static bool handle_send_link(int s, const std::string& path, uint32_t* timestamp
 }
 #endif
 
-static bool send_impl(int s, const std::string& path, mode_t mode, bool compressed,
-                      std::vector<char>& buffer) {
-    // Don't delete files before copying if they are not "regular" or symlinks.
-    struct stat st;
-    bool do_unlink = (lstat(path.c_str(), &st) == -1) || S_ISREG(st.st_mode) ||
-                     (S_ISLNK(st.st_mode) && !S_ISLNK(mode));
-    if (do_unlink) {
-        adb_unlink(path.c_str());
+static bool send_impl(int s, const std::string& path, mode_t mode, CompressionType compression,
+                      std::vector<char>& buffer, SyncSendPool& pool) {
+    // Hand small files to the worker pool once they've been received.
+    std::vector<Block> received;
+    if (!S_ISLNK(mode)) {
+        BufferedSend send = {.path = path, .mode = mode, .compression = compression};
+        bool done;
+        if (!receive_buffered_send(s, &send, &done, pool)) {
+            return false;
+        }
+        if (done) {
+            return pool.Enqueue(std::move(send));
+        }
+        received = std::move(send.data);
     }
 
+    // Anything else is written directly, after the pushes that are already in flight.
+    if (!pool.Flush()) {
+        return false;
+    }
+
+    bool do_unlink = prepare_send_path(path, mode);
+
     bool result;
     uint32_t timestamp;
     if (S_ISLNK(mode)) {
         result = handle_send_link(s, path, &timestamp, buffer);
     } else {
-        // Copy user permission bits to "group" and "other" permissions.
-        mode &= 0777;
-        mode |= ((mode >> 3) & 0070);
-        mode |= ((mode >> 3) & 0007);
-
-        uid_t uid = -1;
-        gid_t gid = -1;
-        uint64_t capabilities = 0;
-        if (should_use_fs_config(path)) {
-            adbd_fs_config(path.c_str(), 0, nullptr, &uid, &gid, &mode, &capabilities);
-        }
+        uid_t uid;
+        gid_t gid;
+        uint64_t capabilities;
+        get_send_file_attributes(path, &mode, &uid, &gid, &capabilities);
 
         result = handle_send_file(s, path.c_str(), &timestamp, uid, gid, capabilities, mode,
-                                  compressed, buffer, do_unlink);
+                                  compression, buffer, do_unlink, std::move(received));
     }
 
     if (!result) {
       return false;
     }
 
-    struct timeval tv[2];
-    tv[0].tv_sec = timestamp;
-    tv[0].tv_usec = 0;
-    tv[1].tv_sec = timestamp;
-    tv[1].tv_usec = 0;
-    lutimes(path.c_str(), tv);
+    set_send_timestamp(path, timestamp);
     return true;
 }
 
-static bool do_send_v1(int s, const std::string& spec, std::vector<char>& buffer) {
+// Works out the compression type requested by the flags of a send_v2 or recv_v2 request.
+static bool parse_compression_flags(uint32_t flags, CompressionType* compression,
+                                    std::string* error) {
+    switch (flags & (kSyncFlagBrotli | kSyncFlagLZ4 | kSyncFlagZstd)) {
+        case kSyncFlagNone:
+            *compression = CompressionType::None;
+            break;
+        case kSyncFlagBrotli:
+            *compression = CompressionType::Brotli;
+            break;
+        case kSyncFlagLZ4:
+            *compression = CompressionType::LZ4;
+            break;
+        case kSyncFlagZstd:
+            *compression = CompressionType::Zstd;
+            break;
+        default:
+            *error = StringPrintf("multiple compression flags: %d", flags);
+            return false;
+    }
+
+    flags &= ~(kSyncFlagBrotli | kSyncFlagLZ4 | kSyncFlagZstd);
+    if (flags) {
+        *error = StringPrintf("unknown flags: %d", flags);
+        return false;
+    }
+    return true;
+}
+
+static bool do_send_v1(int s, const std::string& spec, std::vector<char>& buffer,
+                       SyncSendPool& pool) {
     // 'spec' is of the form "/some/path,0755". Break it up.
     size_t comma = spec.find_last_of(',');
     if (comma == std::string::npos) {
-        SendSyncFail(s, "missing , in ID_SEND_V1");
+        if (pool.Flush()) SendSyncFail(s, "missing , in ID_SEND_V1");
         return false;
     }
 
@@ -556,14 +936,15 @@ static bool do_send_v1(int s, const std::string& spec, std::vector<char>& buffer
     errno = 0;
     mode_t mode = strtoul(spec.substr(comma + 1).c_str(), nullptr, 0);
     if (errno != 0) {
-        SendSyncFail(s, "bad mode");
+        if (pool.Flush()) SendSyncFail(s, "bad mode");
         return false;
     }
 
-    return send_impl(s, path, mode, false, buffer);
+    return send_impl(s, path, mode, CompressionType::None, buffer, pool);
 }
 
-static bool do_send_v2(int s, const std::string& path, std::vector<char>& buffer) {
+static bool do_send_v2(int s, const std::string& path, std::vector<char>& buffer,
+                       SyncSendPool& pool) {
     // Read the setup packet.
     syncmsg msg;
     int rc = ReadFdExactly(s, &msg.send_v2_setup, sizeof(msg.send_v2_setup));
@@ -574,24 +955,20 @@ static bool do_send_v2(int s, const std::string& path, std::vector<char>& buffer
         PLOG(ERROR) << "failed to read send_v2 setup packet";
     }
 
-    bool compressed = false;
-    if (msg.send_v2_setup.flags & kSyncFlagBrotli) {
-        msg.send_v2_setup.flags &= ~kSyncFlagBrotli;
-        compressed = true;
-    }
-    if (msg.send_v2_setup.flags) {
-        SendSyncFail(s, android::base::StringPrintf("unknown flags: %d", msg.send_v2_setup.flags));
+    CompressionType compression;
+    std::string error;
+    if (!parse_compression_flags(msg.send_v2_setup.flags, &compression, &error)) {
+        if (pool.Flush()) SendSyncFail(s, error);
         return false;
     }
 
     errno = 0;
-    return send_impl(s, path, msg.send_v2_setup.mode, compressed, buffer);
+    return send_impl(s, path, msg.send_v2_setup.mode, compression, buffer, pool);
 }
 
 static bool recv_uncompressed(borrowed_fd s, unique_fd fd, std::vector<char>& buffer) {
     syncmsg msg;
     msg.data.id = ID_DATA;
-    std::optional<BrotliEncoder<SYNC_DATA_MAX>> encoder;
     while (true) {
         int r = adb_read(fd.get(), &buffer[0], buffer.size() - sizeof(msg.data));
         if (r <= 0) {
@@ -609,11 +986,11 @@ static bool recv_uncompressed(borrowed_fd s, unique_fd fd, std::vector<char>& bu
     return true;
 }
 
-static bool recv_compressed(borrowed_fd s, unique_fd fd) {
+static bool recv_compressed(borrowed_fd s, unique_fd fd, CompressionType compression) {
     syncmsg msg;
     msg.data.id = ID_DATA;
 
-    BrotliEncoder<SYNC_DATA_MAX> encoder;
+    std::unique_ptr<Encoder> encoder = CreateEncoder(compression, SYNC_DATA_MAX);
 
     bool sending = true;
     while (sending) {
@@ -625,16 +1002,16 @@ static bool recv_compressed(borrowed_fd s, unique_fd fd) {
         }
 
         if (r == 0) {
-            encoder.Finish();
+            encoder->Finish();
         } else {
             input.resize(r);
-            encoder.Append(std::move(input));
+            encoder->Append(std::move(input));
         }
 
         while (true) {
             Block output;
-            BrotliEncodeResult result = encoder.Encode(&output);
-            if (result == BrotliEncodeResult::Error) {
+            EncodeResult result = encoder->Encode(&output);
+            if (result == EncodeResult::Error) {
                 SendSyncFailErrno(s, "compress failed");
                 return false;
             }
@@ -647,12 +1024,12 @@ static bool recv_compressed(borrowed_fd s, unique_fd fd) {
                 }
             }
 
-            if (result == BrotliEncodeResult::Done) {
+            if (result == EncodeResult::Done) {
                 sending = false;
                 break;
-            } else if (result == BrotliEncodeResult::NeedInput) {
+            } else if (result == EncodeResult::NeedInput) {
                 break;
-            } else if (result == BrotliEncodeResult::MoreOutput) {
+            } else if (result == EncodeResult::MoreOutput) {
                 continue;
             }
         }
@@ -661,7 +1038,8 @@ static bool recv_compressed(borrowed_fd s, unique_fd fd) {
     return true;
 }
 
-static bool recv_impl(borrowed_fd s, const char* path, bool compressed, std::vector<char>& buffer) {
+static bool recv_impl(borrowed_fd s, const char* path, CompressionType compression,
+                      std::vector<char>& buffer) {
     __android_log_security_bswrite(SEC_TAG_ADB_RECV_FILE, path);
 
     unique_fd fd(adb_open(path, O_RDONLY | O_CLOEXEC));
@@ -676,8 +1054,8 @@ static bool recv_impl(borrowed_fd s, const char* path, bool compressed, std::vec
     }
 
     bool result;
-    if (compressed) {
-        result = recv_compressed(s, std::move(fd));
+    if (compression != CompressionType::None) {
+        result = recv_compressed(s, std::move(fd), compression);
     } else {
         result = recv_uncompressed(s, std::move(fd), buffer);
     }
@@ -693,7 +1071,7 @@ static bool recv_impl(borrowed_fd s, const char* path, bool compressed, std::vec
 }
 
 static bool do_recv_v1(borrowed_fd s, const char* path, std::vector<char>& buffer) {
-    return recv_impl(s, path, false, buffer);
+    return recv_impl(s, path, CompressionType::None, buffer);
 }
 
 static bool do_recv_v2(borrowed_fd s, const char* path, std::vector<char>& buffer) {
@@ -707,17 +1085,14 @@ static bool do_recv_v2(borrowed_fd s, const char* path, std::vector<char>& buffe
         PLOG(ERROR) << "failed to read recv_v2 setup packet";
     }
 
-    bool compressed = false;
-    if (msg.recv_v2_setup.flags & kSyncFlagBrotli) {
-        msg.recv_v2_setup.flags &= ~kSyncFlagBrotli;
-        compressed = true;
-    }
-    if (msg.recv_v2_setup.flags) {
-        SendSyncFail(s, android::base::StringPrintf("unknown flags: %d", msg.recv_v2_setup.flags));
+    CompressionType compression;
+    std::string error;
+    if (!parse_compression_flags(msg.recv_v2_setup.flags, &compression, &error)) {
+        SendSyncFail(s, error);
         return false;
     }
 
-    return recv_impl(s, path, compressed, buffer);
+    return recv_impl(s, path, compression, buffer);
 }
 
 static const char* sync_id_to_name(uint32_t id) {
@@ -747,22 +1122,22 @@ static const char* sync_id_to_name(uint32_t id) {
   }
 }
 
-static bool handle_sync_command(int fd, std::vector<char>& buffer) {
+static bool handle_sync_command(int fd, std::vector<char>& buffer, SyncSendPool& pool) {
     D("sync: waiting for request");
 
     SyncRequest request;
     if (!ReadFdExactly(fd, &request, sizeof(request))) {
-        SendSyncFail(fd, "command read failure");
+        if (pool.Flush()) SendSyncFail(fd, "command read failure");
         return false;
     }
     size_t path_length = request.path_length;
     if (path_length > 1024) {
-        SendSyncFail(fd, "path too long");
+        if (pool.Flush()) SendSyncFail(fd, "path too long");
         return false;
     }
     char name[1025];
     if (!ReadFdExactly(fd, name, path_length)) {
-        SendSyncFail(fd, "filename read failure");
+        if (pool.Flush()) SendSyncFail(fd, "filename read failure");
         return false;
     }
     name[path_length] = 0;
@@ -770,6 +1145,13 @@ static bool handle_sync_command(int fd, std::vector<char>& buffer) {
     std::string id_name = sync_id_to_name(request.id);
 
     D("sync: %s('%s')", id_name.c_str(), name);
+
+    // Pushes can be in flight on the worker pool; everything else has to wait for them to finish,
+    // so that the responses stay in order.
+    if (request.id != ID_SEND_V1 && request.id != ID_SEND_V2 && !pool.Flush()) {
+        return false;
+    }
+
     switch (request.id) {
         case ID_LSTAT_V1:
             if (!do_lstat_v1(fd, name)) return false;
@@ -785,10 +1167,10 @@ static bool handle_sync_command(int fd, std::vector<char>& buffer) {
             if (!do_list_v2(fd, name)) return false;
             break;
         case ID_SEND_V1:
-            if (!do_send_v1(fd, name, buffer)) return false;
+            if (!do_send_v1(fd, name, buffer, pool)) return false;
             break;
         case ID_SEND_V2:
-            if (!do_send_v2(fd, name, buffer)) return false;
+            if (!do_send_v2(fd, name, buffer, pool)) return false;
             break;
         case ID_RECV_V1:
             if (!do_recv_v1(fd, name, buffer)) return false;
@@ -808,8 +1190,9 @@ static bool handle_sync_command(int fd, std::vector<char>& buffer) {
 
 void file_sync_service(unique_fd fd) {
     std::vector<char> buffer(SYNC_DATA_MAX);
+    SyncSendPool pool(fd);
 
-    while (handle_sync_command(fd.get(), buffer)) {
+    while (handle_sync_command(fd.get(), buffer, pool)) {
     }
 
     D("sync: done");
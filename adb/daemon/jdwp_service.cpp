@@ -308,8 +308,11 @@ static void jdwp_socket_ready(asocket* s) {
         data.resize(s->get_max_payload());
         size_t len = jdwp_process_list(&data[0], data.size());
         data.resize(len);
-        peer->enqueue(peer, std::move(data));
         jdwp->pass = true;
+        if (peer->enqueue(peer, std::move(data)) == 0) {
+            // The peer can take more data right away, so it won't call ready() again.
+            peer->close(peer);
+        }
     } else {
         peer->close(peer);
     }
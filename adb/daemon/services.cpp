@@ -219,16 +219,21 @@ struct SourceSocket : public ServiceSocket {
     virtual ~SourceSocket() { LOG(INFO) << "SourceSocket destroyed"; }
 
     void Ready() {
-        size_t len = std::min(bytes_left_, get_max_payload());
-        if (len == 0) {
-            Close();
-            return;
-        }
+        // Keep going for as long as the peer accepts data without asking us to wait for ready().
+        while (true) {
+            size_t len = std::min(bytes_left_, get_max_payload());
+            if (len == 0) {
+                Close();
+                return;
+            }
 
-        Block block(len);
-        memset(block.data(), 0, block.size());
-        peer->enqueue(peer, std::move(block));
-        bytes_left_ -= len;
+            Block block(len);
+            memset(block.data(), 0, block.size());
+            bytes_left_ -= len;
+            if (peer->enqueue(peer, std::move(block)) != 0) {
+                return;
+            }
+        }
     }
 
     int Enqueue(apacket::payload_type data) { return -1; }
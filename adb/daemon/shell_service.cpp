@@ -87,6 +87,7 @@
 #include <pwd.h>
 #include <termios.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <thread>
@@ -113,6 +114,15 @@
 
 namespace {
 
+using namespace std::chrono_literals;
+
+// Subprocess output is batched so that commands producing lots of small writes (dumpsys, find /)
+// don't turn into a packet per write. The first read after the output has been idle for a batch
+// window is sent right away, so interactive echo isn't delayed; reads that follow closely are
+// held for up to one window, or until a batch's worth of data has accumulated.
+constexpr auto kOutputBatchWindow = 2ms;
+constexpr size_t kOutputBatchBytes = 128 * 1024;
+
 // Reads from |fd| until close or failure.
 std::string ReadAll(borrowed_fd fd) {
     char buffer[512];
@@ -197,6 +207,9 @@ class Subprocess {
     unique_fd* PassInput();
     unique_fd* PassOutput(unique_fd* sfd, ShellProtocol::Id id);
 
+    // Sends any batched output. Returns false if the protocol FD failed.
+    bool FlushOutput();
+
     const std::string command_;
     const std::string terminal_type_;
     SubprocessType type_;
@@ -210,6 +223,12 @@ class Subprocess {
     std::unique_ptr<ShellProtocol> input_, output_;
     size_t input_bytes_left_ = 0;
 
+    // Output read into |output_| but not yet sent.
+    size_t output_pending_bytes_ = 0;
+    ShellProtocol::Id output_pending_id_ = ShellProtocol::kIdInvalid;
+    std::chrono::steady_clock::time_point output_deadline_;
+    std::chrono::steady_clock::time_point last_output_;
+
     DISALLOW_COPY_AND_ASSIGN(Subprocess);
 };
 
@@ -604,15 +623,30 @@ unique_fd* Subprocess::PollLoop(SubprocessPollfds* pfds) {
 
     // Keep calling poll() and passing data until an FD closes/errors.
     while (!dead_sfd) {
-        if (adb_poll(pfds->data(), pfds->size(), -1) < 0) {
+        int timeout_ms = -1;
+        if (output_pending_bytes_) {
+            auto time_left = std::chrono::ceil<std::chrono::milliseconds>(
+                    output_deadline_ - std::chrono::steady_clock::now());
+            timeout_ms = std::max<int>(0, time_left.count());
+        }
+
+        int rc = adb_poll(pfds->data(), pfds->size(), timeout_ms);
+        if (rc < 0) {
             if (errno == EINTR) {
                 continue;
             } else {
                 PLOG(ERROR) << "poll failed, closing subprocess pipes";
+                FlushOutput();
                 stdinout_sfd_.reset(-1);
                 stderr_sfd_.reset(-1);
                 return nullptr;
             }
+        } else if (rc == 0) {
+            // The batch window expired.
+            if (!FlushOutput()) {
+                return &protocol_sfd_;
+            }
+            continue;
         }
 
         // Read stdout, write to protocol FD.
@@ -621,7 +655,7 @@ unique_fd* Subprocess::PollLoop(SubprocessPollfds* pfds) {
         }
 
         // Read stderr, write to protocol FD.
-        if (!dead_sfd && stderr_pfd.fd != 1 && (stderr_pfd.revents & POLLIN)) {
+        if (!dead_sfd && stderr_pfd.fd != -1 && (stderr_pfd.revents & POLLIN)) {
             dead_sfd = PassOutput(&stderr_sfd_, ShellProtocol::kIdStderr);
         }
 
@@ -647,18 +681,30 @@ unique_fd* Subprocess::PollLoop(SubprocessPollfds* pfds) {
 
         // After handling all of the events we've received, check to see if any fds have died.
         if (stdinout_pfd.revents & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL)) {
-            return &stdinout_sfd_;
+            return FlushOutput() ? &stdinout_sfd_ : &protocol_sfd_;
         }
 
         if (stderr_pfd.revents & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL)) {
-            return &stderr_sfd_;
+            return FlushOutput() ? &stderr_sfd_ : &protocol_sfd_;
         }
 
         if (protocol_pfd.revents & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL)) {
             return &protocol_sfd_;
         }
+
+        // A steady stream of events keeps poll() from ever timing out, so check the batch window
+        // here as well.
+        if (!dead_sfd && output_pending_bytes_ &&
+            std::chrono::steady_clock::now() >= output_deadline_ && !FlushOutput()) {
+            return &protocol_sfd_;
+        }
     }  // while (!dead_sfd)
 
+    // Output read before a pipe died still has to go out, e.g. the last of a PTY's output when
+    // writing its input fails.
+    if (dead_sfd != &protocol_sfd_ && !FlushOutput()) {
+        return &protocol_sfd_;
+    }
     return dead_sfd;
 }
 
@@ -731,26 +777,58 @@ unique_fd* Subprocess::PassInput() {
 }
 
 unique_fd* Subprocess::PassOutput(unique_fd* sfd, ShellProtocol::Id id) {
-    int bytes = adb_read(*sfd, output_->data(), output_->data_capacity());
+    // A batch only holds data for one stream.
+    if (output_pending_bytes_ && output_pending_id_ != id && !FlushOutput()) {
+        return &protocol_sfd_;
+    }
+
+    int bytes = adb_read(*sfd, output_->data() + output_pending_bytes_,
+                         output_->data_capacity() - output_pending_bytes_);
     if (bytes == 0 || (bytes < 0 && errno != EAGAIN)) {
         // read() returns EIO if a PTY closes; don't report this as an error,
         // it just means the subprocess completed.
         if (bytes < 0 && !(type_ == SubprocessType::kPty && errno == EIO)) {
             PLOG(ERROR) << "error reading output FD " << sfd->get();
         }
-        return sfd;
+        return FlushOutput() ? sfd : &protocol_sfd_;
     }
 
-    if (bytes > 0 && !output_->Write(id, bytes)) {
-        if (errno != 0) {
-            PLOG(ERROR) << "error reading protocol FD " << protocol_sfd_.get();
+    if (bytes > 0) {
+        auto now = std::chrono::steady_clock::now();
+        bool idle = !output_pending_bytes_ && now - last_output_ >= kOutputBatchWindow;
+        if (!output_pending_bytes_) {
+            output_deadline_ = now + kOutputBatchWindow;
+        }
+        last_output_ = now;
+        output_pending_bytes_ += bytes;
+        output_pending_id_ = id;
+
+        if (idle || output_pending_bytes_ >= kOutputBatchBytes || now >= output_deadline_) {
+            if (!FlushOutput()) {
+                return &protocol_sfd_;
+            }
         }
-        return &protocol_sfd_;
     }
 
     return nullptr;
 }
 
+bool Subprocess::FlushOutput() {
+    if (!output_pending_bytes_) {
+        return true;
+    }
+
+    size_t length = output_pending_bytes_;
+    output_pending_bytes_ = 0;
+    if (!output_->Write(output_pending_id_, length)) {
+        if (errno != 0) {
+            PLOG(ERROR) << "error reading protocol FD " << protocol_sfd_.get();
+        }
+        return false;
+    }
+    return true;
+}
+
 void Subprocess::WaitForExit() {
     int exit_code = 1;
 
@@ -212,6 +212,11 @@ struct UsbFfsConnection : public Connection {
         auto header = std::make_shared<Block>(sizeof(packet->msg));
         memcpy(header->data(), &packet->msg, sizeof(packet->msg));
 
+        if (!packet->payload_chain.empty()) {
+            // The payload has to go out in kUsbWriteSize pieces regardless of how it was received.
+            packet->payload = std::move(packet->payload_chain).coalesce();
+        }
+
         std::lock_guard<std::mutex> lock(write_mutex_);
         write_requests_.push_back(
                 CreateWriteBlock(std::move(header), 0, sizeof(packet->msg), next_write_id_++));
@@ -595,8 +600,13 @@ struct UsbFfsConnection : public Connection {
                 auto packet = std::make_unique<apacket>();
                 packet->msg = *incoming_header_;
 
-                // TODO: Make apacket contain an IOVector so we don't have to coalesce.
-                packet->payload = std::move(incoming_payload_).coalesce();
+                // Stream data is handed to the destination socket as the blocks it was read into,
+                // which it writes out with writev. Everything else is small and gets parsed.
+                if (packet->msg.command == A_WRTE) {
+                    packet->payload_chain = std::move(incoming_payload_);
+                } else {
+                    packet->payload = std::move(incoming_payload_).coalesce();
+                }
                 read_callback_(this, std::move(packet));
 
                 incoming_header_.reset();
@@ -90,6 +90,7 @@ unique_fd fdevent_context::Destroy(fdevent* fde) {
     }
 
     this->Unregister(fde);
+    this->timeout_fdevents_.erase(fde);
 
     unique_fd fd = std::move(fde->fd);
 
@@ -113,6 +114,11 @@ void fdevent_context::SetTimeout(fdevent* fde, std::optional<std::chrono::millis
     CheckMainThread();
     fde->timeout = timeout;
     fde->last_active = std::chrono::steady_clock::now();
+    if (timeout) {
+        timeout_fdevents_.insert(fde);
+    } else {
+        timeout_fdevents_.erase(fde);
+    }
 }
 
 std::optional<std::chrono::milliseconds> fdevent_context::CalculatePollDuration() {
@@ -120,21 +126,17 @@ std::optional<std::chrono::milliseconds> fdevent_context::CalculatePollDuration(
     auto now = std::chrono::steady_clock::now();
     CheckMainThread();
 
-    for (const auto& [fd, fde] : this->installed_fdevents_) {
-        UNUSED(fd);
-        auto timeout_opt = fde.timeout;
-        if (timeout_opt) {
-            auto deadline = fde.last_active + *timeout_opt;
-            auto time_left = duration_cast<std::chrono::milliseconds>(deadline - now);
-            if (time_left < 0ms) {
-                time_left = 0ms;
-            }
+    for (const fdevent* fde : this->timeout_fdevents_) {
+        auto deadline = fde->last_active + *fde->timeout;
+        auto time_left = duration_cast<std::chrono::milliseconds>(deadline - now);
+        if (time_left < 0ms) {
+            time_left = 0ms;
+        }
 
-            if (!result) {
-                result = time_left;
-            } else {
-                result = std::min(*result, time_left);
-            }
+        if (!result) {
+            result = time_left;
+        } else {
+            result = std::min(*result, time_left);
         }
     }
 
@@ -172,12 +174,19 @@ void fdevent_context::CheckMainThread() {
 }
 
 void fdevent_context::Run(std::function<void()> fn) {
+    bool was_empty;
     {
         std::lock_guard<std::mutex> lock(run_queue_mutex_);
+        was_empty = run_queue_.empty();
         run_queue_.push_back(std::move(fn));
     }
 
-    Interrupt();
+    // FlushRunQueue keeps going until it finds the queue empty, so only the function that makes the
+    // queue non-empty needs to wake the loop up. This saves a syscall per function when other
+    // threads post work faster than the main thread can run it.
+    if (was_empty) {
+        Interrupt();
+    }
 }
 
 void fdevent_context::TerminateLoop() {
@@ -27,6 +27,7 @@
 #include <mutex>
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 
 #include <android-base/thread_annotations.h>
@@ -129,6 +130,10 @@ struct fdevent_context {
   protected:
     std::unordered_map<int, fdevent> installed_fdevents_;
 
+    // The subset of installed fdevents that have a timeout set, so that finding the next deadline
+    // and expired timeouts doesn't have to look at every fdevent.
+    std::unordered_set<fdevent*> timeout_fdevents_;
+
   private:
     uint64_t fdevent_id_ = 0;
     std::mutex run_queue_mutex_;
@@ -136,6 +141,13 @@ struct fdevent_context {
 };
 
 // Backwards compatibility shims that forward to the global fdevent_context.
+//
+// All sockets and transports share this one context. It can't be split into a loop per transport
+// yet: a host socket is installed before smart_socket_enqueue picks its transport, and an fdevent
+// can't move between contexts; asocket peers call each other's enqueue/ready/close directly;
+// `adb track-devices` sockets are notified of every transport's changes through the unlocked
+// device_tracker_list; and transport teardown, connection state and weak_ptr assert
+// check_main_thread().
 fdevent* fdevent_create(int fd, fd_func func, void* arg);
 fdevent* fdevent_create(int fd, fd_func2 func, void* arg);
 
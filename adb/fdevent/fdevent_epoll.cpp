@@ -109,13 +109,16 @@ void fdevent_context_epoll::Loop() {
 
     std::vector<fdevent_event> fde_events;
     std::vector<epoll_event> epoll_events;
-    epoll_events.resize(this->installed_fdevents_.size());
 
     while (true) {
         if (terminate_loop_) {
             break;
         }
 
+        // Size the buffer to what's installed now, so that a single epoll_wait can report every
+        // ready fd instead of draining them a few at a time when many transports are busy.
+        epoll_events.resize(this->installed_fdevents_.size());
+
         int rc = -1;
         while (rc == -1) {
             std::optional<std::chrono::milliseconds> timeout = CalculatePollDuration();
@@ -133,7 +136,7 @@ void fdevent_context_epoll::Loop() {
         }
 
         auto post_poll = std::chrono::steady_clock::now();
-        std::unordered_map<fdevent*, unsigned> event_map;
+        std::unordered_set<fdevent*> active;
         for (int i = 0; i < rc; ++i) {
             fdevent* fde = static_cast<fdevent*>(epoll_events[i].data.ptr);
 
@@ -152,29 +155,25 @@ void fdevent_context_epoll::Loop() {
                 events |= FDE_READ | FDE_ERROR;
             }
 
-            event_map[fde] = events;
-        }
-
-        for (auto& [fd, fde] : installed_fdevents_) {
-            unsigned events = 0;
-            if (auto it = event_map.find(&fde); it != event_map.end()) {
-                events = it->second;
+            if (events != 0) {
+                LOG(DEBUG) << dump_fde(fde) << " got events " << std::hex << std::showbase
+                           << events;
+                fde_events.push_back({fde, events});
+                fde->last_active = post_poll;
+                active.insert(fde);
             }
+        }
 
-            if (events == 0) {
-                if (fde.timeout) {
-                    auto deadline = fde.last_active + *fde.timeout;
-                    if (deadline < post_poll) {
-                        events |= FDE_TIMEOUT;
-                    }
-                }
+        for (fdevent* fde : timeout_fdevents_) {
+            if (active.count(fde)) {
+                continue;
             }
 
-            if (events != 0) {
-                LOG(DEBUG) << dump_fde(&fde) << " got events " << std::hex << std::showbase
-                           << events;
-                fde_events.push_back({&fde, events});
-                fde.last_active = post_poll;
+            auto deadline = fde->last_active + *fde->timeout;
+            if (deadline < post_poll) {
+                LOG(DEBUG) << dump_fde(fde) << " timed out";
+                fde_events.push_back({fde, FDE_TIMEOUT});
+                fde->last_active = post_poll;
             }
         }
         this->HandleEvents(fde_events);
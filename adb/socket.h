@@ -21,6 +21,7 @@
 
 #include <deque>
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "adb_unique_fd.h"
@@ -75,6 +76,13 @@ struct asocket {
      */
     int (*enqueue)(asocket* s, apacket::payload_type data) = nullptr;
 
+    /* enqueue_chain is optional, and behaves like enqueue, but
+     * takes the data as the chain of buffers it was received in.
+     * Sockets that can write out a chain set it to avoid having
+     * the data coalesced into a single block first.
+     */
+    int (*enqueue_chain)(asocket* s, IOVector data) = nullptr;
+
     /* ready is called by the peer when it is ready for
      * us to send data via enqueue again
      */
@@ -95,6 +103,16 @@ struct asocket {
     /* A socket is bound to atransport */
     atransport* transport = nullptr;
 
+    // The following are only used by remote sockets of streams on
+    // transports that support delayed acks. available_send_bytes is
+    // how many more bytes may be sent before the other side has to
+    // acknowledge some; it's unset for streams that send one WRITE
+    // at a time. unacknowledged_bytes is how many bytes have been
+    // received from the other side and delivered to our peer, but
+    // not acknowledged yet.
+    std::optional<int64_t> available_send_bytes;
+    uint64_t unacknowledged_bytes = 0;
+
     size_t get_max_payload() const;
 };
 
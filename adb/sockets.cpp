@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <chrono>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -218,7 +219,7 @@ static bool local_socket_flush_outgoing(asocket* s) {
     return true;
 }
 
-static int local_socket_enqueue(asocket* s, apacket::payload_type data) {
+static int local_socket_enqueue_chain(asocket* s, IOVector data) {
     D("LS(%d): enqueue %zu", s->id, data.size());
 
     s->packet_queue.append(std::move(data));
@@ -236,6 +237,10 @@ static int local_socket_enqueue(asocket* s, apacket::payload_type data) {
     return !s->packet_queue.empty();
 }
 
+static int local_socket_enqueue(asocket* s, apacket::payload_type data) {
+    return local_socket_enqueue_chain(s, IOVector(std::move(data)));
+}
+
 static void local_socket_ready(asocket* s) {
     /* far side is ready for data, pay attention to
        readable events */
@@ -390,6 +395,7 @@ asocket* create_local_socket(unique_fd ufd) {
     asocket* s = new asocket();
     s->fd = fd;
     s->enqueue = local_socket_enqueue;
+    s->enqueue_chain = local_socket_enqueue_chain;
     s->ready = local_socket_ready;
     s->shutdown = nullptr;
     s->close = local_socket_close;
@@ -442,17 +448,39 @@ static int remote_socket_enqueue(asocket* s, apacket::payload_type data) {
 
     p->payload = std::move(data);
     p->msg.data_length = p->payload.size();
+    size_t size = p->payload.size();
 
     send_packet(p, s->transport);
+
+    if (s->available_send_bytes) {
+        // Keep sending until the other side's receive window is used up.
+        *s->available_send_bytes -= size;
+        return *s->available_send_bytes > 0 ? 0 : 1;
+    }
     return 1;
 }
 
 static void remote_socket_ready(asocket* s) {
     D("entered remote_socket_ready RS(%d) OKAY fd=%d peer.fd=%d", s->id, s->fd, s->peer->fd);
+    std::optional<uint32_t> acked_bytes;
+    if (s->available_send_bytes) {
+        // Acknowledge everything that's been delivered since the last READY.
+        if (s->unacknowledged_bytes == 0) {
+            return;
+        }
+        acked_bytes = std::min<uint64_t>(s->unacknowledged_bytes, UINT32_MAX);
+        s->unacknowledged_bytes -= *acked_bytes;
+    }
+
     apacket* p = get_apacket();
     p->msg.command = A_OKAY;
     p->msg.arg0 = s->peer->id;
     p->msg.arg1 = s->id;
+    if (acked_bytes) {
+        p->payload.resize(sizeof(*acked_bytes));
+        memcpy(p->payload.data(), &*acked_bytes, sizeof(*acked_bytes));
+        p->msg.data_length = p->payload.size();
+    }
     send_packet(p, s->transport);
 }
 
@@ -507,6 +535,9 @@ void connect_to_remote(asocket* s, std::string_view destination) {
     LOG(VERBOSE) << "LS(" << s->id << ": connect(" << destination << ")";
     p->msg.command = A_OPEN;
     p->msg.arg0 = s->id;
+    if (s->transport->SupportsDelayedAck()) {
+        p->msg.arg1 = INITIAL_DELAYED_ACK_BYTES;
+    }
 
     // adbd used to expect a null-terminated string.
     // Keep doing so to maintain backward compatibility.
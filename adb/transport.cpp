@@ -83,6 +83,9 @@ const char* const kFeatureAbbExec = "abb_exec";
 const char* const kFeatureRemountShell = "remount_shell";
 const char* const kFeatureSendRecv2 = "sendrecv_v2";
 const char* const kFeatureSendRecv2Brotli = "sendrecv_v2_brotli";
+const char* const kFeatureSendRecv2LZ4 = "sendrecv_v2_lz4";
+const char* const kFeatureSendRecv2Zstd = "sendrecv_v2_zstd";
+const char* const kFeatureDelayedAck = "delayed_ack";
 
 namespace {
 
@@ -1184,6 +1187,9 @@ const FeatureSet& supported_features() {
             kFeatureRemountShell,
             kFeatureSendRecv2,
             kFeatureSendRecv2Brotli,
+            kFeatureSendRecv2LZ4,
+            kFeatureSendRecv2Zstd,
+            kFeatureDelayedAck,
             // Increment ADB_SERVER_VERSION when adding a feature that adbd needs
             // to know about. Otherwise, the client can be stuck running an old
             // version of the server even after upgrading their copy of adb.
@@ -1216,6 +1222,7 @@ bool atransport::has_feature(const std::string& feature) const {
 
 void atransport::SetFeatures(const std::string& features_string) {
     features_ = StringToFeatureSet(features_string);
+    delayed_ack_ = CanUseFeature(features_, kFeatureDelayedAck);
 }
 
 void atransport::AddDisconnect(adisconnect* disconnect) {
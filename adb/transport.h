@@ -87,6 +87,12 @@ extern const char* const kFeatureRemountShell;
 extern const char* const kFeatureSendRecv2;
 // adbd supports brotli for send/recv v2.
 extern const char* const kFeatureSendRecv2Brotli;
+// adbd supports LZ4 for send/recv v2.
+extern const char* const kFeatureSendRecv2LZ4;
+// adbd supports Zstd for send/recv v2.
+extern const char* const kFeatureSendRecv2Zstd;
+// adbd supports windowed flow control with cumulative acknowledgements on sockets.
+extern const char* const kFeatureDelayedAck;
 
 TransportId NextTransportId();
 
@@ -335,6 +341,9 @@ class atransport : public enable_weak_from_this<atransport> {
 
     bool has_feature(const std::string& feature) const;
 
+    // Whether both sides of this transport support kFeatureDelayedAck.
+    bool SupportsDelayedAck() const { return delayed_ack_; }
+
     // Loads the transport's feature set from the given string.
     void SetFeatures(const std::string& features_string);
 
@@ -373,6 +382,7 @@ class atransport : public enable_weak_from_this<atransport> {
     // A set of features transmitted in the banner with the initial connection.
     // This is stored in the banner as 'features=feature0,feature1,etc'.
     FeatureSet features_;
+    bool delayed_ack_ = false;
     int protocol_version;
     size_t max_payload;
 
@@ -17,6 +17,14 @@
 #include <malloc.h>
 #include <stdio.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <android-base/logging.h>
 #include <benchmark/benchmark.h>
 
@@ -65,7 +73,7 @@ void BM_Connection_Unidirectional(benchmark::State& state) {
 
     client->SetReadCallback([](Connection*, std::unique_ptr<apacket>) -> bool { return true; });
     server->SetReadCallback([&received_bytes](Connection*, std::unique_ptr<apacket> packet) -> bool {
-        received_bytes += packet->payload.size();
+        received_bytes += packet->payload_size();
         return true;
     });
 
@@ -122,7 +130,7 @@ void BM_Connection_Echo(benchmark::State& state) {
     std::thread fdevent_thread([]() { fdevent_loop(); });
 
     client->SetReadCallback([&received_bytes](Connection*, std::unique_ptr<apacket> packet) -> bool {
-        received_bytes += packet->payload.size();
+        received_bytes += packet->payload_size();
         return true;
     });
 
@@ -182,6 +190,220 @@ void BM_Connection_Echo(benchmark::State& state) {
 ADB_CONNECTION_BENCHMARK(BM_Connection_Echo, ThreadPolicy::SameThread);
 ADB_CONNECTION_BENCHMARK(BM_Connection_Echo, ThreadPolicy::MainThread);
 
+// Simulate delivering a payload that was read from FunctionFS in 16KiB pieces (the read size used by
+// daemon/usb.cpp) to a local socket, either coalesced into a single block first or as the chain of
+// blocks it was read into.
+template <bool Coalesce>
+void BM_Payload_Delivery(benchmark::State& state) {
+    static constexpr size_t kReadSize = 16384;
+    unique_fd fd(adb_open("/dev/null", O_WRONLY | O_CLOEXEC));
+    if (fd < 0) {
+        LOG(FATAL) << "failed to open /dev/null";
+    }
+
+    size_t data_size = state.range(0);
+    for (auto _ : state) {
+        IOVector chain;
+        for (size_t offset = 0; offset < data_size; offset += kReadSize) {
+            Block block(std::min(kReadSize, data_size - offset));
+            memset(block.data(), 0xff, block.size());
+            chain.append(std::move(block));
+        }
+
+        IOVector queue;
+        if (Coalesce) {
+            queue.append(std::move(chain).coalesce());
+        } else {
+            queue.append(std::move(chain));
+        }
+
+        std::vector<adb_iovec> iov = queue.iovecs();
+        if (adb_writev(fd.get(), iov.data(), iov.size()) != static_cast<ssize_t>(data_size)) {
+            LOG(FATAL) << "short write to /dev/null";
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_Payload_Delivery, true)->Arg(16384)->Arg(256 * 1024)->Arg(MAX_PAYLOAD);
+BENCHMARK_TEMPLATE(BM_Payload_Delivery, false)->Arg(16384)->Arg(256 * 1024)->Arg(MAX_PAYLOAD);
+
+// A link with a fixed one-way latency and no bandwidth limit: functions submitted to it run on its
+// own thread, in order, |delay| after they were submitted.
+class DelayLine {
+  public:
+    explicit DelayLine(std::chrono::microseconds delay) : delay_(delay) {
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    ~DelayLine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    void Submit(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.emplace_back(std::chrono::steady_clock::now() + delay_, std::move(fn));
+        cv_.notify_one();
+    }
+
+  private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() { return stopped_ || !queue_.empty(); });
+            if (stopped_) return;
+
+            auto deadline = queue_.front().first;
+            if (cv_.wait_until(lock, deadline, [this]() { return stopped_; })) return;
+
+            auto fn = std::move(queue_.front().second);
+            queue_.pop_front();
+            lock.unlock();
+            fn();
+            lock.lock();
+        }
+    }
+
+    const std::chrono::microseconds delay_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::function<void()>>> queue_;
+    bool stopped_ = false;
+};
+
+// Stream 16 full packets over a link with a round trip time of state.range(0) milliseconds, with the
+// sender limited to one unacknowledged packet (the original protocol) or to a receive window of
+// INITIAL_DELAYED_ACK_BYTES (delayed acks).
+template <bool DelayedAck>
+void BM_Stream_Latency(benchmark::State& state) {
+    static constexpr size_t kPacketCount = 16;
+    const size_t window = DelayedAck ? INITIAL_DELAYED_ACK_BYTES : MAX_PAYLOAD;
+    const auto one_way = std::chrono::microseconds(state.range(0) * 1000 / 2);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t available = 0;
+    size_t received = 0;
+
+    DelayLine to_receiver(one_way);
+    DelayLine to_sender(one_way);
+
+    for (auto _ : state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available = window;
+            received = 0;
+        }
+
+        for (size_t i = 0; i < kPacketCount; ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return available > 0; });
+                available -= std::min(available, MAX_PAYLOAD);
+            }
+
+            auto packet = std::make_shared<apacket>();
+            packet->msg.command = A_WRTE;
+            packet->msg.data_length = MAX_PAYLOAD;
+            packet->payload.resize(MAX_PAYLOAD);
+
+            to_receiver.Submit([&, packet]() {
+                size_t acked = packet->payload.size();
+                to_sender.Submit([&, acked]() {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    available += acked;
+                    received += acked;
+                    cv.notify_all();
+                });
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return received == kPacketCount * MAX_PAYLOAD; });
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * kPacketCount * MAX_PAYLOAD);
+}
+
+BENCHMARK_TEMPLATE(BM_Stream_Latency, false)->Arg(1)->Arg(10)->Arg(50)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Stream_Latency, true)->Arg(1)->Arg(10)->Arg(50)->UseRealTime();
+
+// Model a server with many connected transports: every transport has an idle timeout armed, and
+// all of them become readable at once while other threads post work to the main thread.
+static void BM_Fdevent_ManyTransports(benchmark::State& state) {
+    const size_t transport_count = state.range(0);
+    std::vector<unique_fd> writers;
+    std::vector<fdevent*> fdes;
+    std::atomic<size_t> handled = 0;
+
+    fdevent_reset();
+    std::thread fdevent_thread([]() { fdevent_loop(); });
+
+    fdevent_run_on_main_thread([&]() {
+        for (size_t i = 0; i < transport_count; ++i) {
+            int fds[2];
+            if (adb_socketpair(fds) != 0) {
+                LOG(FATAL) << "failed to create socketpair";
+            }
+            writers.emplace_back(fds[0]);
+            fdevent* fde = fdevent_create(
+                    fds[1],
+                    [](int fd, unsigned events, void* arg) {
+                        if (events & FDE_READ) {
+                            char buf;
+                            if (adb_read(fd, &buf, 1) == 1) {
+                                ++*static_cast<std::atomic<size_t>*>(arg);
+                            }
+                        }
+                    },
+                    &handled);
+            fdevent_add(fde, FDE_READ);
+            fdevent_set_timeout(fde, std::chrono::hours(1));
+            fdes.push_back(fde);
+        }
+        handled = transport_count;
+    });
+    while (handled != transport_count) {
+        continue;
+    }
+
+    for (auto _ : state) {
+        handled = 0;
+        std::thread poster([&]() {
+            for (size_t i = 0; i < transport_count; ++i) {
+                fdevent_run_on_main_thread([&handled]() { ++handled; });
+            }
+        });
+        for (const unique_fd& writer : writers) {
+            char buf = 0;
+            if (adb_write(writer.get(), &buf, 1) != 1) {
+                PLOG(FATAL) << "failed to write";
+            }
+        }
+        poster.join();
+        while (handled != 2 * transport_count) {
+            continue;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 2 * transport_count);
+
+    fdevent_run_on_main_thread([&]() {
+        for (fdevent* fde : fdes) {
+            fdevent_destroy(fde);
+        }
+        fdes.clear();
+    });
+    fdevent_terminate_loop();
+    fdevent_thread.join();
+}
+
+BENCHMARK(BM_Fdevent_ManyTransports)->Arg(16)->Arg(256)->Arg(1024)->UseRealTime();
+
 int main(int argc, char** argv) {
     // Set M_DECAY_TIME so that our allocations aren't immediately purged on free.
     mallopt(M_DECAY_TIME, 1);
@@ -115,11 +115,13 @@ struct NonblockingFdConnection : public Connection {
                     if (read_header_ && read_buffer_.size() >= read_header_->data_length) {
                         auto data_chain = read_buffer_.take_front(read_header_->data_length);
 
-                        // TODO: Make apacket carry around a IOVector instead of coalescing.
-                        auto payload = std::move(data_chain).coalesce();
                         auto packet = std::make_unique<apacket>();
                         packet->msg = *read_header_;
-                        packet->payload = std::move(payload);
+                        if (packet->msg.command == A_WRTE) {
+                            packet->payload_chain = std::move(data_chain);
+                        } else {
+                            packet->payload = std::move(data_chain).coalesce();
+                        }
                         read_header_ = nullptr;
                         read_callback_(this, std::move(packet));
                     }
@@ -208,6 +210,7 @@ struct NonblockingFdConnection : public Connection {
         if (!packet->payload.empty()) {
             write_buffer_.append(std::move(packet->payload));
         }
+        write_buffer_.append(std::move(packet->payload_chain));
 
         WriteResult result = DispatchWrites();
         if (result == WriteResult::TryAgain) {
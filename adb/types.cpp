@@ -111,6 +111,22 @@ IOVector IOVector::take_front(IOVector::size_type len) {
     return res;
 }
 
+void IOVector::append(IOVector&& other) {
+    if (other.empty()) {
+        return;
+    }
+    if (empty()) {
+        *this = std::move(other);
+        return;
+    }
+
+    other.trim_front();
+    for (auto& block : other.chain_) {
+        append(std::move(block));
+    }
+    other.clear();
+}
+
 void IOVector::trim_front() {
     if ((begin_offset_ == 0 && start_index_ == 0) || chain_.empty()) {
         return;
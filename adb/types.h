@@ -120,21 +120,6 @@ struct Block {
     size_t size_ = 0;
 };
 
-struct amessage {
-    uint32_t command;     /* command identifier constant      */
-    uint32_t arg0;        /* first argument                   */
-    uint32_t arg1;        /* second argument                  */
-    uint32_t data_length; /* length of payload (0 is allowed) */
-    uint32_t data_check;  /* checksum of data payload         */
-    uint32_t magic;       /* command ^ 0xffffffff             */
-};
-
-struct apacket {
-    using payload_type = Block;
-    amessage msg;
-    payload_type payload;
-};
-
 struct IOVector {
     using value_type = char;
     using block_type = Block;
@@ -188,6 +173,9 @@ struct IOVector {
         chain_.emplace_back(std::move(block));
     }
 
+    // Move all of the blocks of another chain onto the end of this one.
+    void append(IOVector&& other);
+
     void trim_front();
 
   private:
@@ -263,6 +251,28 @@ struct IOVector {
     std::vector<block_type> chain_;
 };
 
+struct amessage {
+    uint32_t command;     /* command identifier constant      */
+    uint32_t arg0;        /* first argument                   */
+    uint32_t arg1;        /* second argument                  */
+    uint32_t data_length; /* length of payload (0 is allowed) */
+    uint32_t data_check;  /* checksum of data payload         */
+    uint32_t magic;       /* command ^ 0xffffffff             */
+};
+
+struct apacket {
+    using payload_type = Block;
+    amessage msg;
+    payload_type payload;
+
+    // Transports that read A_WRTE payloads in several pieces can leave them here, as the chain of
+    // buffers they were read into, instead of coalescing them into |payload|. At most one of
+    // |payload| and |payload_chain| is non-empty.
+    IOVector payload_chain;
+
+    size_t payload_size() const { return payload.size() + payload_chain.size(); }
+};
+
 // An implementation of weak pointers tied to the fdevent run loop.
 //
 // This allows for code to submit a request for an object, and upon receiving
@@ -117,3 +117,28 @@ TEST(IOVector, misaligned_split) {
     ASSERT_EQ(1ULL, bc.size());
     ASSERT_EQ(create_block("x"), bc.coalesce());
 }
+
+TEST(IOVector, append_chain) {
+    IOVector bc;
+    bc.append(create_block("foo"));
+
+    // Appending to an empty chain keeps the partially consumed front block.
+    IOVector empty;
+    IOVector barbaz;
+    barbaz.append(create_block("xbar"));
+    barbaz.append(create_block("baz"));
+    barbaz.drop_front(1);
+    empty.append(std::move(barbaz));
+    ASSERT_EQ(0ULL, barbaz.size());
+    ASSERT_EQ(6ULL, empty.size());
+
+    bc.append(std::move(empty));
+    ASSERT_EQ(0ULL, empty.size());
+    ASSERT_EQ(9ULL, bc.size());
+    ASSERT_EQ(3ULL, bc.iovecs().size());
+    ASSERT_EQ(create_block("foobarbaz"), bc.coalesce());
+
+    // Appending an empty chain does nothing.
+    bc.append(IOVector());
+    ASSERT_EQ(9ULL, bc.size());
+}
@@ -20,8 +20,12 @@
 
 #include <benchmark/benchmark.h>
 
+#include "android-base/logging.h"
 #include "android-base/stringprintf.h"
 
+using android::base::LogId;
+using android::base::LogSeverity;
+using android::base::ScopedLogSeverity;
 using android::base::StringPrintf;
 
 static void BenchmarkFormatInt(benchmark::State& state) {
@@ -76,5 +80,53 @@ static void BenchmarkStringPrintfStrings(benchmark::State& state) {
 
 BENCHMARK(BenchmarkStringPrintfStrings);
 
+// The LOG benchmarks discard the formatted message, so they only measure libbase's own overhead.
+static void NullLogger(LogId, LogSeverity, const char*, const char*, unsigned int, const char*) {}
+
+static void BenchmarkLogInt(benchmark::State& state) {
+  android::base::SetLogger(NullLogger);
+  ScopedLogSeverity sls(android::base::INFO);
+  for (auto _ : state) {
+    LOG(INFO) << 42 << " " << std::numeric_limits<int>::min() << " "
+              << std::numeric_limits<int>::max();
+  }
+}
+
+BENCHMARK(BenchmarkLogInt);
+
+static void BenchmarkLogStrings(benchmark::State& state) {
+  android::base::SetLogger(NullLogger);
+  ScopedLogSeverity sls(android::base::INFO);
+  for (auto _ : state) {
+    LOG(INFO) << "hi,"
+              << " hello there "
+              << "!!";
+  }
+}
+
+BENCHMARK(BenchmarkLogStrings);
+
+static void BenchmarkLogLongMessage(benchmark::State& state) {
+  android::base::SetLogger(NullLogger);
+  ScopedLogSeverity sls(android::base::INFO);
+  std::string message(state.range(0), 'x');
+  for (auto _ : state) {
+    LOG(INFO) << message;
+  }
+}
+
+BENCHMARK(BenchmarkLogLongMessage)->Arg(100)->Arg(4000);
+
+static void BenchmarkLogStreamDisabled(benchmark::State& state) {
+  android::base::SetLogger(NullLogger);
+  ScopedLogSeverity sls(android::base::INFO);
+  for (auto _ : state) {
+    LOG_STREAM(VERBOSE) << 42 << " " << std::numeric_limits<int>::min() << " "
+                        << std::numeric_limits<int>::max();
+  }
+}
+
+BENCHMARK(BenchmarkLogStreamDisabled);
+
 // Run the benchmark
 BENCHMARK_MAIN();
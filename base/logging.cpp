@@ -422,6 +422,43 @@ void SetAborter(AbortFunction&& aborter) {
   }
 }
 
+// A streambuf that formats the message into a fixed buffer, only moving to the heap for the
+// rare messages that do not fit.
+class LogMessageBuffer : public std::streambuf {
+ public:
+  // Long enough for all but the most verbose log lines.
+  static constexpr size_t kSize = 1024;
+
+  LogMessageBuffer() { setp(buffer_, buffer_ + kSize); }
+
+  // Returns the null terminated message, valid until the next write.
+  const char* c_str() {
+    if (overflow_.empty()) {
+      *pptr() = '\0';
+      return buffer_;
+    }
+    overflow_.append(pbase(), pptr());
+    setp(buffer_, buffer_ + kSize);
+    return overflow_.c_str();
+  }
+
+ protected:
+  int_type overflow(int_type ch) override {
+    overflow_.append(pbase(), pptr());
+    setp(buffer_, buffer_ + kSize);
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+      return traits_type::not_eof(ch);
+    }
+    overflow_.push_back(traits_type::to_char_type(ch));
+    return ch;
+  }
+
+ private:
+  // One extra byte for the null terminator.
+  char buffer_[kSize + 1];
+  std::string overflow_;
+};
+
 // This indirection greatly reduces the stack impact of having lots of
 // checks/logging in a function.
 class LogMessageData {
@@ -432,7 +469,15 @@ class LogMessageData {
         line_number_(line),
         severity_(severity),
         tag_(tag),
-        error_(error) {}
+        error_(error),
+        should_log_(WOULD_LOG(severity)),
+        stream_(&buffer_) {
+    // LOG() has already checked this, but LOG_STREAM() has not.  Putting the stream in a failed
+    // state makes the standard inserters return without formatting anything.
+    if (!should_log_) {
+      stream_.setstate(std::ios_base::badbit);
+    }
+  }
 
   const char* GetFile() const {
     return file_;
@@ -452,25 +497,80 @@ class LogMessageData {
     return error_;
   }
 
+  bool ShouldLog() const { return should_log_; }
+
   std::ostream& GetBuffer() {
-    return buffer_;
+    return stream_;
   }
 
-  std::string ToString() const {
-    return buffer_.str();
-  }
+  const char* c_str() { return buffer_.c_str(); }
+
+  // Messages are always created and destroyed on the same thread within a single full expression,
+  // so each thread reuses one allocation for its outermost message.  Nested messages, e.g. from an
+  // operator<< or a logger that itself logs, fall back to the heap.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
 
  private:
-  std::ostringstream buffer_;
+  LogMessageBuffer buffer_;
   const char* const file_;
   const unsigned int line_number_;
   const LogSeverity severity_;
   const char* const tag_;
   const int error_;
+  const bool should_log_;
+  std::ostream stream_;
 
   DISALLOW_COPY_AND_ASSIGN(LogMessageData);
 };
 
+// The storage is allocated on first use rather than kept in thread local storage itself, so that
+// threads that never log do not pay for it.
+class ThreadLogMessageStorage {
+ public:
+  ~ThreadLogMessageStorage() {
+    ::operator delete(storage_);
+    storage_ = nullptr;
+    destroyed_ = true;
+  }
+
+  void* Acquire() {
+    if (in_use_ || destroyed_) return nullptr;
+    if (storage_ == nullptr) {
+      storage_ = ::operator new(sizeof(LogMessageData));
+    }
+    in_use_ = true;
+    return storage_;
+  }
+
+  bool Release(void* ptr) {
+    if (ptr != storage_ || storage_ == nullptr) return false;
+    in_use_ = false;
+    return true;
+  }
+
+ private:
+  void* storage_ = nullptr;
+  bool in_use_ = false;
+  // Logging from other thread local destructors after this one has run uses the heap.
+  bool destroyed_ = false;
+};
+
+static thread_local ThreadLogMessageStorage gThreadLogMessageStorage;
+
+void* LogMessageData::operator new(size_t size) {
+  if (void* ptr = gThreadLogMessageStorage.Acquire()) {
+    return ptr;
+  }
+  return ::operator new(size);
+}
+
+void LogMessageData::operator delete(void* ptr) {
+  if (!gThreadLogMessageStorage.Release(ptr)) {
+    ::operator delete(ptr);
+  }
+}
+
 LogMessage::LogMessage(const char* file, unsigned int line, LogId, LogSeverity severity,
                        const char* tag, int error)
     : LogMessage(file, line, severity, tag, error) {}
@@ -480,8 +580,8 @@ LogMessage::LogMessage(const char* file, unsigned int line, LogSeverity severity
     : data_(new LogMessageData(file, line, severity, tag, error)) {}
 
 LogMessage::~LogMessage() {
-  // Check severity again. This is duplicate work wrt/ LOG macros, but not LOG_STREAM.
-  if (!WOULD_LOG(data_->GetSeverity())) {
+  // The severity was checked when the message was created, which LOG_STREAM does not do itself.
+  if (!data_->ShouldLog()) {
     return;
   }
 
@@ -489,26 +589,25 @@ LogMessage::~LogMessage() {
   if (data_->GetError() != -1) {
     data_->GetBuffer() << ": " << strerror(data_->GetError());
   }
-  std::string msg(data_->ToString());
+  const char* msg = data_->c_str();
 
   if (data_->GetSeverity() == FATAL) {
 #ifdef __ANDROID__
     // Set the bionic abort message early to avoid liblog doing it
     // with the individual lines, so that we get the whole message.
-    android_set_abort_message(msg.c_str());
+    android_set_abort_message(msg);
 #endif
   }
 
-  LogLine(data_->GetFile(), data_->GetLineNumber(), data_->GetSeverity(), data_->GetTag(),
-          msg.c_str());
+  LogLine(data_->GetFile(), data_->GetLineNumber(), data_->GetSeverity(), data_->GetTag(), msg);
 
   // Abort if necessary.
   if (data_->GetSeverity() == FATAL) {
     static auto& liblog_functions = GetLibLogFunctions();
     if (liblog_functions) {
-      liblog_functions->__android_log_call_aborter(msg.c_str());
+      liblog_functions->__android_log_call_aborter(msg);
     } else {
-      Aborter()(msg.c_str());
+      Aborter()(msg);
     }
   }
 }
@@ -438,6 +438,41 @@ TEST(logging, PLOG_does_not_clobber_errno) {
   ASSERT_NO_FATAL_FAILURE(CheckMessage(cap, android::base::INFO, "67890"));
 }
 
+TEST(logging, LOG_long_message) {
+  // Longer than the fixed buffer that messages are usually formatted into.
+  std::string long_message = "start" + std::string(5000, 'x') + "end";
+
+  CapturedStderr cap;
+  LOG(INFO) << long_message;
+  cap.Stop();
+
+  ASSERT_NE(std::string::npos, cap.str().find(long_message)) << cap.str();
+}
+
+struct LogsWhenPrinted {};
+
+static std::ostream& operator<<(std::ostream& os, const LogsWhenPrinted&) {
+  LOG(INFO) << "inner message";
+  return os << "outer";
+}
+
+TEST(logging, LOG_nested) {
+  CapturedStderr cap;
+  LOG(INFO) << "the " << LogsWhenPrinted() << " message";
+  LOG(INFO) << "followed by another";
+  cap.Stop();
+
+  std::string output = cap.str();
+  auto inner = output.find("inner message");
+  auto outer = output.find("the outer message");
+  auto next = output.find("followed by another");
+  ASSERT_NE(std::string::npos, inner) << output;
+  ASSERT_NE(std::string::npos, outer) << output;
+  ASSERT_NE(std::string::npos, next) << output;
+  EXPECT_LT(inner, outer);
+  EXPECT_LT(outer, next);
+}
+
 TEST(logging, LOG_does_not_have_dangling_if) {
   CapturedStderr cap; // So the logging below has no side-effects.
 
@@ -58,6 +58,7 @@
 
 #include "libdebuggerd/backtrace.h"
 #include "libdebuggerd/tombstone.h"
+#include "libdebuggerd/tombstone_binary.h"
 #include "libdebuggerd/utility.h"
 
 #include "debuggerd/handler.h"
@@ -548,11 +549,27 @@ int main(int argc, char** argv) {
   // Drop our capabilities now that we've fetched all of the information we need.
   drop_capabilities();
 
+  // Only crashes get binary tombstones. Explicit dump requests keep the text format that their
+  // callers read back.
+  bool binary_tombstone = dump_type == kDebuggerdTombstone &&
+                          siginfo.si_signo != BIONIC_SIGNAL_DEBUGGER &&
+                          android::base::GetBoolProperty("debug.debuggerd.binary_tombstones", false);
+  if (binary_tombstone) {
+    dump_type = kDebuggerdTombstoneBinary;
+  }
+
   {
     ATRACE_NAME("tombstoned_connect");
     LOG(INFO) << "obtaining output fd from tombstoned, type: " << dump_type;
-    g_tombstoned_connected =
-        tombstoned_connect(g_target_thread, &g_tombstoned_socket, &g_output_fd, dump_type);
+    DebuggerdDumpType output_dump_type;
+    g_tombstoned_connected = tombstoned_connect(g_target_thread, &g_tombstoned_socket,
+                                                &g_output_fd, dump_type, &output_dump_type);
+
+    // An intercept registered for a text tombstone, as by debuggerd_test, gets one.
+    if (g_tombstoned_connected && binary_tombstone && output_dump_type == kDebuggerdTombstone) {
+      LOG(INFO) << "writing a text tombstone for the intercept";
+      binary_tombstone = false;
+    }
   }
 
   if (g_tombstoned_connected) {
@@ -597,12 +614,29 @@ int main(int argc, char** argv) {
     ATRACE_NAME("dump_backtrace");
     dump_backtrace(std::move(g_output_fd), &unwinder, thread_info, g_target_thread);
   } else {
-    {
-      ATRACE_NAME("fdsan table dump");
-      populate_fdsan_table(&open_files, unwinder.GetProcessMemory(), fdsan_table_address);
-    }
+    if (binary_tombstone) {
+      // Write raw frames, maps and memory only, and leave symbolization to offline tools.
+      std::vector<unwindstack::FrameData> target_frames;
+      {
+        ATRACE_NAME("engrave_binary_tombstone");
+        engrave_binary_tombstone(std::move(g_output_fd), &unwinder, thread_info, g_target_thread,
+                                 abort_msg_address, &target_frames);
+      }
+
+      // Everything else is read from the vm process, so the crashing process doesn't have to wait
+      // for the summary below before it can exit.
+      output_pipe.reset();
+
+      // The crashing thread still gets a symbolized backtrace in logcat and for ActivityManager.
+      ATRACE_NAME("engrave_tombstone_summary");
+      engrave_tombstone_summary(&unwinder, thread_info, g_target_thread, std::move(target_frames),
+                                abort_msg_address, &amfd_data, gwp_asan_state, gwp_asan_metadata);
+    } else {
+      {
+        ATRACE_NAME("fdsan table dump");
+        populate_fdsan_table(&open_files, unwinder.GetProcessMemory(), fdsan_table_address);
+      }
 
-    {
       ATRACE_NAME("engrave_tombstone");
       engrave_tombstone(std::move(g_output_fd), &unwinder, thread_info, g_target_thread,
                         abort_msg_address, &open_files, &amfd_data, gwp_asan_state,
@@ -26,6 +26,7 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <mutex>
 #include <regex>
 #include <thread>
 
@@ -50,6 +51,7 @@
 #include <scoped_minijail.h>
 
 #include "debuggerd/handler.h"
+#include "libdebuggerd/tombstone_binary.h"
 #include "protocol.h"
 #include "tombstoned/tombstoned.h"
 #include "util.h"
@@ -66,6 +68,7 @@ using android::base::unique_fd;
 #endif
 
 constexpr char kWaitForGdbKey[] = "debug.debuggerd.wait_for_gdb";
+constexpr char kBinaryTombstonesKey[] = "debug.debuggerd.binary_tombstones";
 
 #define TIMEOUT(seconds, expr)                                     \
   [&]() {                                                          \
@@ -305,6 +308,56 @@ TEST_F(CrasherTest, smoke) {
   ASSERT_MATCH(result, R"(signal 11 \(SIGSEGV\), code 1 \(SEGV_MAPERR\), fault addr 0xdead)");
 }
 
+TEST_F(CrasherTest, binary_tombstone) {
+  bool previous_binary_tombstones = android::base::GetBoolProperty(kBinaryTombstonesKey, false);
+  ASSERT_TRUE(android::base::SetProperty(kBinaryTombstonesKey, "1"));
+
+  int intercept_result;
+  unique_fd output_fd;
+  StartProcess([]() {
+    *reinterpret_cast<volatile char*>(0xdead) = '1';
+  });
+
+  StartIntercept(&output_fd, kDebuggerdTombstoneBinary);
+  FinishCrasher();
+  AssertDeath(SIGSEGV);
+  FinishIntercept(&intercept_result);
+  android::base::SetProperty(kBinaryTombstonesKey, previous_binary_tombstones ? "1" : "0");
+
+  ASSERT_EQ(1, intercept_result) << "tombstoned reported failure";
+
+  std::string result;
+  ConsumeFd(std::move(output_fd), &result);
+  BinaryTombstone tombstone;
+  ASSERT_TRUE(parse_binary_tombstone(result, &tombstone));
+  ASSERT_EQ(SIGSEGV, tombstone.signo);
+  ASSERT_EQ(0xdeadU, tombstone.fault_addr);
+}
+
+TEST_F(CrasherTest, binary_tombstone_text_intercept) {
+  bool previous_binary_tombstones = android::base::GetBoolProperty(kBinaryTombstonesKey, false);
+  ASSERT_TRUE(android::base::SetProperty(kBinaryTombstonesKey, "1"));
+
+  int intercept_result;
+  unique_fd output_fd;
+  StartProcess([]() {
+    *reinterpret_cast<volatile char*>(0xdead) = '1';
+  });
+
+  // An intercept for a text tombstone still gets one.
+  StartIntercept(&output_fd);
+  FinishCrasher();
+  AssertDeath(SIGSEGV);
+  FinishIntercept(&intercept_result);
+  android::base::SetProperty(kBinaryTombstonesKey, previous_binary_tombstones ? "1" : "0");
+
+  ASSERT_EQ(1, intercept_result) << "tombstoned reported failure";
+
+  std::string result;
+  ConsumeFd(std::move(output_fd), &result);
+  ASSERT_MATCH(result, R"(signal 11 \(SIGSEGV\), code 1 \(SEGV_MAPERR\), fault addr 0xdead)");
+}
+
 TEST_F(CrasherTest, LD_PRELOAD) {
   int intercept_result;
   unique_fd output_fd;
@@ -1004,6 +1057,62 @@ TEST(tombstoned, stress) {
   }
 }
 
+TEST(tombstoned, high_priority_overtakes_queue) {
+  // Tombstones are dumped one at a time, so hold the only slot with a dump that isn't finished.
+  const pid_t running_pid = 1'234'570;
+  unique_fd running_intercept_fd, running_output_fd;
+  InterceptStatus status;
+  tombstoned_intercept(running_pid, &running_intercept_fd, &running_output_fd, &status,
+                       kDebuggerdTombstone);
+  ASSERT_EQ(InterceptStatus::kRegistered, status);
+  unique_fd running_socket, running_input_fd;
+  ASSERT_TRUE(
+      tombstoned_connect(running_pid, &running_socket, &running_input_fd, kDebuggerdTombstone));
+
+  // Pids that don't exist get normal priority, while this test runs as a system uid, which gets
+  // high priority.
+  const std::vector<pid_t> pids = {1'234'571, 1'234'572, getpid()};
+  std::vector<unique_fd> intercept_fds(pids.size());
+  std::vector<unique_fd> output_fds(pids.size());
+  for (size_t i = 0; i < pids.size(); ++i) {
+    tombstoned_intercept(pids[i], &intercept_fds[i], &output_fds[i], &status, kDebuggerdTombstone);
+    ASSERT_EQ(InterceptStatus::kRegistered, status);
+  }
+
+  std::mutex dispatch_order_mutex;
+  std::vector<pid_t> dispatch_order;
+  std::vector<std::thread> threads;
+  for (pid_t pid : pids) {
+    threads.emplace_back([pid, &dispatch_order_mutex, &dispatch_order]() {
+      unique_fd tombstoned_socket, input_fd;
+      ASSERT_TRUE(tombstoned_connect(pid, &tombstoned_socket, &input_fd, kDebuggerdTombstone));
+      {
+        std::lock_guard<std::mutex> lock(dispatch_order_mutex);
+        dispatch_order.push_back(pid);
+      }
+      ASSERT_TRUE(android::base::WriteFully(input_fd.get(), &pid, sizeof(pid)));
+      tombstoned_notify_completion(tombstoned_socket.get());
+    });
+
+    // Let each request get queued before the next one arrives.
+    std::this_thread::sleep_for(100ms);
+  }
+
+  running_input_fd.reset();
+  tombstoned_notify_completion(running_socket.get());
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<pid_t> expected_order = {getpid(), 1'234'571, 1'234'572};
+  ASSERT_EQ(expected_order, dispatch_order);
+  for (size_t i = 0; i < pids.size(); ++i) {
+    pid_t read_pid;
+    ASSERT_TRUE(android::base::ReadFully(output_fds[i].get(), &read_pid, sizeof(read_pid)));
+    ASSERT_EQ(pids[i], read_pid);
+  }
+}
+
 TEST(tombstoned, java_trace_intercept_smoke) {
   // Using a "real" PID is a little dangerous here - if the test fails
   // or crashes, we might end up getting a bogus / unreliable stack
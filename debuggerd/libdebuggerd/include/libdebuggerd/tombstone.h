@@ -23,6 +23,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 
@@ -32,6 +33,7 @@
 // Forward declarations
 namespace unwindstack {
 class Unwinder;
+struct FrameData;
 }
 
 // The maximum number of frames to save when unwinding.
@@ -58,4 +60,15 @@ void engrave_tombstone(android::base::unique_fd output_fd, unwindstack::Unwinder
                        std::string* amfd_data, uintptr_t gwp_asan_state,
                        uintptr_t gwp_asan_metadata);
 
+/* Writes the header and the crashing thread's registers and backtrace to logcat and to
+ * |amfd_data|, without writing a tombstone. Used along with a binary tombstone, which has no
+ * text for either. The backtrace is made from the unsymbolized |frames| that were saved for the
+ * binary tombstone, so the thread isn't unwound again; only their names are looked up here.
+ */
+void engrave_tombstone_summary(unwindstack::Unwinder* unwinder,
+                               const std::map<pid_t, ThreadInfo>& threads, pid_t target_thread,
+                               std::vector<unwindstack::FrameData> frames,
+                               uint64_t abort_msg_address, std::string* amfd_data,
+                               uintptr_t gwp_asan_state, uintptr_t gwp_asan_metadata);
+
 #endif  // _DEBUGGERD_TOMBSTONE_H
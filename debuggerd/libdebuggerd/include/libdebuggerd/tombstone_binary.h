@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+
+#include "types.h"
+
+// Forward declarations
+namespace unwindstack {
+class Unwinder;
+struct FrameData;
+}
+
+// A binary tombstone is a compact, machine-parsable alternative to the text tombstone.
+//
+// It only contains raw data that can be collected cheaply while the target is stopped: registers,
+// unsymbolized frames, the memory map (with build ids) and memory near the crashing thread's
+// registers. Symbolization and rendering to text are left to whoever reads it later. Unlike the
+// text tombstone, it has no open files, no fdsan owners and no logcat.
+//
+// The file is a header followed by a sequence of records. Every record starts with a
+// BinaryTombstoneRecordHeader, and its payload is made of host-endian integers and strings that
+// are encoded as a uint32_t length followed by the bytes.
+constexpr uint32_t kBinaryTombstoneMagic = 0x424d4f54;  // "TOMB"
+constexpr uint32_t kBinaryTombstoneVersion = 1;
+
+enum class BinaryTombstoneRecordType : uint32_t {
+  // pid, tid of the crashing thread, uid, signal, si_code, fault address, timestamp,
+  // process name, build fingerprint.
+  kProcess = 1,
+  // Abort message string.
+  kAbortMessage,
+  // tid, thread name, followed by the thread's (name, value) register pairs.
+  kThread,
+  // Thread tid, followed by its frames (pc, rel_pc, sp, map index).
+  kBacktrace,
+  // start, end, offset, flags, load bias, name and raw build id of every map.
+  kMaps,
+  // Address and contents of a block of memory, labeled with the register it was found near.
+  kMemory,
+};
+
+struct __attribute__((__packed__)) BinaryTombstoneHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t arch;  // unwindstack::ArchEnum
+};
+
+struct __attribute__((__packed__)) BinaryTombstoneRecordHeader {
+  BinaryTombstoneRecordType type;
+  uint32_t size;
+};
+
+// Value of BinaryTombstoneFrame::map_index for frames that aren't in any map.
+constexpr uint32_t kBinaryTombstoneNoMap = UINT32_MAX;
+
+struct BinaryTombstoneFrame {
+  uint64_t pc;
+  uint64_t rel_pc;
+  uint64_t sp;
+  uint32_t map_index;
+};
+
+struct BinaryTombstoneMap {
+  uint64_t start;
+  uint64_t end;
+  uint64_t offset;
+  uint64_t load_bias;
+  uint32_t flags;
+  std::string name;
+  std::string build_id;
+};
+
+struct BinaryTombstoneThread {
+  pid_t tid;
+  std::string name;
+  std::vector<std::pair<std::string, uint64_t>> registers;
+  std::vector<BinaryTombstoneFrame> frames;
+};
+
+struct BinaryTombstoneMemory {
+  std::string label;
+  uint64_t address;
+  std::string data;
+};
+
+// The decoded form of a binary tombstone, for offline tools.
+struct BinaryTombstone {
+  uint32_t arch = 0;
+
+  pid_t pid = 0;
+  pid_t tid = 0;
+  uid_t uid = 0;
+  int32_t signo = 0;
+  int32_t code = 0;
+  uint64_t fault_addr = 0;
+  int64_t timestamp = 0;
+  std::string process_name;
+  std::string build_fingerprint;
+  std::string abort_message;
+
+  // The crashing thread comes first.
+  std::vector<BinaryTombstoneThread> threads;
+  std::vector<BinaryTombstoneMap> maps;
+  std::vector<BinaryTombstoneMemory> memory;
+};
+
+// The crashing thread's unsymbolized frames are moved to |target_frames| if it isn't null, so that
+// a summary can be produced from them without unwinding again.
+void engrave_binary_tombstone(android::base::unique_fd output_fd, unwindstack::Unwinder* unwinder,
+                              const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread,
+                              uint64_t abort_msg_address,
+                              std::vector<unwindstack::FrameData>* target_frames);
+
+// Returns false if the contents aren't a well-formed binary tombstone of a version we understand.
+// Records of unknown types are skipped.
+bool parse_binary_tombstone(const std::string& contents, BinaryTombstone* tombstone);
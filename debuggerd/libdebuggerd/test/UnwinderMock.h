@@ -30,6 +30,10 @@ class UnwinderMock : public unwindstack::Unwinder {
     GetMaps()->Add(start, end, offset, flags, name, load_bias);
   }
 
+  void MockSetProcessMemory(std::shared_ptr<unwindstack::Memory> process_memory) {
+    process_memory_ = process_memory;
+  }
+
   void MockSetBuildID(uint64_t offset, const std::string& build_id) {
     unwindstack::MapInfo* map_info = GetMaps()->Find(offset);
     if (map_info != nullptr) {
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/RegsGetLocal.h>
+#include <unwindstack/Unwinder.h>
+
+#include "libdebuggerd/tombstone_binary.h"
+
+#include "UnwinderMock.h"
+
+class TombstoneBinaryTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    unwinder_mock_.reset(new UnwinderMock());
+    unwinder_mock_->MockSetProcessMemory(unwindstack::Memory::CreateProcessMemory(getpid()));
+
+    std::unique_ptr<unwindstack::Regs> regs(unwindstack::Regs::CreateFromLocal());
+    unwindstack::RegsGetLocal(regs.get());
+
+    memset(&siginfo_, 0, sizeof(siginfo_));
+    siginfo_.si_signo = SIGSEGV;
+    siginfo_.si_code = SEGV_MAPERR;
+    siginfo_.si_addr = reinterpret_cast<void*>(0xdead);
+
+    threads_[gettid()] = ThreadInfo{
+        .registers = std::move(regs),
+        .uid = 1000,
+        .tid = gettid(),
+        .thread_name = "binary_thread",
+        .pid = getpid(),
+        .process_name = "binary_process",
+        .siginfo = &siginfo_,
+    };
+  }
+
+  std::string Engrave(uint64_t abort_msg_address,
+                      std::vector<unwindstack::FrameData>* target_frames = nullptr) {
+    TemporaryFile tf;
+    engrave_binary_tombstone(android::base::unique_fd(dup(tf.fd)), unwinder_mock_.get(), threads_,
+                             gettid(), abort_msg_address, target_frames);
+    std::string contents;
+    EXPECT_TRUE(android::base::ReadFileToString(tf.path, &contents));
+    return contents;
+  }
+
+  std::unique_ptr<UnwinderMock> unwinder_mock_;
+  std::map<pid_t, ThreadInfo> threads_;
+  siginfo_t siginfo_;
+};
+
+TEST_F(TombstoneBinaryTest, round_trip) {
+  unwinder_mock_->MockAddMap(0xa234000, 0xa235000, 0, PROT_READ, "/system/lib/libfake.so", 0);
+  unwinder_mock_->MockAddMap(0xa334000, 0xa335000, 0x1000, PROT_READ | PROT_EXEC,
+                             "/system/lib/libfake.so", 0x2000);
+  unwinder_mock_->MockSetBuildID(0xa334000, "\xab\xcd\xef\x12");
+
+  std::string abort_message_data(sizeof(size_t), '\0');
+  abort_message_data += "binary abort";
+  abort_message_data += '\0';
+  size_t length = abort_message_data.size();
+  memcpy(&abort_message_data[0], &length, sizeof(length));
+
+  BinaryTombstone tombstone;
+  std::vector<unwindstack::FrameData> target_frames;
+  ASSERT_TRUE(parse_binary_tombstone(
+      Engrave(reinterpret_cast<uint64_t>(abort_message_data.data()), &target_frames),
+      &tombstone));
+
+  EXPECT_EQ(unwindstack::Regs::CurrentArch(), tombstone.arch);
+  EXPECT_EQ(getpid(), tombstone.pid);
+  EXPECT_EQ(gettid(), tombstone.tid);
+  EXPECT_EQ(1000U, tombstone.uid);
+  EXPECT_EQ(SIGSEGV, tombstone.signo);
+  EXPECT_EQ(SEGV_MAPERR, tombstone.code);
+  EXPECT_EQ(0xdeadU, tombstone.fault_addr);
+  EXPECT_EQ("binary_process", tombstone.process_name);
+  EXPECT_EQ("binary abort", tombstone.abort_message);
+
+  ASSERT_EQ(2U, tombstone.maps.size());
+  EXPECT_EQ(0xa234000U, tombstone.maps[0].start);
+  EXPECT_EQ(0xa235000U, tombstone.maps[0].end);
+  EXPECT_EQ(static_cast<uint32_t>(PROT_READ), tombstone.maps[0].flags);
+  EXPECT_EQ("/system/lib/libfake.so", tombstone.maps[0].name);
+  EXPECT_EQ("", tombstone.maps[0].build_id);
+  EXPECT_EQ(0x1000U, tombstone.maps[1].offset);
+  EXPECT_EQ(0x2000U, tombstone.maps[1].load_bias);
+  EXPECT_EQ("\xab\xcd\xef\x12", tombstone.maps[1].build_id);
+
+  ASSERT_EQ(1U, tombstone.threads.size());
+  const BinaryTombstoneThread& thread = tombstone.threads[0];
+  EXPECT_EQ(gettid(), thread.tid);
+  EXPECT_EQ("binary_thread", thread.name);
+  EXPECT_FALSE(thread.registers.empty());
+
+  // None of the mock maps contain our pc.
+  ASSERT_FALSE(thread.frames.empty());
+  EXPECT_EQ(kBinaryTombstoneNoMap, thread.frames[0].map_index);
+
+  // The crashing thread's frames are handed back for the summary, without names.
+  ASSERT_EQ(thread.frames.size(), target_frames.size());
+  EXPECT_EQ(thread.frames[0].pc, target_frames[0].pc);
+  EXPECT_EQ("", target_frames[0].function_name);
+
+  // The stack pointer register points at readable memory.
+  EXPECT_FALSE(tombstone.memory.empty());
+}
+
+TEST_F(TombstoneBinaryTest, no_abort_message) {
+  BinaryTombstone tombstone;
+  ASSERT_TRUE(parse_binary_tombstone(Engrave(0), &tombstone));
+  EXPECT_EQ("", tombstone.abort_message);
+}
+
+TEST_F(TombstoneBinaryTest, parse_rejects_bad_input) {
+  std::string contents = Engrave(0);
+  BinaryTombstone tombstone;
+
+  EXPECT_FALSE(parse_binary_tombstone("", &tombstone));
+
+  std::string bad_magic = contents;
+  bad_magic[0] ^= 0xff;
+  EXPECT_FALSE(parse_binary_tombstone(bad_magic, &tombstone));
+
+  std::string truncated = contents.substr(0, contents.size() - 1);
+  EXPECT_FALSE(parse_binary_tombstone(truncated, &tombstone));
+}
+
+TEST_F(TombstoneBinaryTest, parse_skips_unknown_records) {
+  std::string contents = Engrave(0);
+  BinaryTombstoneRecordHeader header = {
+      .type = static_cast<BinaryTombstoneRecordType>(0x1000),
+      .size = 4,
+  };
+  contents.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  contents.append("abcd");
+
+  BinaryTombstone tombstone;
+  ASSERT_TRUE(parse_binary_tombstone(contents, &tombstone));
+  EXPECT_EQ("binary_process", tombstone.process_name);
+}
@@ -25,6 +25,8 @@
 #include <android-base/properties.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/RegsGetLocal.h>
 
 #include "libdebuggerd/utility.h"
 
@@ -493,3 +495,50 @@ TEST_F(TombstoneTest, gwp_asan_cause_invalid_free_outside) {
           "allocation at 0x[a-fA-F0-9]+\n"));
 }
 
+TEST_F(TombstoneTest, summary) {
+  unwinder_mock_->MockSetProcessMemory(unwindstack::Memory::CreateProcessMemory(getpid()));
+  unwinder_mock_->MockAddMap(0xa334000, 0xa335000, 0x1000, PROT_READ | PROT_EXEC,
+                             "/system/lib/libfake.so", 0);
+
+  std::unique_ptr<unwindstack::Regs> regs(unwindstack::Regs::CreateFromLocal());
+  unwindstack::RegsGetLocal(regs.get());
+  siginfo_t siginfo = {};
+  siginfo.si_signo = SIGSEGV;
+  siginfo.si_code = SEGV_MAPERR;
+  siginfo.si_addr = reinterpret_cast<void*>(0xdead);
+
+  std::map<pid_t, ThreadInfo> threads;
+  threads[12] = ThreadInfo{
+      .registers = std::move(regs),
+      .uid = 1000,
+      .tid = 12,
+      .thread_name = "summary_thread",
+      .pid = 11,
+      .process_name = "summary_process",
+      .siginfo = &siginfo,
+  };
+
+  // The summary uses the frames it is given rather than unwinding the thread again.
+  unwindstack::FrameData frame = {
+      .num = 0,
+      .rel_pc = 0x1100,
+      .pc = 0xa334100,
+      .map_start = 0xa334000,
+      .map_end = 0xa335000,
+  };
+
+  std::string amfd_data;
+  engrave_tombstone_summary(unwinder_mock_.get(), threads, 12, {frame}, 0, &amfd_data, 0, 0);
+
+  EXPECT_NE(std::string::npos,
+            amfd_data.find("pid: 11, tid: 12, name: summary_thread  >>> summary_process <<<\n"))
+      << amfd_data;
+  EXPECT_NE(std::string::npos, amfd_data.find("signal 11 (SIGSEGV), code 1 (SEGV_MAPERR)"))
+      << amfd_data;
+  EXPECT_NE(std::string::npos, amfd_data.find("\nbacktrace:\n")) << amfd_data;
+  EXPECT_NE(std::string::npos, amfd_data.find("#00 pc ")) << amfd_data;
+  EXPECT_NE(std::string::npos, amfd_data.find("1100  /system/lib/libfake.so")) << amfd_data;
+
+  // The same text goes to logcat.
+  EXPECT_NE(std::string::npos, getFakeLogBuf().find("summary_process")) << getFakeLogBuf();
+}
@@ -34,6 +34,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -46,7 +47,9 @@
 #include <log/logprint.h>
 #include <private/android_filesystem_config.h>
 #include <unwindstack/DexFiles.h>
+#include <unwindstack/Elf.h>
 #include <unwindstack/JitDebug.h>
+#include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
@@ -375,13 +378,10 @@ void dump_memory_and_code(log_t* log, unwindstack::Maps* maps, unwindstack::Memo
   });
 }
 
-static bool dump_thread(log_t* log, unwindstack::Unwinder* unwinder, const ThreadInfo& thread_info,
-                        uint64_t abort_msg_address, bool primary_thread,
-                        const GwpAsanCrashData& gwp_asan_crash_data) {
-  log->current_tid = thread_info.tid;
-  if (!primary_thread) {
-    _LOG(log, logtype::THREAD, "--- --- --- --- --- --- --- --- --- --- --- --- --- --- --- ---\n");
-  }
+// Dumps the part of a thread that is also written to logcat, except for its backtrace.
+static void dump_thread_summary(log_t* log, unwindstack::Unwinder* unwinder,
+                                const ThreadInfo& thread_info, uint64_t abort_msg_address,
+                                bool primary_thread, const GwpAsanCrashData& gwp_asan_crash_data) {
   dump_thread_info(log, thread_info);
 
   if (thread_info.siginfo) {
@@ -400,6 +400,17 @@ static bool dump_thread(log_t* log, unwindstack::Unwinder* unwinder, const Threa
   }
 
   dump_registers(log, thread_info.registers.get());
+}
+
+static bool dump_thread(log_t* log, unwindstack::Unwinder* unwinder, const ThreadInfo& thread_info,
+                        uint64_t abort_msg_address, bool primary_thread,
+                        const GwpAsanCrashData& gwp_asan_crash_data) {
+  log->current_tid = thread_info.tid;
+  if (!primary_thread) {
+    _LOG(log, logtype::THREAD, "--- --- --- --- --- --- --- --- --- --- --- --- --- --- --- ---\n");
+  }
+  dump_thread_summary(log, unwinder, thread_info, abort_msg_address, primary_thread,
+                      gwp_asan_crash_data);
 
   // Unwind will mutate the registers, so make a copy first.
   std::unique_ptr<unwindstack::Regs> regs_copy(thread_info.registers->Clone());
@@ -656,3 +667,72 @@ void engrave_tombstone(unique_fd output_fd, unwindstack::Unwinder* unwinder,
     dump_logs(&log, it->second.pid, 0);
   }
 }
+
+// Fills in the map and function names that an unwind without name resolution left out.
+static void resolve_frame_names(unwindstack::Unwinder* unwinder, unwindstack::ArchEnum arch,
+                                std::vector<unwindstack::FrameData>* frames) {
+  unwindstack::Maps* maps = unwinder->GetMaps();
+  if (maps == nullptr) {
+    return;
+  }
+  for (auto& frame : *frames) {
+    if (frame.map_start == frame.map_end) {
+      continue;
+    }
+    unwindstack::MapInfo* map_info = maps->Find(frame.pc);
+    if (map_info == nullptr) {
+      continue;
+    }
+    unwindstack::Elf* elf = map_info->GetElf(unwinder->GetProcessMemory(), arch);
+    frame.map_name = map_info->name;
+    if (map_info->elf_start_offset != 0 && !frame.map_name.empty()) {
+      std::string soname = elf->GetSoname();
+      if (!soname.empty()) {
+        frame.map_name += '!' + soname;
+      }
+    }
+    if (!elf->GetFunctionName(frame.rel_pc, &frame.function_name, &frame.function_offset)) {
+      frame.function_name = "";
+      frame.function_offset = 0;
+    }
+  }
+}
+
+void engrave_tombstone_summary(unwindstack::Unwinder* unwinder,
+                               const std::map<pid_t, ThreadInfo>& threads, pid_t target_thread,
+                               std::vector<unwindstack::FrameData> frames,
+                               uint64_t abort_msg_address, std::string* amfd_data,
+                               uintptr_t gwp_asan_state, uintptr_t gwp_asan_metadata) {
+  // There is no output file, so only what goes to logcat is generated.
+  log_t log;
+  log.current_tid = target_thread;
+  log.crashed_tid = target_thread;
+  log.amfd_data = amfd_data;
+
+  _LOG(&log, logtype::HEADER, "*** *** *** *** *** *** *** *** *** *** *** *** *** *** *** ***\n");
+  dump_header_info(&log);
+  dump_timestamp(&log, time(nullptr));
+
+  auto it = threads.find(target_thread);
+  if (it == threads.end()) {
+    LOG(FATAL) << "failed to find target thread";
+  }
+
+  GwpAsanCrashData gwp_asan_crash_data(unwinder->GetProcessMemory().get(), gwp_asan_state,
+                                       gwp_asan_metadata, it->second);
+  dump_thread_summary(&log, unwinder, it->second, abort_msg_address, true, gwp_asan_crash_data);
+
+  if (frames.empty()) {
+    _LOG(&log, logtype::THREAD, "Failed to unwind");
+    return;
+  }
+  resolve_frame_names(unwinder, it->second.registers->Arch(), &frames);
+
+  // FormatFrame only looks at the registers to tell whether the target is 32-bit.
+  unwinder->SetRegs(it->second.registers.get());
+  unwinder->SetDisplayBuildID(true);
+  _LOG(&log, logtype::BACKTRACE, "\nbacktrace:\n");
+  for (const auto& frame : frames) {
+    _LOG(&log, logtype::BACKTRACE, "    %s\n", unwinder->FormatFrame(frame).c_str());
+  }
+}
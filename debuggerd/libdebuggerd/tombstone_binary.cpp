@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "DEBUG"
+
+#include "libdebuggerd/tombstone_binary.h"
+
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/Unwinder.h>
+
+#include "libdebuggerd/utility.h"
+
+using android::base::unique_fd;
+
+// Matches the amount of memory dumped around each register in text tombstones.
+static constexpr size_t kMemoryBytesToDump = 256;
+
+namespace {
+
+class RecordWriter {
+ public:
+  template <typename T>
+  void Add(T value) {
+    buffer_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void AddString(const std::string& value) {
+    Add<uint32_t>(value.size());
+    buffer_.append(value);
+  }
+
+  void AddBytes(const void* data, size_t size) {
+    Add<uint32_t>(size);
+    buffer_.append(static_cast<const char*>(data), size);
+  }
+
+  bool Write(int fd, BinaryTombstoneRecordType type) {
+    BinaryTombstoneRecordHeader header = {
+        .type = type,
+        .size = static_cast<uint32_t>(buffer_.size()),
+    };
+    bool result = android::base::WriteFully(fd, &header, sizeof(header)) &&
+                  android::base::WriteFully(fd, buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return result;
+  }
+
+ private:
+  std::string buffer_;
+};
+
+class RecordReader {
+ public:
+  RecordReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (size_ - offset_ < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, data_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    uint32_t length;
+    if (!Read(&length) || size_ - offset_ < length) {
+      return false;
+    }
+    value->assign(data_ + offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+  bool Done() const { return offset_ == size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+static std::string read_abort_message(unwindstack::Memory* process_memory, uint64_t address) {
+  size_t length;
+  if (address == 0 || !process_memory->ReadFully(address, &length, sizeof(length)) ||
+      length < sizeof(size_t)) {
+    return "";
+  }
+
+  // The length field includes the length of the length field itself.
+  length -= sizeof(size_t);
+  std::string msg(length, '\0');
+  if (!process_memory->ReadFully(address + sizeof(length), &msg[0], length)) {
+    return "";
+  }
+
+  // The abort message is null terminated.
+  msg.resize(strnlen(msg.c_str(), length));
+  return msg;
+}
+
+static void write_thread(int fd, RecordWriter* record, unwindstack::Unwinder* unwinder,
+                         const ThreadInfo& thread_info,
+                         const std::unordered_map<unwindstack::MapInfo*, uint32_t>& map_indices) {
+  record->Add<int32_t>(thread_info.tid);
+  record->AddString(thread_info.thread_name);
+  thread_info.registers->IterateRegisters([record](const char* name, uint64_t value) {
+    record->AddString(name);
+    record->Add<uint64_t>(value);
+  });
+  record->Write(fd, BinaryTombstoneRecordType::kThread);
+
+  // Unwind will mutate the registers, so make a copy first.
+  std::unique_ptr<unwindstack::Regs> regs_copy(thread_info.registers->Clone());
+  unwinder->SetRegs(regs_copy.get());
+  unwinder->Unwind();
+
+  unwindstack::Maps* maps = unwinder->GetMaps();
+  record->Add<int32_t>(thread_info.tid);
+  for (const auto& frame : unwinder->frames()) {
+    uint32_t map_index = kBinaryTombstoneNoMap;
+    if (maps != nullptr) {
+      auto it = map_indices.find(maps->Find(frame.pc));
+      if (it != map_indices.end()) {
+        map_index = it->second;
+      }
+    }
+    record->Add<uint64_t>(frame.pc);
+    record->Add<uint64_t>(frame.rel_pc);
+    record->Add<uint64_t>(frame.sp);
+    record->Add<uint32_t>(map_index);
+  }
+  record->Write(fd, BinaryTombstoneRecordType::kBacktrace);
+}
+
+static void write_memory(int fd, RecordWriter* record, unwindstack::Memory* memory,
+                         unwindstack::Regs* regs) {
+  regs->IterateRegisters([fd, record, memory](const char* name, uint64_t addr) {
+    // Use the same window as the text tombstone's dump_memory.
+    addr &= ~(sizeof(long) - 1);
+    if (addr >= 4128) {
+      addr -= 32;
+    }
+#if defined(__LP64__)
+    if (addr < 4096 || addr > 0x4000000000000000UL - kMemoryBytesToDump) {
+#else
+    if (addr < 4096 || addr > 0xffff0000 - kMemoryBytesToDump) {
+#endif
+      return;
+    }
+
+    uint8_t data[kMemoryBytesToDump];
+    size_t bytes = memory->Read(addr, data, sizeof(data));
+    if (bytes == 0) {
+      return;
+    }
+
+    record->AddString(name);
+    record->Add<uint64_t>(addr);
+    record->AddBytes(data, bytes);
+    record->Write(fd, BinaryTombstoneRecordType::kMemory);
+  });
+}
+
+void engrave_binary_tombstone(unique_fd output_fd, unwindstack::Unwinder* unwinder,
+                              const std::map<pid_t, ThreadInfo>& threads, pid_t target_thread,
+                              uint64_t abort_msg_address,
+                              std::vector<unwindstack::FrameData>* target_frames) {
+  auto it = threads.find(target_thread);
+  if (it == threads.end()) {
+    LOG(FATAL) << "failed to find target thread";
+  }
+  const ThreadInfo& target = it->second;
+  int fd = output_fd.get();
+
+  BinaryTombstoneHeader header = {
+      .magic = kBinaryTombstoneMagic,
+      .version = kBinaryTombstoneVersion,
+      .arch = target.registers->Arch(),
+  };
+  if (!android::base::WriteFully(fd, &header, sizeof(header))) {
+    PLOG(ERROR) << "failed to write binary tombstone header";
+    return;
+  }
+
+  RecordWriter record;
+  record.Add<int32_t>(target.pid);
+  record.Add<int32_t>(target.tid);
+  record.Add<uint32_t>(target.uid);
+  record.Add<int32_t>(target.siginfo ? target.siginfo->si_signo : 0);
+  record.Add<int32_t>(target.siginfo ? target.siginfo->si_code : 0);
+  uint64_t fault_addr = 0;
+  if (target.siginfo && signal_has_si_addr(target.siginfo)) {
+    fault_addr = reinterpret_cast<uint64_t>(target.siginfo->si_addr);
+  }
+  record.Add<uint64_t>(fault_addr);
+  record.Add<int64_t>(time(nullptr));
+  record.AddString(target.process_name);
+  record.AddString(android::base::GetProperty("ro.build.fingerprint", "unknown"));
+  record.Write(fd, BinaryTombstoneRecordType::kProcess);
+
+  std::string abort_message =
+      read_abort_message(unwinder->GetProcessMemory().get(), abort_msg_address);
+  if (!abort_message.empty()) {
+    record.AddString(abort_message);
+    record.Write(fd, BinaryTombstoneRecordType::kAbortMessage);
+  }
+
+  // Nothing below needs symbols, so don't pay for them while the target is stopped.
+  unwinder->SetResolveNames(false);
+
+  // Write the maps first so that frames can refer to them by index.
+  std::unordered_map<unwindstack::MapInfo*, uint32_t> map_indices;
+  unwindstack::Maps* maps = unwinder->GetMaps();
+  if (maps != nullptr) {
+    std::shared_ptr<unwindstack::Memory>& process_memory = unwinder->GetProcessMemory();
+    for (const auto& map_info : *maps) {
+      map_indices.emplace(map_info.get(), map_indices.size());
+      record.Add<uint64_t>(map_info->start);
+      record.Add<uint64_t>(map_info->end);
+      record.Add<uint64_t>(map_info->offset);
+      record.Add<uint64_t>(map_info->GetLoadBias(process_memory));
+      record.Add<uint32_t>(map_info->flags);
+      record.AddString(map_info->name);
+      record.AddString(map_info->GetBuildID());
+    }
+    record.Write(fd, BinaryTombstoneRecordType::kMaps);
+  }
+
+  write_thread(fd, &record, unwinder, target, map_indices);
+  if (target_frames != nullptr) {
+    *target_frames = unwinder->ConsumeFrames();
+  }
+  write_memory(fd, &record, unwinder->GetProcessMemory().get(), target.registers.get());
+
+  for (const auto& [tid, thread_info] : threads) {
+    if (tid != target_thread) {
+      write_thread(fd, &record, unwinder, thread_info, map_indices);
+    }
+  }
+}
+
+static bool parse_thread(RecordReader* reader, BinaryTombstoneThread* thread) {
+  int32_t tid;
+  if (!reader->Read(&tid) || !reader->ReadString(&thread->name)) {
+    return false;
+  }
+  thread->tid = tid;
+  while (!reader->Done()) {
+    std::string name;
+    uint64_t value;
+    if (!reader->ReadString(&name) || !reader->Read(&value)) {
+      return false;
+    }
+    thread->registers.emplace_back(std::move(name), value);
+  }
+  return true;
+}
+
+static bool parse_backtrace(RecordReader* reader, BinaryTombstone* tombstone) {
+  int32_t tid;
+  if (!reader->Read(&tid)) {
+    return false;
+  }
+
+  BinaryTombstoneThread* thread = nullptr;
+  for (auto& t : tombstone->threads) {
+    if (t.tid == tid) {
+      thread = &t;
+    }
+  }
+  if (thread == nullptr) {
+    return false;
+  }
+
+  while (!reader->Done()) {
+    BinaryTombstoneFrame frame;
+    if (!reader->Read(&frame.pc) || !reader->Read(&frame.rel_pc) || !reader->Read(&frame.sp) ||
+        !reader->Read(&frame.map_index)) {
+      return false;
+    }
+    thread->frames.push_back(frame);
+  }
+  return true;
+}
+
+static bool parse_maps(RecordReader* reader, std::vector<BinaryTombstoneMap>* maps) {
+  while (!reader->Done()) {
+    BinaryTombstoneMap map;
+    if (!reader->Read(&map.start) || !reader->Read(&map.end) || !reader->Read(&map.offset) ||
+        !reader->Read(&map.load_bias) || !reader->Read(&map.flags) ||
+        !reader->ReadString(&map.name) || !reader->ReadString(&map.build_id)) {
+      return false;
+    }
+    maps->push_back(std::move(map));
+  }
+  return true;
+}
+
+bool parse_binary_tombstone(const std::string& contents, BinaryTombstone* tombstone) {
+  BinaryTombstoneHeader header;
+  if (contents.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, contents.data(), sizeof(header));
+  if (header.magic != kBinaryTombstoneMagic || header.version != kBinaryTombstoneVersion) {
+    return false;
+  }
+  tombstone->arch = header.arch;
+
+  size_t offset = sizeof(header);
+  while (offset < contents.size()) {
+    BinaryTombstoneRecordHeader record_header;
+    if (contents.size() - offset < sizeof(record_header)) {
+      return false;
+    }
+    memcpy(&record_header, contents.data() + offset, sizeof(record_header));
+    offset += sizeof(record_header);
+    if (contents.size() - offset < record_header.size) {
+      return false;
+    }
+
+    RecordReader reader(contents.data() + offset, record_header.size);
+    offset += record_header.size;
+
+    bool success = true;
+    switch (record_header.type) {
+      case BinaryTombstoneRecordType::kProcess: {
+        int32_t pid, tid;
+        uint32_t uid;
+        success = reader.Read(&pid) && reader.Read(&tid) && reader.Read(&uid) &&
+                  reader.Read(&tombstone->signo) && reader.Read(&tombstone->code) &&
+                  reader.Read(&tombstone->fault_addr) && reader.Read(&tombstone->timestamp) &&
+                  reader.ReadString(&tombstone->process_name) &&
+                  reader.ReadString(&tombstone->build_fingerprint);
+        tombstone->pid = pid;
+        tombstone->tid = tid;
+        tombstone->uid = uid;
+        break;
+      }
+
+      case BinaryTombstoneRecordType::kAbortMessage:
+        success = reader.ReadString(&tombstone->abort_message);
+        break;
+
+      case BinaryTombstoneRecordType::kThread:
+        tombstone->threads.emplace_back();
+        success = parse_thread(&reader, &tombstone->threads.back());
+        break;
+
+      case BinaryTombstoneRecordType::kBacktrace:
+        success = parse_backtrace(&reader, tombstone);
+        break;
+
+      case BinaryTombstoneRecordType::kMaps:
+        success = parse_maps(&reader, &tombstone->maps);
+        break;
+
+      case BinaryTombstoneRecordType::kMemory: {
+        BinaryTombstoneMemory memory;
+        success = reader.ReadString(&memory.label) && reader.Read(&memory.address) &&
+                  reader.ReadString(&memory.data);
+        tombstone->memory.push_back(std::move(memory));
+        break;
+      }
+
+      default:
+        // Newer writers may add record types; skip what we don't understand.
+        continue;
+    }
+
+    if (!success || !reader.Done()) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -49,11 +49,18 @@ struct DumpRequest {
   int32_t pid;
 };
 
+// The kind of dump the output fd expects. This differs from the requested type when a binary
+// tombstone request is given an intercept that was registered for a text tombstone.
+struct PerformDump {
+  DebuggerdDumpType dump_type;
+};
+
 // The full packet must always be written, regardless of whether the union is used.
 struct TombstonedCrashPacket {
   CrashPacketType packet_type;
   union {
     DumpRequest dump_request;
+    PerformDump perform_dump;
   } packet;
 };
 
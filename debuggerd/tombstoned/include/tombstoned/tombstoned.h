@@ -25,4 +25,9 @@
 bool tombstoned_connect(pid_t pid, android::base::unique_fd* tombstoned_socket,
                         android::base::unique_fd* output_fd, DebuggerdDumpType dump_type);
 
+// Also returns the kind of dump that |output_fd| expects in |output_dump_type|.
+bool tombstoned_connect(pid_t pid, android::base::unique_fd* tombstoned_socket,
+                        android::base::unique_fd* output_fd, DebuggerdDumpType dump_type,
+                        DebuggerdDumpType* output_dump_type);
+
 bool tombstoned_notify_completion(int tombstoned_socket);
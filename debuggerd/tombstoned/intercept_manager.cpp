@@ -74,7 +74,9 @@ static bool is_intercept_request_valid(const InterceptRequest& request) {
     return false;
   }
 
-  if (request.dump_type < 0 || request.dump_type > kDebuggerdJavaBacktrace) {
+  // kDebuggerdAnyIntercept is only used to look intercepts up, not to register them.
+  if (request.dump_type < 0 || request.dump_type > kDebuggerdTombstoneBinary ||
+      request.dump_type == kDebuggerdAnyIntercept) {
     return false;
   }
 
@@ -193,7 +195,8 @@ InterceptManager::InterceptManager(event_base* base, int intercept_socket) : bas
 }
 
 bool InterceptManager::GetIntercept(pid_t pid, DebuggerdDumpType dump_type,
-                                    android::base::unique_fd* out_fd) {
+                                    android::base::unique_fd* out_fd,
+                                    DebuggerdDumpType* out_dump_type) {
   auto it = this->intercepts.find(pid);
   if (it == this->intercepts.end()) {
     return false;
@@ -202,6 +205,12 @@ bool InterceptManager::GetIntercept(pid_t pid, DebuggerdDumpType dump_type,
   if (dump_type == kDebuggerdAnyIntercept) {
     LOG(INFO) << "found registered intercept of type " << it->second->dump_type
               << " for requested type kDebuggerdAnyIntercept";
+  } else if (dump_type == kDebuggerdTombstoneBinary &&
+             it->second->dump_type == kDebuggerdTombstone) {
+    // Interceptors that predate binary tombstones still get their text tombstone, since the
+    // dumper writes whatever type of dump is returned here.
+    LOG(INFO) << "found registered intercept of type kDebuggerdTombstone"
+              << " for requested type kDebuggerdTombstoneBinary";
   } else if (it->second->dump_type != dump_type) {
     LOG(WARNING) << "found non-matching intercept of type " << it->second->dump_type
                  << " for requested type: " << dump_type;
@@ -217,6 +226,7 @@ bool InterceptManager::GetIntercept(pid_t pid, DebuggerdDumpType dump_type,
   response.status = InterceptStatus::kStarted;
   TEMP_FAILURE_RETRY(write(intercept->sockfd, &response, sizeof(response)));
   *out_fd = std::move(intercept->output_fd);
+  *out_dump_type = intercept->dump_type;
 
   return true;
 }
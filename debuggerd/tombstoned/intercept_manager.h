@@ -53,5 +53,8 @@ struct InterceptManager {
   InterceptManager(InterceptManager& copy) = delete;
   InterceptManager(InterceptManager&& move) = delete;
 
-  bool GetIntercept(pid_t pid, DebuggerdDumpType dump_type, android::base::unique_fd* out_fd);
+  // A tombstone intercept also takes binary tombstone requests. The type of the intercept that
+  // was found is returned in |out_dump_type|.
+  bool GetIntercept(pid_t pid, DebuggerdDumpType dump_type, android::base::unique_fd* out_fd,
+                    DebuggerdDumpType* out_dump_type);
 };
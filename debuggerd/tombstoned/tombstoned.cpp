@@ -21,22 +21,29 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <deque>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <event2/event.h>
 #include <event2/listener.h>
 #include <event2/thread.h>
 
 #include <android-base/cmsg.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <cutils/sockets.h>
+#include <private/android_filesystem_config.h>
 
 #include "debuggerd/handler.h"
 #include "dump_type.h"
@@ -46,9 +53,12 @@
 #include "intercept_manager.h"
 
 using android::base::GetIntProperty;
+using android::base::ParseInt;
+using android::base::ReadFileToString;
 using android::base::SendFileDescriptors;
 using android::base::StringPrintf;
 using android::base::unique_fd;
+using namespace std::chrono_literals;
 
 static InterceptManager* intercept_manager;
 
@@ -57,6 +67,21 @@ enum CrashStatus {
   kCrashStatusQueued,
 };
 
+// Queued crashes with a higher priority are dispatched first. Crashes of equal priority are
+// dispatched in the order in which they arrived.
+enum CrashPriority {
+  kCrashPriorityNormal,
+  kCrashPriorityHigh,
+};
+
+// A queued crash that has waited for longer than this is treated as high priority, so that a
+// steady stream of high priority requests can't starve everything else.
+static constexpr std::chrono::milliseconds kQueuedCrashDeadline = 5s;
+
+// Binary tombstones take the same numbered slots as text tombstones, with this suffix so that
+// tools reading tombstone_NN don't come across them. A slot holds one or the other, never both.
+static constexpr char kBinaryTombstoneSuffix[] = ".bin";
+
 // Ownership of Crash is a bit messy.
 // It's either owned by an active event that must have a timeout, or owned by
 // queued_requests, in the case that multiple crashes come in at the same time.
@@ -70,13 +95,55 @@ struct Crash {
   event* crash_event = nullptr;
 
   DebuggerdDumpType crash_type;
+  CrashPriority crash_priority = kCrashPriorityNormal;
+
+  std::chrono::steady_clock::time_point request_time;
+  std::chrono::steady_clock::time_point start_time;
+};
+
+// Processes that the user is likely to notice (system daemons and foreground apps) get their
+// dumps taken before those of background apps.
+static CrashPriority get_crash_priority(pid_t pid) {
+  struct stat st;
+  std::string proc_path = StringPrintf("/proc/%d", pid);
+  if (stat(proc_path.c_str(), &st) != 0) {
+    return kCrashPriorityNormal;
+  }
+
+  // Apps of secondary users have uids of the form user_id * AID_USER_OFFSET + app_id.
+  if (st.st_uid % AID_USER_OFFSET < AID_APP_START) {
+    return kCrashPriorityHigh;
+  }
+
+  std::string oom_score_adj;
+  int value;
+  if (ReadFileToString(proc_path + "/oom_score_adj", &oom_score_adj) &&
+      ParseInt(android::base::Trim(oom_score_adj), &value) && value <= 0) {
+    return kCrashPriorityHigh;
+  }
+
+  return kCrashPriorityNormal;
+}
+
+struct CrashQueueStats {
+  size_t requests = 0;
+  size_t queued = 0;
+  size_t promoted = 0;
+  size_t completed = 0;
+  size_t preallocated_outputs_used = 0;
+
+  std::chrono::milliseconds total_queue_time = 0ms;
+  std::chrono::milliseconds max_queue_time = 0ms;
+  std::chrono::milliseconds total_dump_time = 0ms;
+  std::chrono::milliseconds max_dump_time = 0ms;
 };
 
 class CrashQueue {
  public:
   CrashQueue(const std::string& dir_path, const std::string& file_name_prefix, size_t max_artifacts,
-             size_t max_concurrent_dumps)
+             size_t max_concurrent_dumps, bool binary_artifacts = false)
       : file_name_prefix_(file_name_prefix),
+        binary_artifacts_(binary_artifacts),
         dir_path_(dir_path),
         dir_fd_(open(dir_path.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC)),
         max_artifacts_(max_artifacts),
@@ -92,16 +159,18 @@ class CrashQueue {
     CHECK(max_artifacts_ > max_concurrent_dumps_);
 
     find_oldest_artifact();
+    preallocate_outputs();
   }
 
   static CrashQueue* for_crash(const Crash* crash) {
     return (crash->crash_type == kDebuggerdJavaBacktrace) ? for_anrs() : for_tombstones();
   }
 
+  // Text and binary tombstones share one queue, and so one count, rotation and dump slot.
   static CrashQueue* for_tombstones() {
     static CrashQueue queue("/data/tombstones", "tombstone_" /* file_name_prefix */,
                             GetIntProperty("tombstoned.max_tombstone_count", 32),
-                            1 /* max_concurrent_dumps */);
+                            1 /* max_concurrent_dumps */, true /* binary_artifacts */);
     return &queue;
   }
 
@@ -113,6 +182,13 @@ class CrashQueue {
   }
 
   std::pair<std::string, unique_fd> get_output() {
+    if (!preallocated_outputs_.empty()) {
+      unique_fd result = std::move(preallocated_outputs_.back());
+      preallocated_outputs_.pop_back();
+      ++stats_.preallocated_outputs_used;
+      return std::make_pair(std::string(), std::move(result));
+    }
+
     std::string path;
     unique_fd result(openat(dir_fd_, ".", O_WRONLY | O_APPEND | O_TMPFILE | O_CLOEXEC, 0640));
     if (result == -1) {
@@ -137,8 +213,25 @@ class CrashQueue {
     return file_name;
   }
 
+  // Keep an anonymous output file around for each dump slot, so that starting a dump under load
+  // doesn't have to wait for file creation. This only works with O_TMPFILE: without it,
+  // get_output falls back to creating a named temporary file on demand.
+  void preallocate_outputs() {
+    while (preallocated_outputs_.size() < max_concurrent_dumps_) {
+      unique_fd fd(openat(dir_fd_, ".", O_WRONLY | O_APPEND | O_TMPFILE | O_CLOEXEC, 0640));
+      if (fd == -1) {
+        return;
+      }
+      preallocated_outputs_.push_back(std::move(fd));
+    }
+  }
+
   bool maybe_enqueue_crash(Crash* crash) {
+    ++stats_.requests;
+    crash->request_time = std::chrono::steady_clock::now();
+
     if (num_concurrent_dumps_ == max_concurrent_dumps_) {
+      ++stats_.queued;
       queued_requests_.push_back(crash);
       return true;
     }
@@ -148,15 +241,59 @@ class CrashQueue {
 
   void maybe_dequeue_crashes(void (*handler)(Crash* crash)) {
     while (!queued_requests_.empty() && num_concurrent_dumps_ < max_concurrent_dumps_) {
-      Crash* next_crash = queued_requests_.front();
-      queued_requests_.pop_front();
+      auto now = std::chrono::steady_clock::now();
+      auto it = std::find_if(queued_requests_.begin(), queued_requests_.end(), [now](Crash* c) {
+        return c->crash_priority == kCrashPriorityHigh ||
+               now - c->request_time >= kQueuedCrashDeadline;
+      });
+      if (it == queued_requests_.end()) {
+        it = queued_requests_.begin();
+      } else if ((*it)->crash_priority != kCrashPriorityHigh) {
+        ++stats_.promoted;
+      }
+
+      Crash* next_crash = *it;
+      queued_requests_.erase(it);
       handler(next_crash);
     }
   }
 
-  void on_crash_started() { ++num_concurrent_dumps_; }
+  void on_crash_started(Crash* crash) {
+    ++num_concurrent_dumps_;
 
-  void on_crash_completed() { --num_concurrent_dumps_; }
+    crash->start_time = std::chrono::steady_clock::now();
+    auto queue_time = std::chrono::duration_cast<std::chrono::milliseconds>(crash->start_time -
+                                                                            crash->request_time);
+    stats_.total_queue_time += queue_time;
+    stats_.max_queue_time = std::max(stats_.max_queue_time, queue_time);
+  }
+
+  void on_crash_completed(const Crash* crash) {
+    --num_concurrent_dumps_;
+
+    ++stats_.completed;
+    auto dump_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - crash->start_time);
+    stats_.total_dump_time += dump_time;
+    stats_.max_dump_time = std::max(stats_.max_dump_time, dump_time);
+  }
+
+  void dump_stats() const {
+    auto average = [](std::chrono::milliseconds total, size_t count) {
+      return count == 0 ? 0 : total.count() / static_cast<long long>(count);
+    };
+
+    LOG(INFO) << dir_path_ << ": " << stats_.requests << " requests, " << stats_.queued
+              << " queued (" << queued_requests_.size() << " pending, " << stats_.promoted
+              << " promoted past deadline), " << stats_.completed << " completed, "
+              << num_concurrent_dumps_ << " running";
+    LOG(INFO) << dir_path_ << ": queue time avg " << average(stats_.total_queue_time,
+                                                             stats_.completed + num_concurrent_dumps_)
+              << "ms max " << stats_.max_queue_time.count() << "ms, dump time avg "
+              << average(stats_.total_dump_time, stats_.completed) << "ms max "
+              << stats_.max_dump_time.count() << "ms, " << stats_.preallocated_outputs_used
+              << " preallocated outputs used";
+  }
 
  private:
   void find_oldest_artifact() {
@@ -166,6 +303,9 @@ class CrashQueue {
     for (size_t i = 0; i < max_artifacts_; ++i) {
       std::string path = StringPrintf("%s/%s%02zu", dir_path_.c_str(), file_name_prefix_.c_str(), i);
       struct stat st;
+      if (stat(path.c_str(), &st) != 0 && errno == ENOENT && binary_artifacts_) {
+        path += kBinaryTombstoneSuffix;
+      }
       if (stat(path.c_str(), &st) != 0) {
         if (errno == ENOENT) {
           oldest_tombstone = i;
@@ -186,6 +326,7 @@ class CrashQueue {
   }
 
   const std::string file_name_prefix_;
+  const bool binary_artifacts_;
 
   const std::string dir_path_;
   const int dir_fd_;
@@ -197,6 +338,9 @@ class CrashQueue {
   size_t num_concurrent_dumps_;
 
   std::deque<Crash*> queued_requests_;
+  std::vector<unique_fd> preallocated_outputs_;
+
+  CrashQueueStats stats_;
 
   DISALLOW_COPY_AND_ASSIGN(CrashQueue);
 };
@@ -211,8 +355,9 @@ static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg);
 
 static void perform_request(Crash* crash) {
   unique_fd output_fd;
-  bool intercepted =
-      intercept_manager->GetIntercept(crash->crash_pid, crash->crash_type, &output_fd);
+  DebuggerdDumpType output_dump_type = crash->crash_type;
+  bool intercepted = intercept_manager->GetIntercept(crash->crash_pid, crash->crash_type,
+                                                     &output_fd, &output_dump_type);
   if (!intercepted) {
     if (crash->crash_type == kDebuggerdNativeBacktrace) {
       // Don't generate tombstones for native backtrace requests.
@@ -226,6 +371,7 @@ static void perform_request(Crash* crash) {
   TombstonedCrashPacket response = {
     .packet_type = CrashPacketType::kPerformDump
   };
+  response.packet.perform_dump.dump_type = output_dump_type;
   ssize_t rc =
       SendFileDescriptors(crash->crash_socket_fd, &response, sizeof(response), output_fd.get());
   output_fd.reset();
@@ -246,7 +392,7 @@ static void perform_request(Crash* crash) {
     event_add(crash->crash_event, &timeout);
   }
 
-  CrashQueue::for_crash(crash)->on_crash_started();
+  CrashQueue::for_crash(crash)->on_crash_started(crash);
   return;
 
 fail:
@@ -298,7 +444,7 @@ static void crash_request_cb(evutil_socket_t sockfd, short ev, void* arg) {
   }
 
   crash->crash_type = request.packet.dump_request.dump_type;
-  if (crash->crash_type < 0 || crash->crash_type > kDebuggerdAnyIntercept) {
+  if (crash->crash_type < 0 || crash->crash_type > kDebuggerdTombstoneBinary) {
     LOG(WARNING) << "unexpected crash dump type: " << crash->crash_type;
     goto fail;
   }
@@ -320,7 +466,9 @@ static void crash_request_cb(evutil_socket_t sockfd, short ev, void* arg) {
     crash->crash_pid = cr.pid;
   }
 
-  LOG(INFO) << "received crash request for pid " << crash->crash_pid;
+  crash->crash_priority = get_crash_priority(crash->crash_pid);
+  LOG(INFO) << "received crash request for pid " << crash->crash_pid
+            << (crash->crash_priority == kCrashPriorityHigh ? " (high priority)" : "");
 
   if (CrashQueue::for_crash(crash)->maybe_enqueue_crash(crash)) {
     LOG(INFO) << "enqueueing crash request for pid " << crash->crash_pid;
@@ -339,7 +487,7 @@ static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg) {
   Crash* crash = static_cast<Crash*>(arg);
   TombstonedCrashPacket request = {};
 
-  CrashQueue::for_crash(crash)->on_crash_completed();
+  CrashQueue::for_crash(crash)->on_crash_completed(crash);
 
   if ((ev & EV_READ) == 0) {
     goto fail;
@@ -364,9 +512,24 @@ static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg) {
   if (crash->crash_tombstone_fd != -1) {
     std::string fd_path = StringPrintf("/proc/self/fd/%d", crash->crash_tombstone_fd.get());
     std::string tombstone_path = CrashQueue::for_crash(crash)->get_next_artifact_path();
+    int rc;
+
+    // Remove whichever format of tombstone this slot held before, so that its number only ever
+    // refers to one crash.
+    if (crash->crash_type == kDebuggerdTombstone || crash->crash_type == kDebuggerdTombstoneBinary) {
+      std::string other_path = tombstone_path + kBinaryTombstoneSuffix;
+      if (crash->crash_type == kDebuggerdTombstoneBinary) {
+        std::swap(tombstone_path, other_path);
+      }
+      rc = unlink(other_path.c_str());
+      if (rc != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "failed to unlink tombstone at " << other_path;
+        goto fail;
+      }
+    }
 
     // linkat doesn't let us replace a file, so we need to unlink first.
-    int rc = unlink(tombstone_path.c_str());
+    rc = unlink(tombstone_path.c_str());
     if (rc != 0 && errno != ENOENT) {
       PLOG(ERROR) << "failed to unlink tombstone at " << tombstone_path;
       goto fail;
@@ -401,6 +564,16 @@ fail:
 
   // If there's something queued up, let them proceed.
   queue->maybe_dequeue_crashes(perform_request);
+
+  // Replace the output file we just used while we're idle.
+  queue->preallocate_outputs();
+}
+
+static void dump_stats_cb(evutil_socket_t, short, void*) {
+  CrashQueue::for_tombstones()->dump_stats();
+  if (kJavaTraceDumpsEnabled) {
+    CrashQueue::for_anrs()->dump_stats();
+  }
 }
 
 int main(int, char* []) {
@@ -453,6 +626,12 @@ int main(int, char* []) {
     }
   }
 
+  // `kill -USR1 $(pidof tombstoned)` logs per-queue latency and throughput counters.
+  event* stats_event = evsignal_new(base, SIGUSR1, dump_stats_cb, nullptr);
+  if (!stats_event || event_add(stats_event, nullptr) != 0) {
+    LOG(ERROR) << "failed to register SIGUSR1 handler for stats";
+  }
+
   LOG(INFO) << "tombstoned successfully initialized";
   event_base_dispatch(base);
 }
@@ -34,6 +34,12 @@ using android::base::unique_fd;
 
 bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* output_fd,
                         DebuggerdDumpType dump_type) {
+  DebuggerdDumpType output_dump_type;
+  return tombstoned_connect(pid, tombstoned_socket, output_fd, dump_type, &output_dump_type);
+}
+
+bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* output_fd,
+                        DebuggerdDumpType dump_type, DebuggerdDumpType* output_dump_type) {
   unique_fd sockfd(
       socket_local_client((dump_type != kDebuggerdJavaBacktrace ? kTombstonedCrashSocketName
                                                                 : kTombstonedJavaTraceSocketName),
@@ -79,6 +85,7 @@ bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* outp
 
   *tombstoned_socket = std::move(sockfd);
   *output_fd = std::move(tmp_output_fd);
+  *output_dump_type = packet.packet.perform_dump.dump_type;
   return true;
 }
 
@@ -21,6 +21,7 @@
 #include <android-base/properties.h>
 #include <android-base/strings.h>
 
+#include "boot_trace.h"
 #include "util.h"
 
 using android::base::Join;
@@ -150,6 +151,35 @@ void Action::ExecuteOneCommand(std::size_t command) const {
     ExecuteCommand(cmd);
 }
 
+bool Action::ExecuteSubcontextBatchAsync(std::size_t command,
+                                         std::function<void(std::size_t)> done) const {
+    if (!subcontext_ || !commands_[command].execute_in_subcontext()) {
+        return false;
+    }
+
+    auto end = command;
+    while (end < commands_.size() && commands_[end].execute_in_subcontext()) {
+        ++end;
+    }
+
+    // As in ExecuteOneCommand(), copy the commands since commands_ may change before they finish.
+    auto batch = std::vector<Command>(commands_.begin() + command, commands_.begin() + end);
+    auto batch_args = std::vector<std::vector<std::string>>{};
+    for (const auto& batch_command : batch) {
+        batch_args.emplace_back(batch_command.args());
+    }
+
+    auto callback = [this, batch = std::move(batch),
+                     done = std::move(done)](std::vector<SubcontextCommandResult> results) {
+        auto completed = std::min(results.size(), batch.size());
+        for (std::size_t i = 0; i < completed; ++i) {
+            LogCommandResult(batch[i], results[i].result, results[i].start, results[i].end);
+        }
+        done(completed);
+    };
+    return subcontext_->ExecuteBatchAsync(batch_args, std::move(callback)).ok();
+}
+
 void Action::ExecuteAllCommands() const {
     for (const auto& c : commands_) {
         ExecuteCommand(c);
@@ -157,9 +187,19 @@ void Action::ExecuteAllCommands() const {
 }
 
 void Action::ExecuteCommand(const Command& command) const {
-    android::base::Timer t;
+    auto start = android::base::boot_clock::now();
     auto result = command.InvokeFunc(subcontext_);
-    auto duration = t.duration();
+    LogCommandResult(command, result, start, android::base::boot_clock::now());
+}
+
+void Action::LogCommandResult(const Command& command, const Result<void>& result,
+                              android::base::boot_clock::time_point start,
+                              android::base::boot_clock::time_point end) const {
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+    if (IsBootTraceEnabled()) {
+        BootTraceComplete(BootTraceCategory::kCommand, command.BuildCommandString(), start, end);
+    }
 
     // Any action longer than 50ms will be warned to user as slow operation
     if (!result.has_value() || duration > 50ms ||
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <queue>
 #include <string>
@@ -43,6 +44,8 @@ class Command {
     Result<void> CheckCommand() const;
 
     int line() const { return line_; }
+    bool execute_in_subcontext() const { return execute_in_subcontext_; }
+    const std::vector<std::string>& args() const { return args_; }
 
   private:
     BuiltinFunction func_;
@@ -65,6 +68,13 @@ class Action {
     void AddCommand(BuiltinFunction f, std::vector<std::string>&& args, int line);
     size_t NumCommands() const;
     void ExecuteOneCommand(std::size_t command) const;
+    // Sends |command| and the commands after it that also run in the subcontext to the subcontext
+    // as one batch, without waiting for them.  Once they have run, their results are logged and
+    // |done| is called with how many of them ran.  Returns false if |command| does not run in the
+    // subcontext or the batch could not be sent, in which case it should be run with
+    // ExecuteOneCommand().
+    bool ExecuteSubcontextBatchAsync(std::size_t command,
+                                     std::function<void(std::size_t)> done) const;
     void ExecuteAllCommands() const;
     bool CheckEvent(const EventTrigger& event_trigger) const;
     bool CheckEvent(const PropertyChange& property_change) const;
@@ -74,6 +84,10 @@ class Action {
     size_t CheckAllCommands() const;
 
     bool oneshot() const { return oneshot_; }
+    const std::string& event_trigger() const { return event_trigger_; }
+    const std::map<std::string, std::string>& property_triggers() const {
+        return property_triggers_;
+    }
     const std::string& filename() const { return filename_; }
     int line() const { return line_; }
     static void set_function_map(const BuiltinFunctionMap* function_map) {
@@ -82,6 +96,9 @@ class Action {
 
   private:
     void ExecuteCommand(const Command& command) const;
+    void LogCommandResult(const Command& command, const Result<void>& result,
+                          android::base::boot_clock::time_point start,
+                          android::base::boot_clock::time_point end) const;
     bool CheckPropertyTriggers(const std::string& name = "",
                                const std::string& value = "") const;
 
@@ -16,8 +16,12 @@
 
 #include "action_manager.h"
 
+#include <algorithm>
+
 #include <android-base/logging.h>
 
+#include "boot_trace.h"
+
 namespace android {
 namespace init {
 
@@ -31,15 +35,119 @@ size_t ActionManager::CheckAllCommands() {
     return failures;
 }
 
+static std::string EventName(const EventTrigger& event_trigger) {
+    return event_trigger;
+}
+
+static std::string EventName(const PropertyChange& property_change) {
+    return property_change.first + "=" + property_change.second;
+}
+
+static std::string EventName(const BuiltinAction& builtin_action) {
+    return builtin_action->BuildTriggersString();
+}
+
 ActionManager& ActionManager::GetInstance() {
     static ActionManager instance;
     return instance;
 }
 
 void ActionManager::AddAction(std::unique_ptr<Action> action) {
+    IndexAction(action.get());
     actions_.emplace_back(std::move(action));
 }
 
+void ActionManager::IndexAction(Action* action) {
+    IndexEntry entry{next_action_sequence_++, action};
+    if (!action->event_trigger().empty()) {
+        event_actions_[action->event_trigger()].emplace_back(entry);
+        return;
+    }
+
+    property_only_actions_.emplace_back(entry);
+    if (action->property_triggers().empty()) {
+        untriggered_actions_.emplace_back(entry);
+    }
+    for (const auto& [name, value] : action->property_triggers()) {
+        property_actions_[name][value].emplace_back(entry);
+    }
+}
+
+void ActionManager::UnindexAction(const Action* action) {
+    auto erase = [action](IndexList& list) {
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [action](const IndexEntry& e) { return e.second == action; }),
+                   list.end());
+    };
+
+    if (!action->event_trigger().empty()) {
+        auto it = event_actions_.find(action->event_trigger());
+        if (it != event_actions_.end()) {
+            erase(it->second);
+        }
+        return;
+    }
+
+    erase(property_only_actions_);
+    erase(untriggered_actions_);
+    for (const auto& [name, value] : action->property_triggers()) {
+        auto name_it = property_actions_.find(name);
+        if (name_it == property_actions_.end()) continue;
+        auto value_it = name_it->second.find(value);
+        if (value_it == name_it->second.end()) continue;
+        erase(value_it->second);
+    }
+}
+
+// Merges the index lists into a single list of actions in |actions_| order.
+static std::vector<Action*> MergeIndexLists(
+        std::initializer_list<const std::vector<std::pair<uint64_t, Action*>>*> lists) {
+    std::vector<std::pair<uint64_t, Action*>> entries;
+    for (const auto* list : lists) {
+        if (list) entries.insert(entries.end(), list->begin(), list->end());
+    }
+    std::sort(entries.begin(), entries.end());
+
+    std::vector<Action*> result;
+    result.reserve(entries.size());
+    for (const auto& [sequence, action] : entries) {
+        result.emplace_back(action);
+    }
+    return result;
+}
+
+std::vector<Action*> ActionManager::FindCandidates(const EventTrigger& event_trigger) const {
+    auto it = event_actions_.find(event_trigger);
+    if (it == event_actions_.end()) {
+        return {};
+    }
+    return MergeIndexLists({&it->second});
+}
+
+std::vector<Action*> ActionManager::FindCandidates(const PropertyChange& property_change) const {
+    const auto& [name, value] = property_change;
+    if (name.empty()) {
+        return MergeIndexLists({&property_only_actions_});
+    }
+
+    auto name_it = property_actions_.find(name);
+    if (name_it == property_actions_.end()) {
+        return MergeIndexLists({&untriggered_actions_});
+    }
+
+    auto find_value = [&values = name_it->second](const std::string& v) -> const IndexList* {
+        auto it = values.find(v);
+        return it == values.end() ? nullptr : &it->second;
+    };
+    // A change to the literal value "*" must not pick up the wildcard actions twice.
+    return MergeIndexLists({&untriggered_actions_, find_value(value),
+                            value == "*" ? nullptr : find_value("*")});
+}
+
+std::vector<Action*> ActionManager::FindCandidates(const BuiltinAction& builtin_action) const {
+    return {builtin_action};
+}
+
 void ActionManager::QueueEventTrigger(const std::string& trigger) {
     auto lock = std::lock_guard{event_queue_lock_};
     event_queue_.emplace(trigger);
@@ -61,20 +169,34 @@ void ActionManager::QueueBuiltinAction(BuiltinFunction func, const std::string&
     action->AddCommand(std::move(func), {name}, 0);
 
     event_queue_.emplace(action.get());
+    IndexAction(action.get());
     actions_.emplace_back(std::move(action));
 }
 
 void ActionManager::ExecuteOneCommand() {
+    // The commands of an action run in order, so nothing else runs until the batch is done.
+    if (subcontext_batch_running_) {
+        return;
+    }
+
     {
         auto lock = std::lock_guard{event_queue_lock_};
         // Loop through the event queue until we have an action to execute
         while (current_executing_actions_.empty() && !event_queue_.empty()) {
-            for (const auto& action : actions_) {
-                if (std::visit([&action](const auto& event) { return action->CheckEvent(event); },
-                               event_queue_.front())) {
-                    current_executing_actions_.emplace(action.get());
-                }
-            }
+            std::visit(
+                    [this](const auto& event) {
+                        size_t matched = 0;
+                        for (const auto* action : FindCandidates(event)) {
+                            if (action->CheckEvent(event)) {
+                                current_executing_actions_.emplace(action);
+                                ++matched;
+                            }
+                        }
+                        if (matched > 0 && IsBootTraceEnabled()) {
+                            BootTraceInstant(BootTraceCategory::kTrigger, EventName(event));
+                        }
+                    },
+                    event_queue_.front());
             event_queue_.pop();
         }
     }
@@ -89,18 +211,41 @@ void ActionManager::ExecuteOneCommand() {
         std::string trigger_name = action->BuildTriggersString();
         LOG(INFO) << "processing action (" << trigger_name << ") from (" << action->filename()
                   << ":" << action->line() << ")";
+        current_action_start_ = android::base::boot_clock::now();
+    }
+
+    auto batch_done = [this, action, generation = queue_generation_](std::size_t completed) {
+        if (generation != queue_generation_) {
+            return;
+        }
+        subcontext_batch_running_ = false;
+        FinishCommands(action, completed);
+    };
+    if (action->ExecuteSubcontextBatchAsync(current_command_, std::move(batch_done))) {
+        subcontext_batch_running_ = true;
+        return;
     }
 
     action->ExecuteOneCommand(current_command_);
+    FinishCommands(action, 1);
+}
 
+void ActionManager::FinishCommands(const Action* action, std::size_t count) {
     // If this was the last command in the current action, then remove
     // the action from the executing list.
     // If this action was oneshot, then also remove it from actions_.
-    ++current_command_;
+    current_command_ += count;
     if (current_command_ == action->NumCommands()) {
+        if (IsBootTraceEnabled()) {
+            BootTraceComplete(BootTraceCategory::kAction,
+                              action->BuildTriggersString() + " (" + action->filename() + ":" +
+                                      std::to_string(action->line()) + ")",
+                              current_action_start_, android::base::boot_clock::now());
+        }
         current_executing_actions_.pop();
         current_command_ = 0;
         if (action->oneshot()) {
+            UnindexAction(action);
             auto eraser = [&action](std::unique_ptr<Action>& a) { return a.get() == action; };
             actions_.erase(std::remove_if(actions_.begin(), actions_.end(), eraser),
                            actions_.end());
@@ -109,6 +254,10 @@ void ActionManager::ExecuteOneCommand() {
 }
 
 bool ActionManager::HasMoreCommands() const {
+    // A batch running in the subcontext wakes up the epoll loop when it is done.
+    if (subcontext_batch_running_) {
+        return false;
+    }
     auto lock = std::lock_guard{event_queue_lock_};
     return !current_executing_actions_.empty() || !event_queue_.empty();
 }
@@ -125,6 +274,9 @@ void ActionManager::ClearQueue() {
     current_executing_actions_ = {};
     event_queue_ = {};
     current_command_ = 0;
+    // The results of a batch that is still running no longer belong to any queued action.
+    ++queue_generation_;
+    subcontext_batch_running_ = false;
 }
 
 }  // namespace init
@@ -16,10 +16,15 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/thread_annotations.h>
 
 #include "action.h"
@@ -50,12 +55,41 @@ class ActionManager {
     ActionManager(ActionManager const&) = delete;
     void operator=(ActionManager const&) = delete;
 
+    // Actions are indexed by their triggers so that dispatching an event only has to check the
+    // actions that could match it. Each entry carries the action's position in |actions_| order,
+    // which is the order matching actions must be queued in.
+    using IndexEntry = std::pair<uint64_t, Action*>;
+    using IndexList = std::vector<IndexEntry>;
+
+    void IndexAction(Action* action);
+    void UnindexAction(const Action* action);
+    std::vector<Action*> FindCandidates(const EventTrigger& event_trigger) const;
+    std::vector<Action*> FindCandidates(const PropertyChange& property_change) const;
+    std::vector<Action*> FindCandidates(const BuiltinAction& builtin_action) const;
+    void FinishCommands(const Action* action, std::size_t count);
+
     std::vector<std::unique_ptr<Action>> actions_;
+    uint64_t next_action_sequence_ = 0;
+    // Event trigger name -> actions with that event trigger.
+    std::unordered_map<std::string, IndexList> event_actions_;
+    // Property name -> trigger value ("*" included) -> property-only actions with that trigger.
+    std::unordered_map<std::string, std::unordered_map<std::string, IndexList>> property_actions_;
+    // All actions without an event trigger, for QueueAllPropertyActions().
+    IndexList property_only_actions_;
+    // Actions with no triggers at all, which match any property change.
+    IndexList untriggered_actions_;
+
     std::queue<std::variant<EventTrigger, PropertyChange, BuiltinAction>> event_queue_
             GUARDED_BY(event_queue_lock_);
     mutable std::mutex event_queue_lock_;
     std::queue<const Action*> current_executing_actions_;
     std::size_t current_command_;
+    // When the first command of the current action started, for the boot trace.
+    android::base::boot_clock::time_point current_action_start_;
+    // Set while commands of the current action run as a batch in the subcontext.
+    bool subcontext_batch_running_ = false;
+    // Bumped by ClearQueue(), so that a batch started before it does not advance the queue.
+    uint64_t queue_generation_ = 0;
 };
 
 }  // namespace init
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "action_manager.h"
+
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace init {
+
+// Models a device with many `on property:` triggers across vendor .rc files and a storm of property
+// sets during boot, of which only a few match any trigger.
+static void BenchmarkPropertyTriggerDispatch(benchmark::State& state) {
+    const int action_count = state.range(0);
+    constexpr int kPropertyChanges = 1000;
+
+    ActionManager am;
+    auto noop = [](const BuiltinArguments&) { return Result<void>{}; };
+    for (int i = 0; i < action_count; ++i) {
+        std::map<std::string, std::string> property_triggers = {
+                {android::base::StringPrintf("vendor.bench.prop%d", i), i % 2 ? "1" : "*"}};
+        auto action = std::make_unique<Action>(false, nullptr, "bench.rc", i, "",
+                                               property_triggers);
+        action->AddCommand(noop, {"noop"}, i);
+        am.AddAction(std::move(action));
+    }
+
+    for (auto _ : state) {
+        for (int i = 0; i < kPropertyChanges; ++i) {
+            // One in ten property changes hits an action; the rest match nothing.
+            int prop = i % 10 == 0 ? i % action_count : action_count + i;
+            am.QueuePropertyChange(android::base::StringPrintf("vendor.bench.prop%d", prop), "1");
+        }
+        while (am.HasMoreCommands()) {
+            am.ExecuteOneCommand();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * kPropertyChanges);
+}
+
+BENCHMARK(BenchmarkPropertyTriggerDispatch)->Arg(100)->Arg(1000)->Arg(5000);
+
+static void BenchmarkEventTriggerDispatch(benchmark::State& state) {
+    const int action_count = state.range(0);
+
+    ActionManager am;
+    auto noop = [](const BuiltinArguments&) { return Result<void>{}; };
+    for (int i = 0; i < action_count; ++i) {
+        auto action = std::make_unique<Action>(
+                false, nullptr, "bench.rc", i, android::base::StringPrintf("bench-event%d", i),
+                std::map<std::string, std::string>{});
+        action->AddCommand(noop, {"noop"}, i);
+        am.AddAction(std::move(action));
+    }
+
+    for (auto _ : state) {
+        am.QueueEventTrigger("bench-event0");
+        while (am.HasMoreCommands()) {
+            am.ExecuteOneCommand();
+        }
+    }
+}
+
+BENCHMARK(BenchmarkEventTriggerDispatch)->Arg(100)->Arg(1000)->Arg(5000);
+
+}  // namespace init
+}  // namespace android
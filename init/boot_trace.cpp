@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "boot_trace.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/thread_annotations.h>
+
+using android::base::boot_clock;
+using android::base::StringAppendF;
+
+namespace android {
+namespace init {
+
+namespace {
+
+// Events are fixed size so that recording one never allocates.  Longer names are truncated.
+struct BootTraceEvent {
+    int64_t start_ns;
+    int64_t duration_ns;  // -1 for instant events.
+    pid_t pid;
+    BootTraceCategory category;
+    char name[100];
+};
+
+std::atomic<bool> enabled = false;
+std::mutex lock;
+std::vector<BootTraceEvent> events GUARDED_BY(lock);
+size_t next_event GUARDED_BY(lock) = 0;
+bool wrapped GUARDED_BY(lock) = false;
+
+const char* CategoryName(BootTraceCategory category) {
+    switch (category) {
+        case BootTraceCategory::kAction:
+            return "action";
+        case BootTraceCategory::kCommand:
+            return "command";
+        case BootTraceCategory::kService:
+            return "service";
+        case BootTraceCategory::kTrigger:
+            return "trigger";
+        case BootTraceCategory::kWait:
+            return "wait";
+    }
+    return "unknown";
+}
+
+void Record(BootTraceCategory category, std::string_view name, int64_t start_ns,
+            int64_t duration_ns, pid_t pid) {
+    auto guard = std::lock_guard{lock};
+    if (events.empty()) return;
+
+    auto& event = events[next_event];
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    event.pid = pid;
+    event.category = category;
+    size_t length = std::min(name.size(), sizeof(event.name) - 1);
+    memcpy(event.name, name.data(), length);
+    event.name[length] = '\0';
+
+    if (++next_event == events.size()) {
+        next_event = 0;
+        wrapped = true;
+    }
+}
+
+void AppendJsonString(std::string* out, const char* s) {
+    out->push_back('"');
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back(c);
+        } else if (c < 0x20) {
+            StringAppendF(out, "\\u%04x", c);
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+}  // namespace
+
+void StartBootTrace(size_t capacity) {
+    auto guard = std::lock_guard{lock};
+    if (!events.empty()) return;
+
+    events.resize(capacity);
+    next_event = 0;
+    wrapped = false;
+    enabled = true;
+}
+
+void StopBootTrace() {
+    auto guard = std::lock_guard{lock};
+    enabled = false;
+    events.clear();
+    events.shrink_to_fit();
+    next_event = 0;
+    wrapped = false;
+}
+
+bool IsBootTraceEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void BootTraceInstant(BootTraceCategory category, std::string_view name, pid_t pid) {
+    if (!IsBootTraceEnabled()) return;
+    Record(category, name, boot_clock::now().time_since_epoch().count(), -1, pid);
+}
+
+void BootTraceComplete(BootTraceCategory category, std::string_view name,
+                       boot_clock::time_point start, boot_clock::time_point end, pid_t pid) {
+    if (!IsBootTraceEnabled()) return;
+    Record(category, name, start.time_since_epoch().count(), (end - start).count(), pid);
+}
+
+Result<void> WriteBootTrace(const std::string& path) {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    {
+        auto guard = std::lock_guard{lock};
+        // Nothing is recorded while tracing is off, which writes an empty trace.
+        size_t count = events.empty() ? 0 : wrapped ? events.size() : next_event;
+        size_t first = wrapped ? next_event : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const auto& event = events[(first + i) % events.size()];
+            if (i != 0) json += ',';
+            json += "{\"name\":";
+            AppendJsonString(&json, event.name);
+            // Events from init itself go on one track, and those about a process on its own.
+            StringAppendF(&json, ",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                          CategoryName(event.category), event.pid ?: 1, event.start_ns / 1000.0);
+            if (event.duration_ns < 0) {
+                json += ",\"ph\":\"i\",\"s\":\"t\"}";
+            } else {
+                StringAppendF(&json, ",\"ph\":\"X\",\"dur\":%.3f}", event.duration_ns / 1000.0);
+            }
+        }
+    }
+    json += "]}\n";
+
+    if (!android::base::WriteStringToFile(json, path)) {
+        return ErrnoError() << "Could not write boot trace to '" << path << "'";
+    }
+    return {};
+}
+
+}  // namespace init
+}  // namespace android
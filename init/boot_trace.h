@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <string>
+#include <string_view>
+
+#include <android-base/chrono_utils.h>
+
+#include "result.h"
+
+namespace android {
+namespace init {
+
+// Records what init does during boot as timestamped events in a fixed size ring buffer, so that
+// boot time can be attributed to individual actions, commands, services and waits without the
+// overhead of sampling /proc.  Recording is off until StartBootTrace() is called, and every
+// recording function returns immediately while it is off, so callers should check
+// IsBootTraceEnabled() before doing any work to build an event name.
+
+enum class BootTraceCategory {
+    kAction,
+    kCommand,
+    kService,
+    kTrigger,
+    kWait,
+};
+
+void StartBootTrace(size_t capacity = 16384);
+bool IsBootTraceEnabled();
+
+// Records something that happened at a single point in time.
+void BootTraceInstant(BootTraceCategory category, std::string_view name, pid_t pid = 0);
+// Records something that ran from |start| to |end|.
+void BootTraceComplete(BootTraceCategory category, std::string_view name,
+                       android::base::boot_clock::time_point start,
+                       android::base::boot_clock::time_point end, pid_t pid = 0);
+
+// Writes the recorded events to |path| in the Chrome JSON trace format, which Perfetto and
+// chrome://tracing can open.
+Result<void> WriteBootTrace(const std::string& path);
+
+// Discards the recorded events, frees the buffer and stops recording.
+void StopBootTrace();
+
+}  // namespace init
+}  // namespace android
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "boot_trace.h"
+
+#include <android-base/file.h>
+#include <android-base/scopeguard.h>
+#include <android-base/strings.h>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using android::base::boot_clock;
+
+namespace android {
+namespace init {
+
+TEST(boot_trace, DisabledByDefault) {
+    StopBootTrace();
+    EXPECT_FALSE(IsBootTraceEnabled());
+    BootTraceInstant(BootTraceCategory::kTrigger, "boot");
+
+    TemporaryFile tf;
+    ASSERT_RESULT_OK(WriteBootTrace(tf.path));
+    std::string json;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &json));
+    EXPECT_EQ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n", json);
+}
+
+TEST(boot_trace, WritesChromeTraceEvents) {
+    StartBootTrace();
+    auto stop = android::base::make_scope_guard([] { StopBootTrace(); });
+
+    BootTraceInstant(BootTraceCategory::kTrigger, "sys.usb.config=\"adb\"");
+    auto start = boot_clock::time_point(10ms);
+    BootTraceComplete(BootTraceCategory::kService, "ueventd", start, start + 1500us, 42);
+
+    TemporaryFile tf;
+    ASSERT_RESULT_OK(WriteBootTrace(tf.path));
+    std::string json;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &json));
+
+    EXPECT_NE(std::string::npos,
+              json.find("{\"name\":\"sys.usb.config=\\\"adb\\\"\",\"cat\":\"trigger\",\"pid\":1,"
+                        "\"tid\":1,"))
+            << json;
+    EXPECT_NE(std::string::npos,
+              json.find("{\"name\":\"ueventd\",\"cat\":\"service\",\"pid\":1,\"tid\":42,"
+                        "\"ts\":10000.000,\"ph\":\"X\",\"dur\":1500.000}"))
+            << json;
+}
+
+TEST(boot_trace, KeepsNewestEvents) {
+    StartBootTrace(2);
+    auto stop = android::base::make_scope_guard([] { StopBootTrace(); });
+
+    BootTraceInstant(BootTraceCategory::kTrigger, "first");
+    BootTraceInstant(BootTraceCategory::kTrigger, "second");
+    BootTraceInstant(BootTraceCategory::kTrigger, "third");
+
+    TemporaryFile tf;
+    ASSERT_RESULT_OK(WriteBootTrace(tf.path));
+    std::string json;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &json));
+
+    EXPECT_EQ(std::string::npos, json.find("first"));
+    auto second = json.find("second");
+    auto third = json.find("third");
+    ASSERT_NE(std::string::npos, second);
+    ASSERT_NE(std::string::npos, third);
+    EXPECT_LT(second, third);
+}
+
+}  // namespace init
+}  // namespace android
@@ -26,17 +26,23 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <thread>
 
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include "boot_trace.h"
 
 using android::base::StringPrintf;
 using android::base::boot_clock;
@@ -50,6 +56,9 @@ static std::thread* g_bootcharting_thread;
 static std::mutex g_bootcharting_finished_mutex;
 static std::condition_variable g_bootcharting_finished_cv;
 static bool g_bootcharting_finished;
+static std::chrono::milliseconds g_bootcharting_period = 200ms;
+// Sampling /proc more often than this would mostly measure bootchart itself.
+static constexpr std::chrono::milliseconds kMinBootchartingPeriod = 10ms;
 
 static long long get_uptime_jiffies() {
     constexpr int64_t kNanosecondsPerJiffy = 10000000;
@@ -153,7 +162,7 @@ static void bootchart_thread_main() {
   while (true) {
     {
       std::unique_lock<std::mutex> lock(g_bootcharting_finished_mutex);
-      g_bootcharting_finished_cv.wait_for(lock, 200ms);
+      g_bootcharting_finished_cv.wait_for(lock, g_bootcharting_period);
       if (g_bootcharting_finished) break;
     }
 
@@ -166,18 +175,46 @@ static void bootchart_thread_main() {
 }
 
 static Result<void> do_bootchart_start() {
-    // We don't care about the content, but we do care that /data/bootchart/enabled actually exists.
+    // /data/bootchart/enabled must exist.  Its contents are ignored, other than an optional
+    // "period=<ms>" line setting how often /proc is sampled; "period=0" turns sampling off and
+    // only records init's own events into /data/bootchart/trace.json.
     std::string start;
     if (!android::base::ReadFileToString("/data/bootchart/enabled", &start)) {
         LOG(VERBOSE) << "Not bootcharting";
         return {};
     }
 
+    // The trace normally starts much earlier, from androidboot.init_trace=1, but if it didn't,
+    // this still records the rest of boot.
+    StartBootTrace();
+
+    for (const auto& line : android::base::Split(start, "\n")) {
+        std::string trimmed = android::base::Trim(line);
+        std::string_view value = trimmed;
+        if (!android::base::ConsumePrefix(&value, "period=")) continue;
+
+        unsigned int period_ms;
+        if (!android::base::ParseUint(std::string(value), &period_ms)) {
+            LOG(WARNING) << "bootchart: ignoring invalid period '" << value << "'";
+            continue;
+        }
+        if (period_ms == 0) return {};
+        g_bootcharting_period =
+                std::max(kMinBootchartingPeriod, std::chrono::milliseconds(period_ms));
+    }
+
     g_bootcharting_thread = new std::thread(bootchart_thread_main);
     return {};
 }
 
 static Result<void> do_bootchart_stop() {
+    if (IsBootTraceEnabled()) {
+        if (auto result = WriteBootTrace("/data/bootchart/trace.json"); !result.ok()) {
+            LOG(ERROR) << "bootchart: " << result.error();
+        }
+        StopBootTrace();
+    }
+
     if (!g_bootcharting_thread) return {};
 
     // Tell the worker thread it's time to quit.
@@ -24,6 +24,7 @@
 #include <chrono>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 
 #include <android-base/chrono_utils.h>
@@ -163,6 +164,86 @@ bool SysfsPermissions::MatchWithSubsystem(const std::string& path,
     return Match(path);
 }
 
+void PermissionsMatcher::Add(size_t index, const Permissions& rule) {
+    if (!rule.prefix_ && !rule.wildcard_) {
+        exact_rules_[rule.name_].emplace_back(index);
+        return;
+    }
+
+    // fnmatch() gives these characters a special meaning, so the literal part of a wildcard
+    // pattern ends at the first of them.
+    std::string_view literal = rule.name_;
+    if (rule.wildcard_) literal = literal.substr(0, literal.find_first_of("*?[\\"));
+
+    size_t node = 0;
+    for (char c : literal) {
+        auto it = nodes_[node].children.find(c);
+        if (it == nodes_[node].children.end()) {
+            nodes_.emplace_back();
+            it = nodes_[node].children.emplace(c, nodes_.size() - 1).first;
+        }
+        node = it->second;
+    }
+
+    if (rule.prefix_) {
+        nodes_[node].prefix_rules.emplace_back(index);
+    } else {
+        nodes_[node].wildcard_rules.emplace_back(index, rule.name_);
+    }
+}
+
+std::optional<size_t> PermissionsMatcher::FindLast(const std::string& path) const {
+    std::optional<size_t> result;
+    if (auto it = exact_rules_.find(path); it != exact_rules_.end()) {
+        result = it->second.back();
+    }
+
+    // Every node on the way down holds rules whose literal part is a prefix of |path|.
+    size_t node = 0;
+    for (size_t i = 0;; ++i) {
+        const auto& current = nodes_[node];
+        if (!current.prefix_rules.empty() && (!result || current.prefix_rules.back() > *result)) {
+            result = current.prefix_rules.back();
+        }
+        for (auto it = current.wildcard_rules.rbegin();
+             it != current.wildcard_rules.rend() && (!result || it->first > *result); ++it) {
+            if (fnmatch(it->second.c_str(), path.c_str(), FNM_PATHNAME) == 0) {
+                result = it->first;
+                break;
+            }
+        }
+
+        if (i == path.size()) break;
+        auto child = current.children.find(path[i]);
+        if (child == current.children.end()) break;
+        node = child->second;
+    }
+
+    return result;
+}
+
+void PermissionsMatcher::FindAll(const std::string& path, std::vector<size_t>* matches) const {
+    if (auto it = exact_rules_.find(path); it != exact_rules_.end()) {
+        matches->insert(matches->end(), it->second.begin(), it->second.end());
+    }
+
+    size_t node = 0;
+    for (size_t i = 0;; ++i) {
+        const auto& current = nodes_[node];
+        matches->insert(matches->end(), current.prefix_rules.begin(), current.prefix_rules.end());
+        for (const auto& [index, pattern] : current.wildcard_rules) {
+            if (fnmatch(pattern.c_str(), path.c_str(), FNM_PATHNAME) == 0) {
+                matches->emplace_back(index);
+            }
+        }
+
+        if (i == path.size()) break;
+        auto child = current.children.find(path[i]);
+        if (child == current.children.end()) break;
+        node = child->second;
+    }
+}
+
 void SysfsPermissions::SetPermissions(const std::string& path) const {
     std::string attribute_file = path + "/" + attribute_;
     LOG(VERBOSE) << "fixup " << attribute_file << " " << uid() << " " << gid() << " " << std::oct
@@ -216,7 +297,20 @@ void DeviceHandler::FixupSysPermissions(const std::string& upath,
     // contain, so we prepend it...
     std::string path = "/sys" + upath;
 
-    for (const auto& s : sysfs_permissions_) {
+    // MatchWithSubsystem() also tries the device's /sys/class and /sys/bus paths, so gather the
+    // rules that match any of the three, then check and apply them in their original order.
+    std::string path_basename = Basename(path);
+    std::vector<size_t> candidates;
+    sysfs_permissions_matcher_.FindAll(path, &candidates);
+    sysfs_permissions_matcher_.FindAll("/sys/class/" + subsystem + "/" + path_basename,
+                                       &candidates);
+    sysfs_permissions_matcher_.FindAll("/sys/bus/" + subsystem + "/devices/" + path_basename,
+                                       &candidates);
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (size_t i : candidates) {
+        const auto& s = sysfs_permissions_[i];
         if (s.MatchWithSubsystem(path, subsystem)) s.SetPermissions(path);
     }
 
@@ -230,12 +324,14 @@ void DeviceHandler::FixupSysPermissions(const std::string& upath,
 
 std::tuple<mode_t, uid_t, gid_t> DeviceHandler::GetDevicePermissions(
     const std::string& path, const std::vector<std::string>& links) const {
-    // Search the perms list in reverse so that ueventd.$hardware can override ueventd.rc.
-    for (auto it = dev_permissions_.crbegin(); it != dev_permissions_.crend(); ++it) {
-        if (it->Match(path) || std::any_of(links.cbegin(), links.cend(),
-                                           [it](const auto& link) { return it->Match(link); })) {
-            return {it->perm(), it->uid(), it->gid()};
-        }
+    // Use the last matching rule so that ueventd.$hardware can override ueventd.rc.
+    std::optional<size_t> last = dev_permissions_matcher_.FindLast(path);
+    for (const auto& link : links) {
+        last = std::max(last, dev_permissions_matcher_.FindLast(link));
+    }
+    if (last) {
+        const auto& permissions = dev_permissions_[*last];
+        return {permissions.perm(), permissions.uid(), permissions.gid()};
     }
     /* Default if nothing found. */
     return {0600, 0, 0};
@@ -518,6 +614,8 @@ DeviceHandler::DeviceHandler(std::vector<Permissions> dev_permissions,
                              bool skip_restorecon)
     : dev_permissions_(std::move(dev_permissions)),
       sysfs_permissions_(std::move(sysfs_permissions)),
+      dev_permissions_matcher_(dev_permissions_),
+      sysfs_permissions_matcher_(sysfs_permissions_),
       subsystems_(std::move(subsystems)),
       boot_devices_(std::move(boot_devices)),
       skip_restorecon_(skip_restorecon),
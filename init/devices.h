@@ -21,8 +21,11 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <map>
+#include <optional>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
@@ -36,6 +39,7 @@ namespace init {
 
 class Permissions {
   public:
+    friend class PermissionsMatcher;
     friend void TestPermissions(const Permissions& expected, const Permissions& test);
 
     Permissions(const std::string& name, mode_t perm, uid_t uid, gid_t gid);
@@ -73,6 +77,40 @@ class SysfsPermissions : public Permissions {
     const std::string attribute_;
 };
 
+// Finds the rules in a list of Permissions that match a path without calling Match() on every one
+// of them.  Exact names are looked up in a hash map.  Prefix and wildcard names are stored in a trie
+// keyed by their literal leading characters, so a lookup walks the path once and only calls
+// fnmatch() for wildcard rules whose literal part already matched.  Rules are identified by their
+// index in the list that the matcher was built from.
+class PermissionsMatcher {
+  public:
+    PermissionsMatcher() = default;
+    template <typename T>
+    explicit PermissionsMatcher(const std::vector<T>& rules) {
+        for (size_t i = 0; i < rules.size(); ++i) {
+            Add(i, rules[i]);
+        }
+    }
+
+    // Returns the index of the last rule that matches |path|, if any.
+    std::optional<size_t> FindLast(const std::string& path) const;
+    // Appends the indices of all rules that match |path| to |matches|, in no particular order.
+    void FindAll(const std::string& path, std::vector<size_t>* matches) const;
+
+  private:
+    struct Node {
+        std::map<char, size_t> children;
+        // Both sorted by rule index, as rules are added in order.
+        std::vector<size_t> prefix_rules;
+        std::vector<std::pair<size_t, std::string>> wildcard_rules;
+    };
+
+    void Add(size_t index, const Permissions& rule);
+
+    std::unordered_map<std::string, std::vector<size_t>> exact_rules_;
+    std::vector<Node> nodes_{1};
+};
+
 class Subsystem {
   public:
     friend class SubsystemParser;
@@ -134,6 +172,8 @@ class DeviceHandler : public UeventHandler {
 
     std::vector<Permissions> dev_permissions_;
     std::vector<SysfsPermissions> sysfs_permissions_;
+    PermissionsMatcher dev_permissions_matcher_;
+    PermissionsMatcher sysfs_permissions_matcher_;
     std::vector<Subsystem> subsystems_;
     std::set<std::string> boot_devices_;
     bool skip_restorecon_;
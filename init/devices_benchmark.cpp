@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "devices.h"
+
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+using android::base::StringPrintf;
+
+namespace android {
+namespace init {
+
+// Models a large vendor ueventd.rc: a mix of exact, prefix and wildcard rules, looked up with paths
+// of which most only match a catch-all rule near the front.
+static std::vector<Permissions> MakeRules(int rule_count) {
+    std::vector<Permissions> rules;
+    rules.emplace_back("/dev/*", 0600, 0, 0);
+    for (int i = 0; i < rule_count; ++i) {
+        switch (i % 3) {
+            case 0:
+                rules.emplace_back(StringPrintf("/dev/vendor%d", i), 0660, 0, 1000);
+                break;
+            case 1:
+                rules.emplace_back(StringPrintf("/dev/vendor%d/*", i), 0660, 0, 1000);
+                break;
+            case 2:
+                rules.emplace_back(StringPrintf("/dev/vendor%d_*_node", i), 0660, 0, 1000);
+                break;
+        }
+    }
+    return rules;
+}
+
+static std::vector<std::string> MakePaths(int rule_count) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 100; ++i) {
+        paths.emplace_back(i % 10 == 0 ? StringPrintf("/dev/vendor%d_x_node", i * rule_count / 100)
+                                       : StringPrintf("/dev/block/sda%d", i));
+    }
+    return paths;
+}
+
+static void BenchmarkLinearPermissionsMatch(benchmark::State& state) {
+    auto rules = MakeRules(state.range(0));
+    auto paths = MakePaths(state.range(0));
+
+    for (auto _ : state) {
+        for (const auto& path : paths) {
+            auto it = std::find_if(rules.crbegin(), rules.crend(),
+                                   [&path](const auto& rule) { return rule.Match(path); });
+            benchmark::DoNotOptimize(it);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * paths.size());
+}
+
+BENCHMARK(BenchmarkLinearPermissionsMatch)->Arg(30)->Arg(300)->Arg(3000);
+
+static void BenchmarkPermissionsMatcher(benchmark::State& state) {
+    auto rules = MakeRules(state.range(0));
+    auto paths = MakePaths(state.range(0));
+    PermissionsMatcher matcher(rules);
+
+    for (auto _ : state) {
+        for (const auto& path : paths) {
+            benchmark::DoNotOptimize(matcher.FindLast(path));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * paths.size());
+}
+
+BENCHMARK(BenchmarkPermissionsMatcher)->Arg(30)->Arg(300)->Arg(3000);
+
+}  // namespace init
+}  // namespace android
@@ -309,5 +309,72 @@ TEST(device_handler, SysfsPermissionsMatchWithSubsystemBus) {
     EXPECT_EQ(1001U, permissions.gid());
 }
 
+TEST(device_handler, PermissionsMatcherMatchesLinearSearch) {
+    std::vector<SysfsPermissions> rules = {
+            {"/dev/null", "", 0666, 0, 0},
+            {"/dev/dri/*", "", 0666, 0, 1000},
+            {"/dev/device*name", "", 0666, 0, 1000},
+            {"/dev/device*name*", "", 0666, 0, 1000},
+            {"/dev/dri/card0", "", 0660, 0, 1000},
+            {"/dev/*", "", 0600, 0, 0},
+            {"/dev/block/sd?", "", 0640, 0, 1000},
+            {"/dev/block/[hs]d*", "", 0640, 0, 1000},
+            {"/dev/null", "", 0600, 0, 0},
+            {"/sys/devices/virtual/input/input*", "enable", 0660, 0, 1001},
+            {"/sys/class/input/event*", "enable", 0660, 0, 1001},
+            {"/sys/bus/i2c/devices/i2c-*", "enable", 0660, 0, 1001},
+            {"/dev/dri/*", "", 0644, 0, 1000},
+            {"*", "", 0600, 0, 0},
+            {"/dev/tty*", "", 0620, 0, 1000},
+            {"/dev/tty", "", 0666, 0, 0},
+    };
+    std::vector<std::string> paths = {
+            "/dev/null",
+            "/dev/nullsuffix",
+            "/dev/nul",
+            "/dev/dri/card0",
+            "/dev/dri/",
+            "/dev/dr/non_match",
+            "/dev/devicename",
+            "/dev/device123name",
+            "/dev/device123namesomething",
+            "/dev/device123name/something",
+            "/dev/block/sda",
+            "/dev/block/sdaa",
+            "/dev/block/hda1",
+            "/dev/block/vda",
+            "/dev/tty",
+            "/dev/tty0",
+            "/sys/devices/virtual/input/input0",
+            "/sys/class/input/event0",
+            "/sys/bus/i2c/devices/i2c-5",
+            "/sys/bus/i2c/devices/not-i2c",
+            "",
+            "/",
+            "/something/else",
+    };
+
+    for (size_t num_rules = 0; num_rules <= rules.size(); ++num_rules) {
+        std::vector<SysfsPermissions> prefix(rules.begin(), rules.begin() + num_rules);
+        PermissionsMatcher matcher(prefix);
+        for (const auto& path : paths) {
+            std::vector<size_t> expected;
+            for (size_t i = 0; i < prefix.size(); ++i) {
+                if (prefix[i].Match(path)) expected.emplace_back(i);
+            }
+
+            std::vector<size_t> all;
+            matcher.FindAll(path, &all);
+            std::sort(all.begin(), all.end());
+            EXPECT_EQ(expected, all) << num_rules << " rules, path " << path;
+
+            std::optional<size_t> expected_last;
+            if (!expected.empty()) expected_last = expected.back();
+            EXPECT_EQ(expected_last, matcher.FindLast(path))
+                    << num_rules << " rules, path " << path;
+        }
+    }
+}
+
 }  // namespace init
 }  // namespace android
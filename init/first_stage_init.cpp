@@ -29,6 +29,7 @@
 
 #include <filesystem>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -98,6 +99,10 @@ bool ForceNormalBoot(const std::string& cmdline) {
     return cmdline.find("androidboot.force_normal_boot=1") != std::string::npos;
 }
 
+bool LoadModulesInParallel(const std::string& cmdline) {
+    return cmdline.find("androidboot.load_modules_parallel=true") != std::string::npos;
+}
+
 }  // namespace
 
 std::string GetModuleLoadList(bool recovery, const std::string& dir_path) {
@@ -114,7 +119,7 @@ std::string GetModuleLoadList(bool recovery, const std::string& dir_path) {
 }
 
 #define MODULE_BASE_DIR "/lib/modules"
-bool LoadKernelModules(bool recovery, bool want_console) {
+bool LoadKernelModules(bool recovery, bool want_console, bool want_parallel) {
     struct utsname uts;
     if (uname(&uts)) {
         LOG(FATAL) << "Failed to get kernel version.";
@@ -151,11 +156,18 @@ bool LoadKernelModules(bool recovery, bool want_console) {
     // /lib/modules/5.4-gki.
     std::sort(module_dirs.begin(), module_dirs.end());
 
+    auto load_modules = [want_console, want_parallel](Modprobe& m) {
+        if (want_parallel) {
+            return m.LoadModulesParallel(std::thread::hardware_concurrency() ?: 4, !want_console);
+        }
+        return m.LoadListedModules(!want_console);
+    };
+
     for (const auto& module_dir : module_dirs) {
         std::string dir_path = MODULE_BASE_DIR "/";
         dir_path.append(module_dir);
         Modprobe m({dir_path}, GetModuleLoadList(recovery, dir_path));
-        bool retval = m.LoadListedModules(!want_console);
+        bool retval = load_modules(m);
         int modules_loaded = m.GetModuleCount();
         if (modules_loaded > 0) {
             return retval;
@@ -163,7 +175,7 @@ bool LoadKernelModules(bool recovery, bool want_console) {
     }
 
     Modprobe m({MODULE_BASE_DIR}, GetModuleLoadList(recovery, MODULE_BASE_DIR));
-    bool retval = m.LoadListedModules(!want_console);
+    bool retval = load_modules(m);
     int modules_loaded = m.GetModuleCount();
     if (modules_loaded > 0) {
         return retval;
@@ -264,7 +276,8 @@ int FirstStageMain(int argc, char** argv) {
 
     auto want_console = ALLOW_FIRST_STAGE_CONSOLE ? FirstStageConsole(cmdline) : 0;
 
-    if (!LoadKernelModules(IsRecoveryMode() && !ForceNormalBoot(cmdline), want_console)) {
+    if (!LoadKernelModules(IsRecoveryMode() && !ForceNormalBoot(cmdline), want_console,
+                           LoadModulesInParallel(cmdline))) {
         if (want_console != FirstStageConsoleParam::DISABLED) {
             LOG(ERROR) << "Failed to load kernel modules, starting console";
         } else {
@@ -56,6 +56,7 @@
 #include <selinux/android.h>
 
 #include "action_parser.h"
+#include "boot_trace.h"
 #include "builtins.h"
 #include "epoll.h"
 #include "first_stage_init.h"
@@ -74,6 +75,7 @@
 #include "selinux.h"
 #include "service.h"
 #include "service_parser.h"
+#include "service_spawner.h"
 #include "sigchld_handler.h"
 #include "subcontext.h"
 #include "system/core/init/property_service.pb.h"
@@ -166,6 +168,7 @@ static class PropWaiterState {
         // If we aren't waiting on this property, it means that ueventd finished before we even
         // started to wait.
         if (name == kColdBootDoneProp) {
+            BootTraceInstant(BootTraceCategory::kWait, "coldboot done");
             auto time_waited = waiting_for_prop_ ? waiting_for_prop_->duration().count() : 0;
             std::thread([time_waited] {
                 SetProperty("ro.boottime.init.cold_boot_wait", std::to_string(time_waited));
@@ -176,6 +179,12 @@ static class PropWaiterState {
             if (wait_prop_name_ == name && wait_prop_value_ == value) {
                 LOG(INFO) << "Wait for property '" << wait_prop_name_ << "=" << wait_prop_value_
                           << "' took " << *waiting_for_prop_;
+                if (IsBootTraceEnabled()) {
+                    auto now = boot_clock::now();
+                    BootTraceComplete(BootTraceCategory::kWait,
+                                      "property " + wait_prop_name_ + "=" + wait_prop_value_,
+                                      now - waiting_for_prop_->duration(), now);
+                }
                 ResetWaitForPropLocked();
                 WakeMainInitThread();
             }
@@ -274,6 +283,10 @@ static void LoadBootScripts(ActionManager& action_manager, ServiceList& service_
 
     std::string bootscript = GetProperty("ro.boot.init_rc", "");
     if (bootscript.empty()) {
+        // Read and tokenize everything up front so that the I/O overlaps with parsing.
+        parser.PrefetchConfigs({"/system/etc/init/hw/init.rc", "/system/etc/init",
+                                "/system_ext/etc/init", "/product/etc/init", "/odm/etc/init",
+                                "/vendor/etc/init"});
         parser.ParseConfig("/system/etc/init/hw/init.rc");
         if (!parser.ParseConfig("/system/etc/init")) {
             late_import_paths.emplace_back("/system/etc/init");
@@ -741,6 +754,10 @@ int SecondStageMain(int argc, char** argv) {
 
     PropertyInit();
 
+    if (android::base::GetBoolProperty("ro.boot.init_trace", false)) {
+        StartBootTrace();
+    }
+
     // Umount the debug ramdisk after property service has read the .prop files when it means to.
     if (load_debug_prop) {
         UmountDebugRamdisk();
@@ -784,7 +801,10 @@ int SecondStageMain(int argc, char** argv) {
         PLOG(FATAL) << "SetupMountNamespaces failed";
     }
 
-    InitializeSubcontext();
+    InitializeSubcontext(&epoll);
+    // The service spawner is a new copy of init, so it stays small while init parses the boot
+    // scripts.
+    InitializeServiceSpawner();
 
     ActionManager& am = ActionManager::GetInstance();
     ServiceList& sm = ServiceList::GetInstance();
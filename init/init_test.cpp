@@ -31,6 +31,7 @@
 #include "service.h"
 #include "service_list.h"
 #include "service_parser.h"
+#include "service_spawner.h"
 #include "util.h"
 
 using android::base::GetIntProperty;
@@ -157,6 +158,61 @@ execute_third
     TestInitText(init_script, test_function_map, commands, &service_list);
 }
 
+TEST(init, PropertyTriggerOrder) {
+    std::string init_script =
+        R"init(
+on property:test.init.prop=1
+execute_first
+
+on property:test.init.other=1
+execute_never
+
+on property:test.init.prop=*
+execute_second
+
+on property:test.init.prop=2
+execute_never
+
+on property:test.init.prop=1
+execute_third
+
+)init";
+
+    int num_executed = 0;
+    auto do_execute_first = [&num_executed](const BuiltinArguments&) {
+        EXPECT_EQ(0, num_executed++);
+        return Result<void>{};
+    };
+    auto do_execute_second = [&num_executed](const BuiltinArguments&) {
+        EXPECT_EQ(1, num_executed++);
+        return Result<void>{};
+    };
+    auto do_execute_third = [&num_executed](const BuiltinArguments&) {
+        EXPECT_EQ(2, num_executed++);
+        return Result<void>{};
+    };
+    auto do_execute_never = [](const BuiltinArguments&) {
+        ADD_FAILURE();
+        return Result<void>{};
+    };
+
+    BuiltinFunctionMap test_function_map = {
+            {"execute_first", {0, 0, {false, do_execute_first}}},
+            {"execute_second", {0, 0, {false, do_execute_second}}},
+            {"execute_third", {0, 0, {false, do_execute_third}}},
+            {"execute_never", {0, 0, {false, do_execute_never}}},
+    };
+
+    ActionManagerCommand property_change = [](ActionManager& am) {
+        am.QueuePropertyChange("test.init.prop", "1");
+    };
+    std::vector<ActionManagerCommand> commands{property_change};
+
+    ServiceList service_list;
+    TestInitText(init_script, test_function_map, commands, &service_list);
+    EXPECT_EQ(3, num_executed);
+}
+
 TEST(init, OverrideService) {
     std::string init_script = R"init(
 service A something
@@ -242,6 +298,45 @@ TEST(init, EventTriggerOrderMultipleFiles) {
     EXPECT_EQ(6, num_executed);
 }
 
+TEST(init, PrefetchConfigs) {
+    TemporaryFile import;
+    ASSERT_TRUE(import.fd != -1);
+    ASSERT_TRUE(android::base::WriteStringToFd("on boot\nexecute 2", import.fd));
+
+    TemporaryDir dir;
+    ASSERT_RESULT_OK(WriteFile(std::string(dir.path) + "/a.rc",
+                               "import " + std::string(import.path) + "\non boot\nexecute 1"));
+    ASSERT_RESULT_OK(WriteFile(std::string(dir.path) + "/b.rc", "on boot\nexecute 3"));
+    std::string missing = std::string(dir.path) + ".missing";
+
+    int num_executed = 0;
+    auto execute_command = [&num_executed](const BuiltinArguments& args) {
+        EXPECT_EQ(++num_executed, std::stoi(args[1]));
+        return Result<void>{};
+    };
+    BuiltinFunctionMap test_function_map = {
+            {"execute", {1, 1, {false, execute_command}}},
+    };
+    Action::set_function_map(&test_function_map);
+
+    ActionManager am;
+    Parser parser;
+    parser.AddSectionParser("on", std::make_unique<ActionParser>(&am, nullptr));
+    parser.AddSectionParser("import", std::make_unique<ImportParser>(&parser));
+
+    // Prefetched files, including imported ones, must still be applied in the usual order.
+    parser.PrefetchConfigs({dir.path, import.path, missing});
+    ASSERT_TRUE(parser.ParseConfig(dir.path));
+    EXPECT_FALSE(parser.ParseConfig(missing));
+    EXPECT_EQ(0u, parser.parse_error_count());
+
+    am.QueueEventTrigger("boot");
+    while (am.HasMoreCommands()) {
+        am.ExecuteOneCommand();
+    }
+    EXPECT_EQ(3, num_executed);
+}
+
 TEST(init, RejectsCriticalAndOneshotService) {
     if (GetIntProperty("ro.product.first_api_level", 10000) < 30) {
         GTEST_SKIP() << "Test only valid for devices launching with R or later";
@@ -283,6 +378,10 @@ int main(int argc, char** argv) {
         return FirmwareTestChildMain(argc, argv);
     }
 
+    if (argc > 1 && !strcmp(argv[1], "service_spawner")) {
+        return android::init::ServiceSpawnerMain(argc, argv);
+    }
+
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
@@ -18,6 +18,7 @@
 #include "first_stage_init.h"
 #include "init.h"
 #include "selinux.h"
+#include "service_spawner.h"
 #include "subcontext.h"
 #include "ueventd.h"
 
@@ -65,6 +66,11 @@ int main(int argc, char** argv) {
             return SubcontextMain(argc, argv, &function_map);
         }
 
+        if (!strcmp(argv[1], "service_spawner")) {
+            android::base::InitLogging(argv, &android::base::KernelLogger);
+            return ServiceSpawnerMain(argc, argv);
+        }
+
         if (!strcmp(argv[1], "selinux_setup")) {
             return SetupSelinux(argv);
         }
@@ -18,6 +18,11 @@
 
 #include <dirent.h>
 
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -40,7 +45,7 @@ void Parser::AddSingleLineParser(const std::string& prefix, LineCallback callbac
     line_callbacks_.emplace_back(prefix, std::move(callback));
 }
 
-void Parser::ParseData(const std::string& filename, std::string* data) {
+auto Parser::Tokenize(std::string* data) -> std::vector<TokenizedLine> {
     data->push_back('\n');  // TODO: fix tokenizer
     data->push_back('\0');
 
@@ -49,9 +54,34 @@ void Parser::ParseData(const std::string& filename, std::string* data) {
     state.ptr = data->data();
     state.nexttoken = 0;
 
+    std::vector<TokenizedLine> lines;
+    std::vector<std::string> args;
+    for (;;) {
+        switch (next_token(&state)) {
+            case T_EOF:
+                return lines;
+            case T_NEWLINE:
+                state.line++;
+                if (!args.empty()) {
+                    lines.push_back({state.line, std::move(args)});
+                    args.clear();
+                }
+                break;
+            case T_TEXT:
+                args.emplace_back(state.text);
+                break;
+        }
+    }
+}
+
+void Parser::ParseData(const std::string& filename, std::string* data) {
+    auto lines = Tokenize(data);
+    ParseTokens(filename, &lines);
+}
+
+void Parser::ParseTokens(const std::string& filename, std::vector<TokenizedLine>* lines) {
     SectionParser* section_parser = nullptr;
     int section_start_line = -1;
-    std::vector<std::string> args;
 
     // If we encounter a bad section start, there is no valid parser object to parse the subsequent
     // sections, so we must suppress errors until the next valid section is found.
@@ -70,63 +100,48 @@ void Parser::ParseData(const std::string& filename, std::string* data) {
         section_start_line = -1;
     };
 
-    for (;;) {
-        switch (next_token(&state)) {
-            case T_EOF:
-                end_section();
+    for (auto& [line, args] : *lines) {
+        // If we have a line matching a prefix we recognize, call its callback and unset any
+        // current section parsers.  This is meant for /sys/ and /dev/ line entries for
+        // uevent.
+        auto line_callback = std::find_if(
+            line_callbacks_.begin(), line_callbacks_.end(),
+            [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
+        if (line_callback != line_callbacks_.end()) {
+            end_section();
 
-                for (const auto& [section_name, section_parser] : section_parsers_) {
-                    section_parser->EndFile();
-                }
-
-                return;
-            case T_NEWLINE: {
-                state.line++;
-                if (args.empty()) break;
-                // If we have a line matching a prefix we recognize, call its callback and unset any
-                // current section parsers.  This is meant for /sys/ and /dev/ line entries for
-                // uevent.
-                auto line_callback = std::find_if(
-                    line_callbacks_.begin(), line_callbacks_.end(),
-                    [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
-                if (line_callback != line_callbacks_.end()) {
-                    end_section();
-
-                    if (auto result = line_callback->second(std::move(args)); !result.ok()) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (section_parsers_.count(args[0])) {
-                    end_section();
-                    section_parser = section_parsers_[args[0]].get();
-                    section_start_line = state.line;
-                    if (auto result =
-                                section_parser->ParseSection(std::move(args), filename, state.line);
-                        !result.ok()) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                        section_parser = nullptr;
-                        bad_section_found = true;
-                    }
-                } else if (section_parser) {
-                    if (auto result = section_parser->ParseLineSection(std::move(args), state.line);
-                        !result.ok()) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (!bad_section_found) {
-                    parse_error_count_++;
-                    LOG(ERROR) << filename << ": " << state.line
-                               << ": Invalid section keyword found";
-                }
-                args.clear();
-                break;
+            if (auto result = line_callback->second(std::move(args)); !result.ok()) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
             }
-            case T_TEXT:
-                args.emplace_back(state.text);
-                break;
+        } else if (section_parsers_.count(args[0])) {
+            end_section();
+            section_parser = section_parsers_[args[0]].get();
+            section_start_line = line;
+            if (auto result = section_parser->ParseSection(std::move(args), filename, line);
+                !result.ok()) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+                section_parser = nullptr;
+                bad_section_found = true;
+            }
+        } else if (section_parser) {
+            if (auto result = section_parser->ParseLineSection(std::move(args), line);
+                !result.ok()) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+            }
+        } else if (!bad_section_found) {
+            parse_error_count_++;
+            LOG(ERROR) << filename << ": " << line << ": Invalid section keyword found";
         }
     }
+
+    end_section();
+
+    for (const auto& [section_name, section_parser] : section_parsers_) {
+        section_parser->EndFile();
+    }
 }
 
 bool Parser::ParseConfigFileInsecure(const std::string& path) {
@@ -139,27 +154,47 @@ bool Parser::ParseConfigFileInsecure(const std::string& path) {
     return true;
 }
 
+auto Parser::ReadConfigFile(const std::string& path) -> TokenizedConfig {
+    TokenizedConfig config;
+    auto config_contents = ReadFile(path);
+    if (!config_contents.ok()) {
+        config.error = config_contents.error().message();
+        return config;
+    }
+
+    config.ok = true;
+    config.lines = Tokenize(&config_contents.value());
+    return config;
+}
+
 bool Parser::ParseConfigFile(const std::string& path) {
     LOG(INFO) << "Parsing file " << path << "...";
     android::base::Timer t;
-    auto config_contents = ReadFile(path);
-    if (!config_contents.ok()) {
-        LOG(INFO) << "Unable to read config file '" << path << "': " << config_contents.error();
+    TokenizedConfig config;
+    if (auto it = prefetched_configs_.find(path); it != prefetched_configs_.end()) {
+        // get() moves the tokens out, so a later parse of the same file reads it again.
+        config = it->second.get();
+        prefetched_configs_.erase(it);
+    } else {
+        config = ReadConfigFile(path);
+    }
+    if (!config.ok) {
+        LOG(INFO) << "Unable to read config file '" << path << "': " << config.error;
         return false;
     }
 
-    ParseData(path, &config_contents.value());
+    ParseTokens(path, &config.lines);
 
     LOG(VERBOSE) << "(Parsing " << path << " took " << t << ".)";
     return true;
 }
 
-bool Parser::ParseConfigDir(const std::string& path) {
-    LOG(INFO) << "Parsing directory " << path << "...";
+// Returns the regular files in |path|, sorted so that they're loaded in a consistent order (bug
+// 31996208), or std::nullopt if the directory can't be opened.
+static std::optional<std::vector<std::string>> ListConfigDir(const std::string& path) {
     std::unique_ptr<DIR, decltype(&closedir)> config_dir(opendir(path.c_str()), closedir);
     if (!config_dir) {
-        PLOG(INFO) << "Could not import directory '" << path << "'";
-        return false;
+        return std::nullopt;
     }
     dirent* current_file;
     std::vector<std::string> files;
@@ -171,9 +206,53 @@ bool Parser::ParseConfigDir(const std::string& path) {
             files.emplace_back(current_path);
         }
     }
-    // Sort first so we load files in a consistent order (bug 31996208)
     std::sort(files.begin(), files.end());
-    for (const auto& file : files) {
+    return files;
+}
+
+void Parser::PrefetchConfigs(const std::vector<std::string>& paths) {
+    constexpr unsigned int kMaxPrefetchThreads = 4;
+
+    struct PrefetchState {
+        std::vector<std::string> files;
+        std::vector<std::promise<TokenizedConfig>> promises;
+        std::atomic<size_t> next = 0;
+    };
+    auto state = std::make_shared<PrefetchState>();
+
+    for (const auto& path : paths) {
+        if (!is_dir(path.c_str())) {
+            state->files.emplace_back(path);
+        } else if (auto files = ListConfigDir(path)) {
+            state->files.insert(state->files.end(), files->begin(), files->end());
+        }
+    }
+
+    state->promises.resize(state->files.size());
+    for (size_t i = 0; i < state->files.size(); ++i) {
+        prefetched_configs_.emplace(state->files[i], state->promises[i].get_future());
+    }
+
+    // The threads own the shared state, so they may outlive this parser.
+    unsigned int threads = std::clamp(std::thread::hardware_concurrency(), 1u, kMaxPrefetchThreads);
+    threads = std::min<size_t>(threads, state->files.size());
+    for (unsigned int i = 0; i < threads; ++i) {
+        std::thread([state] {
+            for (size_t i; (i = state->next++) < state->files.size();) {
+                state->promises[i].set_value(ReadConfigFile(state->files[i]));
+            }
+        }).detach();
+    }
+}
+
+bool Parser::ParseConfigDir(const std::string& path) {
+    LOG(INFO) << "Parsing directory " << path << "...";
+    auto files = ListConfigDir(path);
+    if (!files) {
+        PLOG(INFO) << "Could not import directory '" << path << "'";
+        return false;
+    }
+    for (const auto& file : *files) {
         if (!ParseConfigFile(file)) {
             LOG(ERROR) << "could not import file '" << file << "'";
         }
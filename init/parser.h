@@ -17,6 +17,7 @@
 #ifndef _INIT_PARSER_H_
 #define _INIT_PARSER_H_
 
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
@@ -79,12 +80,32 @@ class Parser {
     // Host init verifier check file permissions.
     bool ParseConfigFileInsecure(const std::string& path);
 
+    // Reads and tokenizes the config files at |paths| (files or directories) on background threads.
+    // Later ParseConfig() calls for those files only have to apply the tokens, which still happens
+    // in the usual order on the calling thread.
+    void PrefetchConfigs(const std::vector<std::string>& paths);
+
     size_t parse_error_count() const { return parse_error_count_; }
 
   private:
+    struct TokenizedLine {
+        int line;
+        std::vector<std::string> args;
+    };
+
+    struct TokenizedConfig {
+        bool ok = false;
+        std::string error;
+        std::vector<TokenizedLine> lines;
+    };
+
+    static std::vector<TokenizedLine> Tokenize(std::string* data);
+    static TokenizedConfig ReadConfigFile(const std::string& path);
     void ParseData(const std::string& filename, std::string* data);
+    void ParseTokens(const std::string& filename, std::vector<TokenizedLine>* lines);
     bool ParseConfigDir(const std::string& path);
 
+    std::map<std::string, std::future<TokenizedConfig>> prefetched_configs_;
     std::map<std::string, std::unique_ptr<SectionParser>> section_parsers_;
     std::vector<std::pair<std::string, LineCallback>> line_callbacks_;
     size_t parse_error_count_ = 0;
@@ -18,11 +18,13 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/system_properties.h>
 #include <sys/types.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -36,6 +38,7 @@ using android::base::ReadFdToString;
 using android::base::StartsWith;
 using android::base::unique_fd;
 using android::base::WriteStringToFd;
+using namespace std::chrono_literals;
 
 namespace android {
 namespace init {
@@ -46,6 +49,47 @@ namespace {
 
 constexpr const char kLegacyPersistentPropertyDir[] = "/data/property";
 
+// The journal is compacted into the property file once it grows past this size.
+constexpr size_t kMaxJournalSize = 64 * 1024;
+
+// Journal appends are fsync()'ed at most this long after they're written, so that a burst of
+// updates costs a single fsync().
+constexpr auto kJournalSyncDelay = 50ms;
+
+// Each journal record is a header followed by a serialized PersistentProperties holding a single
+// property. A record whose checksum doesn't match was torn by a crash, and it and anything after it
+// are ignored.
+struct JournalRecordHeader {
+    uint32_t length;
+    uint32_t checksum;
+};
+
+struct Journal {
+    // The property file that this journal belongs to. Empty until the property file has been
+    // verified to be readable, which happens on the first write.
+    std::string filename;
+    unique_fd fd;
+    size_t size = 0;
+    // Set when the journal file was created, so that its directory entry is synced too.
+    bool sync_directory = false;
+    std::optional<std::chrono::steady_clock::time_point> sync_deadline;
+};
+
+Journal journal;
+
+std::string JournalFilename() {
+    return persistent_property_filename + ".journal";
+}
+
+uint32_t JournalChecksum(const std::string& data) {
+    // FNV-1a; this only needs to catch torn writes.
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
 void AddPersistentProperty(const std::string& name, const std::string& value,
                            PersistentProperties* persistent_properties) {
     auto persistent_property_record = persistent_properties->add_properties();
@@ -140,6 +184,96 @@ PersistentProperties LoadPersistentPropertiesFromMemory() {
     return persistent_properties;
 }
 
+// Applies the updates recorded in the journal, in order, on top of |persistent_properties|.
+void ApplyJournal(PersistentProperties* persistent_properties) {
+    std::string contents;
+    if (!android::base::ReadFileToString(JournalFilename(), &contents)) {
+        return;
+    }
+
+    std::unordered_map<std::string, PersistentProperties::PersistentPropertyRecord*> records;
+    for (auto& record : *persistent_properties->mutable_properties()) {
+        records.emplace(record.name(), &record);
+    }
+
+    size_t offset = 0;
+    while (offset + sizeof(JournalRecordHeader) <= contents.size()) {
+        JournalRecordHeader header;
+        memcpy(&header, contents.data() + offset, sizeof(header));
+        size_t data_offset = offset + sizeof(header);
+        if (header.length > contents.size() - data_offset) {
+            break;
+        }
+
+        std::string data = contents.substr(data_offset, header.length);
+        PersistentProperties update;
+        if (JournalChecksum(data) != header.checksum || !update.ParseFromString(data)) {
+            break;
+        }
+        offset = data_offset + header.length;
+
+        for (const auto& record : update.properties()) {
+            if (auto it = records.find(record.name()); it != records.end()) {
+                it->second->set_value(record.value());
+            } else {
+                AddPersistentProperty(record.name(), record.value(), persistent_properties);
+                records.emplace(record.name(), persistent_properties->mutable_properties(
+                                                       persistent_properties->properties_size() - 1));
+            }
+        }
+    }
+
+    if (offset != contents.size()) {
+        LOG(WARNING) << "Ignoring " << contents.size() - offset
+                     << " bytes of torn persistent property journal";
+    }
+}
+
+// Called once the property file reflects everything in the journal.
+void ResetJournal() {
+    journal.fd.reset();
+    journal.size = 0;
+    journal.sync_deadline.reset();
+    unlink(JournalFilename().c_str());
+}
+
+Result<void> AppendJournalRecord(const std::string& name, const std::string& value) {
+    if (journal.fd == -1) {
+        journal.fd.reset(TEMP_FAILURE_RETRY(
+                open(JournalFilename().c_str(),
+                     O_WRONLY | O_CREAT | O_APPEND | O_NOFOLLOW | O_CLOEXEC, 0600)));
+        if (journal.fd == -1) {
+            return ErrnoError() << "Could not open persistent property journal";
+        }
+        struct stat sb;
+        if (fstat(journal.fd, &sb) == -1) {
+            return ErrnoError() << "fstat on persistent property journal failed";
+        }
+        journal.size = sb.st_size;
+        journal.sync_directory = journal.size == 0;
+    }
+
+    PersistentProperties update;
+    AddPersistentProperty(name, value, &update);
+    std::string data;
+    if (!update.SerializeToString(&data)) {
+        return Error() << "Unable to serialize property";
+    }
+
+    JournalRecordHeader header = {static_cast<uint32_t>(data.size()), JournalChecksum(data)};
+    std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record += data;
+    if (!WriteStringToFd(record, journal.fd)) {
+        return ErrnoError() << "Unable to append to persistent property journal";
+    }
+
+    journal.size += record.size();
+    if (!journal.sync_deadline) {
+        journal.sync_deadline = std::chrono::steady_clock::now() + kJournalSyncDelay;
+    }
+    return {};
+}
+
 Result<std::string> ReadPersistentPropertyFile() {
     const std::string temp_filename = persistent_property_filename + ".tmp";
     if (access(temp_filename.c_str(), F_OK) == 0) {
@@ -162,7 +296,10 @@ Result<PersistentProperties> LoadPersistentPropertyFile() {
     if (!file_contents.ok()) return file_contents.error();
 
     PersistentProperties persistent_properties;
-    if (persistent_properties.ParseFromString(*file_contents)) return persistent_properties;
+    if (persistent_properties.ParseFromString(*file_contents)) {
+        ApplyJournal(&persistent_properties);
+        return persistent_properties;
+    }
 
     // If the file cannot be parsed in either format, then we don't have any recovery
     // mechanisms, so we delete it to allow for future writes to take place successfully.
@@ -204,12 +341,35 @@ Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_
     }
     fsync(dir_fd);
 
+    ResetJournal();
     return {};
 }
 
-// Persistent properties are not written often, so we rather not keep any data in memory and read
-// then rewrite the persistent property file for each update.
+// The first update rewrites the whole property file, which also recovers it from memory if it's
+// unreadable. Later updates are appended to the journal, which is compacted back into the property
+// file once it grows too large.
 void WritePersistentProperty(const std::string& name, const std::string& value) {
+    if (journal.filename == persistent_property_filename) {
+        auto result = AppendJournalRecord(name, value);
+        if (result.ok()) {
+            if (journal.size < kMaxJournalSize) {
+                return;
+            }
+            auto persistent_properties = LoadPersistentPropertyFile();
+            if (persistent_properties.ok()) {
+                result = WritePersistentPropertyFile(*persistent_properties);
+            } else {
+                result = persistent_properties.error();
+            }
+            if (result.ok()) {
+                return;
+            }
+        }
+        LOG(ERROR) << "Could not update persistent property journal: " << result.error();
+        // Fall back to rewriting the property file.
+    }
+
+    journal = {};
     auto persistent_properties = LoadPersistentPropertyFile();
 
     if (!persistent_properties.ok()) {
@@ -229,6 +389,37 @@ void WritePersistentProperty(const std::string& name, const std::string& value)
 
     if (auto result = WritePersistentPropertyFile(*persistent_properties); !result.ok()) {
         LOG(ERROR) << "Could not store persistent property: " << result.error();
+        return;
+    }
+    journal.filename = persistent_property_filename;
+}
+
+std::optional<std::chrono::milliseconds> PersistentPropertySyncTimeout() {
+    if (!journal.sync_deadline) {
+        return std::nullopt;
+    }
+    auto time_left = std::chrono::ceil<std::chrono::milliseconds>(
+            *journal.sync_deadline - std::chrono::steady_clock::now());
+    return std::max(time_left, 0ms);
+}
+
+void SyncPersistentProperties() {
+    if (!journal.sync_deadline) {
+        return;
+    }
+    journal.sync_deadline.reset();
+    if (fdatasync(journal.fd) != 0) {
+        PLOG(ERROR) << "Unable to sync persistent property journal";
+    }
+
+    if (journal.sync_directory) {
+        auto dir = Dirname(persistent_property_filename);
+        auto dir_fd = unique_fd{open(dir.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC)};
+        if (dir_fd < 0 || fsync(dir_fd) != 0) {
+            PLOG(ERROR) << "Unable to sync persistent properties directory";
+            return;
+        }
+        journal.sync_directory = false;
     }
 }
 
@@ -17,6 +17,8 @@
 #ifndef _INIT_PERSISTENT_PROPERTIES_H
 #define _INIT_PERSISTENT_PROPERTIES_H
 
+#include <chrono>
+#include <optional>
 #include <string>
 
 #include "result.h"
@@ -28,6 +30,13 @@ namespace init {
 PersistentProperties LoadPersistentProperties();
 void WritePersistentProperty(const std::string& name, const std::string& value);
 
+// Updates are appended to a journal next to the property file and fsync()'ed in groups, so a
+// crash can lose the updates written in the last 50ms. The property service holds its replies to
+// persist.* sets until then, and syncs straight away when sys.powerctl is set. These return how
+// long until pending journal writes must be synced (std::nullopt if there are none), and sync them.
+std::optional<std::chrono::milliseconds> PersistentPropertySyncTimeout();
+void SyncPersistentProperties();
+
 // Exposed only for testing
 Result<PersistentProperties> LoadPersistentPropertyFile();
 Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_properties);
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistent_properties.h"
+
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace init {
+
+static constexpr int kPropertyCount = 1000;
+
+static PersistentProperties MakePersistentProperties() {
+    PersistentProperties persistent_properties;
+    for (int i = 0; i < kPropertyCount; ++i) {
+        auto record = persistent_properties.add_properties();
+        record->set_name(android::base::StringPrintf("persist.bench.prop%d", i));
+        record->set_value(android::base::StringPrintf("value%d", i));
+    }
+    return persistent_properties;
+}
+
+// Updates to a store of 1000 properties, synced every state.range(0) updates, as happens when a
+// burst of updates arrives within one sync delay.
+static void BenchmarkWritePersistentProperty(benchmark::State& state) {
+    TemporaryFile tf;
+    persistent_property_filename = tf.path;
+    if (!WritePersistentPropertyFile(MakePersistentProperties()).ok()) {
+        state.SkipWithError("Could not write persistent property file");
+        return;
+    }
+
+    const int updates_per_sync = state.range(0);
+    int i = 0;
+    for (auto _ : state) {
+        WritePersistentProperty(
+                android::base::StringPrintf("persist.bench.prop%d", i % kPropertyCount),
+                std::to_string(i));
+        if (++i % updates_per_sync == 0) {
+            SyncPersistentProperties();
+        }
+    }
+    SyncPersistentProperties();
+    unlink((tf.path + std::string(".journal")).c_str());
+}
+
+BENCHMARK(BenchmarkWritePersistentProperty)->Arg(1)->Arg(16)->Arg(128);
+
+// The cost of rewriting the whole property file, which every update used to pay.
+static void BenchmarkWritePersistentPropertyFile(benchmark::State& state) {
+    TemporaryFile tf;
+    persistent_property_filename = tf.path;
+    auto persistent_properties = MakePersistentProperties();
+
+    for (auto _ : state) {
+        if (!WritePersistentPropertyFile(persistent_properties).ok()) {
+            state.SkipWithError("Could not write persistent property file");
+            return;
+        }
+    }
+}
+
+BENCHMARK(BenchmarkWritePersistentPropertyFile);
+
+}  // namespace init
+}  // namespace android
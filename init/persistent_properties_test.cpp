@@ -155,5 +155,113 @@ TEST(persistent_properties, UpdatePropertyBadParse) {
     EXPECT_FALSE(it == read_back_properties.properties().end());
 }
 
+TEST(persistent_properties, JournalReplay) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties = {
+        {"persist.sys.locale", "en-US"},
+        {"persist.sys.timezone", "America/Los_Angeles"},
+    };
+    ASSERT_RESULT_OK(
+            WritePersistentPropertyFile(VectorToPersistentProperties(persistent_properties)));
+
+    // The first write rewrites the file, later ones go to the journal.
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+    WritePersistentProperty("persist.test.journal", "1");
+    WritePersistentProperty("persist.test.journal", "2");
+    SyncPersistentProperties();
+
+    // A record torn by a crash must not affect the ones before it.
+    std::string journal_filename = tf.path + ".journal"s;
+    std::string journal;
+    ASSERT_TRUE(android::base::ReadFileToString(journal_filename, &journal));
+    ASSERT_FALSE(journal.empty());
+    journal += "\x10\0\0\0garbage"s;
+    ASSERT_TRUE(android::base::WriteStringToFile(journal, journal_filename));
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.sys.locale", "pt-BR"},
+        {"persist.sys.timezone", "America/Los_Angeles"},
+        {"persist.test.journal", "2"},
+    };
+
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+
+    // Rewriting the property file folds the journal in.
+    ASSERT_RESULT_OK(WritePersistentPropertyFile(read_back_properties));
+    EXPECT_EQ(-1, access(journal_filename.c_str(), F_OK));
+    read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+}
+
+TEST(persistent_properties, JournalChecksumMismatch) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+
+    ASSERT_RESULT_OK(WritePersistentPropertyFile(
+            VectorToPersistentProperties({{"persist.sys.locale", "en-US"}})));
+
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+    WritePersistentProperty("persist.test.journal", "1");
+    std::string journal_filename = tf.path + ".journal"s;
+    std::string journal;
+    ASSERT_TRUE(android::base::ReadFileToString(journal_filename, &journal));
+    size_t second_record = journal.size();
+    WritePersistentProperty("persist.test.journal", "2");
+    WritePersistentProperty("persist.test.other", "3");
+    SyncPersistentProperties();
+
+    // A complete record with a bad checksum stops the replay, even though later records are valid.
+    ASSERT_TRUE(android::base::ReadFileToString(journal_filename, &journal));
+    journal[second_record + sizeof(uint32_t)] ^= 0xff;
+    ASSERT_TRUE(android::base::WriteStringToFile(journal, journal_filename));
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.sys.locale", "pt-BR"},
+        {"persist.test.journal", "1"},
+    };
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+}
+
+TEST(persistent_properties, JournalCompaction) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+
+    ASSERT_RESULT_OK(WritePersistentPropertyFile(
+            VectorToPersistentProperties({{"persist.sys.locale", "en-US"}})));
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+
+    // Enough updates to push the journal past its 64KiB limit.
+    std::string journal_filename = tf.path + ".journal"s;
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.sys.locale", "pt-BR"},
+    };
+    bool compacted = false;
+    for (int i = 0; i < 100; ++i) {
+        auto name = "persist.test.compaction." + std::to_string(i);
+        auto value = std::string(1000, 'a' + i % 26);
+        WritePersistentProperty(name, value);
+        persistent_properties_expected.emplace_back(name, value);
+        if (access(journal_filename.c_str(), F_OK) == -1) {
+            compacted = true;
+        }
+    }
+    SyncPersistentProperties();
+    EXPECT_TRUE(compacted);
+
+    std::string journal;
+    ASSERT_TRUE(android::base::ReadFileToString(journal_filename, &journal));
+    EXPECT_LT(journal.size(), 64u * 1024);
+
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+}
+
 }  // namespace init
 }  // namespace android
@@ -45,6 +45,8 @@
 #include <optional>
 #include <queue>
 #include <thread>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <InitProperties.sysprop.h>
@@ -54,9 +56,11 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/thread_annotations.h>
 #include <property_info_parser/property_info_parser.h>
 #include <property_info_serializer/property_info_serializer.h>
 #include <selinux/android.h>
+#include <selinux/avc.h>
 #include <selinux/label.h>
 #include <selinux/selinux.h>
 #include <sys/system_properties.h>
@@ -104,6 +108,15 @@ static std::thread property_service_thread;
 
 static PropertyInfoAreaFile property_info_area;
 
+// Replies to persist.* sets are held until the journal records they appended have been synced, so
+// that a caller that sees success knows the value survives a crash or power loss. Only used by the
+// property service thread.
+struct PendingPersistentReply {
+    unique_fd socket;
+    std::vector<uint32_t> results;
+};
+static std::vector<PendingPersistentReply> pending_persistent_replies;
+
 struct PropertyAuditData {
     const ucred* cr;
     const char* name;
@@ -147,12 +160,107 @@ bool CanReadProperty(const std::string& source_context, const std::string& name)
                                 &audit_data) == 0;
 }
 
+// Bulk property sets from one process check the same (source, target) context pairs over and
+// over, so allowed pairs are remembered. Only silent enforcing-mode allows are cached: grants to
+// permissive domains and auditallow grants are logged by every check, so they are never cached.
+// The cache is dropped whenever the policy is reloaded or the enforcing mode changes.
+//
+// Reloads are detected by comparing the policyload sequence number in the status page, not
+// with selinux_status_updated(), whose "updated since last call" state is shared with the AVC.
+class MacPermsCache {
+  public:
+    bool Contains(const char* source_context, const char* target_context) {
+        auto lock = std::lock_guard{lock_};
+        if (!Valid()) return false;
+        return allowed_.count(Key(source_context, target_context)) != 0;
+    }
+
+    // Returns the generation to pass to Add() for an access check made after this call.
+    uint64_t Generation() {
+        auto lock = std::lock_guard{lock_};
+        return Valid() ? generation_ : 0;
+    }
+
+    // Remembers an allow, unless the policy or the enforcing mode changed since |generation|.
+    void Add(const char* source_context, const char* target_context, uint64_t generation) {
+        auto lock = std::lock_guard{lock_};
+        if (!Valid() || generation != generation_ || enforcing_ != 1) return;
+        if (allowed_.size() >= kMaxEntries) {
+            allowed_.clear();
+        }
+        allowed_.emplace(Key(source_context, target_context));
+    }
+
+  private:
+    static constexpr size_t kMaxEntries = 1024;
+
+    static std::string Key(const char* source_context, const char* target_context) {
+        std::string key = source_context;
+        key += '\0';
+        key += target_context;
+        return key;
+    }
+
+    bool Valid() REQUIRES(lock_) {
+        if (!status_open_) {
+            status_open_ = selinux_status_open(1) >= 0;
+            if (!status_open_) return false;
+        }
+        int policyload = selinux_status_policyload();
+        int enforcing = selinux_status_getenforce();
+        if (policyload < 0 || enforcing < 0) return false;
+        if (policyload != policyload_ || enforcing != enforcing_) {
+            allowed_.clear();
+            policyload_ = policyload;
+            enforcing_ = enforcing;
+            generation_++;
+        }
+        return true;
+    }
+
+    std::mutex lock_;
+    bool status_open_ GUARDED_BY(lock_) = false;
+    int policyload_ GUARDED_BY(lock_) = -1;
+    int enforcing_ GUARDED_BY(lock_) = -1;
+    uint64_t generation_ GUARDED_BY(lock_) = 0;
+    std::unordered_set<std::string> allowed_ GUARDED_BY(lock_);
+};
+
+// Returns whether an allowed property_service set check for this pair would be granted without
+// an audit record, so that skipping it doesn't lose anything from the log.
+static bool IsSilentAllow(const char* source_context, const char* target_context) {
+    security_id_t source_sid;
+    security_id_t target_sid;
+    if (avc_context_to_sid(source_context, &source_sid) != 0 ||
+        avc_context_to_sid(target_context, &target_sid) != 0) {
+        return false;
+    }
+
+    security_class_t tclass = string_to_security_class("property_service");
+    access_vector_t perm = tclass ? string_to_av_perm(tclass, "set") : 0;
+    if (perm == 0) {
+        return false;
+    }
+
+    av_decision avd;
+    if (avc_has_perm_noaudit(source_sid, target_sid, tclass, perm, nullptr, &avd) != 0) {
+        return false;
+    }
+    return !(avd.flags & SELINUX_AVD_FLAGS_PERMISSIVE) && !(avd.auditallow & perm);
+}
+
 static bool CheckMacPerms(const std::string& name, const char* target_context,
                           const char* source_context, const ucred& cr) {
     if (!target_context || !source_context) {
         return false;
     }
 
+    static MacPermsCache cache;
+    if (cache.Contains(source_context, target_context)) {
+        return true;
+    }
+    uint64_t generation = cache.Generation();
+
     PropertyAuditData audit_data;
 
     audit_data.name = name.c_str();
@@ -160,6 +268,9 @@ static bool CheckMacPerms(const std::string& name, const char* target_context,
 
     bool has_access = (selinux_check_access(source_context, target_context, "property_service",
                                             "set", &audit_data) == 0);
+    if (has_access && IsSilentAllow(source_context, target_context)) {
+        cache.Add(source_context, target_context, generation);
+    }
 
     return has_access;
 }
@@ -291,6 +402,15 @@ class SocketConnection {
         return result == sizeof(value);
     }
 
+    bool SendUint32s(const std::vector<uint32_t>& values) {
+        if (!socket_.ok()) {
+            return true;
+        }
+        size_t size = values.size() * sizeof(uint32_t);
+        ssize_t result = TEMP_FAILURE_RETRY(send(socket_, values.data(), size, 0));
+        return result == static_cast<ssize_t>(size);
+    }
+
     bool GetSourceContext(std::string* source_context) const {
         char* c_source_context = nullptr;
         if (getpeercon(socket_, &c_source_context) != 0) {
@@ -394,7 +514,12 @@ static uint32_t SendControlMessage(const std::string& msg, const std::string& na
     }
 
     bool queue_success = QueueControlMessage(msg, name, pid, fd);
-    if (!queue_success && fd != -1) {
+    if (!queue_success) {
+        // Without the fd, init can't reply, so the caller reports the failure.
+        if (fd == -1) {
+            *error = "Too many pending control messages";
+            return PROP_ERROR_HANDLE_CONTROL_MESSAGE;
+        }
         uint32_t response = PROP_ERROR_HANDLE_CONTROL_MESSAGE;
         TEMP_FAILURE_RETRY(send(fd, &response, sizeof(response), 0));
         close(fd);
@@ -497,6 +622,8 @@ uint32_t HandlePropertySet(const std::string& name, const std::string& value,
             *error = "Userspace reboot is not supported by this device";
             return PROP_ERROR_INVALID_VALUE;
         }
+        // Don't leave persistent property updates waiting for their group sync across a shutdown.
+        SyncPersistentProperties();
     }
 
     // If a process other than init is writing a non-empty value, it means that process is
@@ -594,10 +721,72 @@ static void handle_property_set_fd() {
             LOG(ERROR) << "Unable to set property '" << name << "' from uid:" << cr.uid
                        << " gid:" << cr.gid << " pid:" << cr.pid << ": " << error;
         }
+        if (result == PROP_SUCCESS && StartsWith(name, "persist.") &&
+            PersistentPropertySyncTimeout()) {
+            pending_persistent_replies.push_back({unique_fd(socket.Release()), {result}});
+            break;
+        }
         socket.SendUint32(result);
         break;
       }
 
+    case PROP_MSG_SETPROP_BATCH: {
+        uint32_t count = 0;
+        if (!socket.RecvUint32(&count, &timeout_ms)) {
+            PLOG(ERROR) << "sys_prop(PROP_MSG_SETPROP_BATCH): error while reading the count";
+            socket.SendUint32(PROP_ERROR_READ_DATA);
+            return;
+        }
+        if (count > kMaxSetPropBatchSize) {
+            LOG(ERROR) << "sys_prop(PROP_MSG_SETPROP_BATCH): too many properties: " << count;
+            socket.SendUint32(PROP_ERROR_READ_DATA);
+            return;
+        }
+
+        std::string source_context;
+        if (!socket.GetSourceContext(&source_context)) {
+            PLOG(ERROR) << "Unable to set properties: getpeercon() failed";
+            socket.SendUint32(PROP_ERROR_PERMISSION_DENIED);
+            return;
+        }
+
+        // Each pair is applied as soon as it's read, so init never holds more than one of them.
+        // Control messages in a batch don't hand the socket to init, so their result only says
+        // whether they were queued.
+        const auto& cr = socket.cred();
+        std::vector<uint32_t> results;
+        results.reserve(count);
+        bool wrote_persistent = false;
+        for (uint32_t i = 0; i < count; ++i) {
+            std::string name;
+            std::string value;
+            if (!socket.RecvString(&name, &timeout_ms) || !socket.RecvString(&value, &timeout_ms)) {
+                PLOG(ERROR) << "sys_prop(PROP_MSG_SETPROP_BATCH): error while reading name/value "
+                               "from the socket";
+                socket.SendUint32(PROP_ERROR_READ_DATA);
+                return;
+            }
+
+            std::string error;
+            uint32_t result = HandlePropertySet(name, value, source_context, cr, nullptr, &error);
+            if (result != PROP_SUCCESS) {
+                LOG(ERROR) << "Unable to set property '" << name << "' from uid:" << cr.uid
+                           << " gid:" << cr.gid << " pid:" << cr.pid << ": " << error;
+            }
+            if (result == PROP_SUCCESS && StartsWith(name, "persist.")) {
+                wrote_persistent = true;
+            }
+            results.emplace_back(result);
+        }
+        if (wrote_persistent && PersistentPropertySyncTimeout()) {
+            pending_persistent_replies.push_back(
+                    {unique_fd(socket.Release()), std::move(results)});
+            break;
+        }
+        socket.SendUint32s(results);
+        break;
+      }
+
     default:
         LOG(ERROR) << "sys_prop: invalid command " << cmd;
         socket.SendUint32(PROP_ERROR_INVALID_CMD);
@@ -1130,7 +1319,7 @@ static void PropertyServiceThread() {
     }
 
     while (true) {
-        auto pending_functions = epoll.Wait(std::nullopt);
+        auto pending_functions = epoll.Wait(PersistentPropertySyncTimeout());
         if (!pending_functions.ok()) {
             LOG(ERROR) << pending_functions.error();
         } else {
@@ -1138,6 +1327,21 @@ static void PropertyServiceThread() {
                 (*function)();
             }
         }
+
+        // Persistent property updates written since the last sync are committed together.
+        if (auto timeout = PersistentPropertySyncTimeout(); timeout && *timeout == 0ms) {
+            SyncPersistentProperties();
+        }
+
+        // Nothing is left to sync, either because of the sync above or because the journal was
+        // compacted into the property file, so the held replies can go out.
+        if (!PersistentPropertySyncTimeout()) {
+            for (const auto& reply : pending_persistent_replies) {
+                size_t size = reply.results.size() * sizeof(uint32_t);
+                TEMP_FAILURE_RETRY(send(reply.socket, reply.results.data(), size, 0));
+            }
+            pending_persistent_replies.clear();
+        }
     }
 }
 
@@ -1166,5 +1370,41 @@ void StartPropertyService(int* epoll_socket) {
     property_service_thread.swap(new_thread);
 }
 
+Result<std::vector<uint32_t>> SetPropertiesBatch(
+        const std::vector<std::pair<std::string, std::string>>& properties) {
+    unique_fd fd(socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (fd == -1) {
+        return ErrnoError() << "socket() failed";
+    }
+
+    sockaddr_un addr = {.sun_family = AF_LOCAL};
+    strlcpy(addr.sun_path, "/dev/socket/" PROP_SERVICE_NAME, sizeof(addr.sun_path));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        return ErrnoError() << "connect() to " << addr.sun_path << " failed";
+    }
+
+    std::string request;
+    auto append_uint32 = [&request](uint32_t value) {
+        request.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append_uint32(PROP_MSG_SETPROP_BATCH);
+    append_uint32(properties.size());
+    for (const auto& [name, value] : properties) {
+        append_uint32(name.size());
+        request += name;
+        append_uint32(value.size());
+        request += value;
+    }
+    if (!android::base::WriteFully(fd, request.data(), request.size())) {
+        return ErrnoError() << "Failed to send request";
+    }
+
+    std::vector<uint32_t> results(properties.size());
+    if (!android::base::ReadFully(fd, results.data(), results.size() * sizeof(uint32_t))) {
+        return ErrnoError() << "Failed to read results";
+    }
+    return results;
+}
+
 }  // namespace init
 }  // namespace android
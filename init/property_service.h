@@ -19,14 +19,25 @@
 #include <sys/socket.h>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "epoll.h"
+#include "result.h"
 
 namespace android {
 namespace init {
 
 static constexpr const char kRestoreconProperty[] = "selinux.restorecon_recursive";
 
+// Sets several properties over one property service connection. The request is the command,
+// a uint32_t count and then count name/value pairs, each string sent as with PROP_MSG_SETPROP2.
+// The reply is one uint32_t PROP_SUCCESS or PROP_ERROR_* result per pair, in order, or a single
+// error if the request couldn't be read. Pairs are applied as they are read, so those before a
+// read error have already been set.
+static constexpr uint32_t PROP_MSG_SETPROP_BATCH = 0x00030001;
+static constexpr uint32_t kMaxSetPropBatchSize = 1024;
+
 bool CanReadProperty(const std::string& source_context, const std::string& name);
 
 void PropertyInit();
@@ -35,5 +46,10 @@ void StartPropertyService(int* epoll_socket);
 void StartSendingMessages();
 void StopSendingMessages();
 
+// Client side of PROP_MSG_SETPROP_BATCH. __system_property_set() lives in bionic, so this is only
+// used by tests and benchmarks.
+Result<std::vector<uint32_t>> SetPropertiesBatch(
+        const std::vector<std::pair<std::string, std::string>>& properties);
+
 }  // namespace init
 }  // namespace android
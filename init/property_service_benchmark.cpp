@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "property_service.h"
+
+using android::base::StringPrintf;
+
+namespace android {
+namespace init {
+
+static std::vector<std::string> PropertyNames(int count) {
+    std::vector<std::string> names;
+    for (int i = 0; i < count; ++i) {
+        names.emplace_back(StringPrintf("property_service_benchmark.prop%d", i));
+    }
+    return names;
+}
+
+// One connection and SELinux check per property, as __system_property_set() does.
+static void BenchmarkSetPropertyEach(benchmark::State& state) {
+    if (getuid() != 0) {
+        state.SkipWithError("Skipping benchmark, must be run as root.");
+        return;
+    }
+
+    auto names = PropertyNames(state.range(0));
+    for (auto _ : state) {
+        for (const auto& name : names) {
+            android::base::SetProperty(name, "1");
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * names.size());
+}
+
+BENCHMARK(BenchmarkSetPropertyEach)->Arg(16)->Arg(256);
+
+// A single PROP_MSG_SETPROP_BATCH request for all of the properties.
+static void BenchmarkSetPropertyBatch(benchmark::State& state) {
+    if (getuid() != 0) {
+        state.SkipWithError("Skipping benchmark, must be run as root.");
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> properties;
+    for (const auto& name : PropertyNames(state.range(0))) {
+        properties.emplace_back(name, "1");
+    }
+    for (auto _ : state) {
+        if (!SetPropertiesBatch(properties).ok()) {
+            state.SkipWithError("PROP_MSG_SETPROP_BATCH request failed");
+            return;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * properties.size());
+}
+
+BENCHMARK(BenchmarkSetPropertyBatch)->Arg(16)->Arg(256);
+
+}  // namespace init
+}  // namespace android
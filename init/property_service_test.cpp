@@ -21,10 +21,16 @@
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <android-base/properties.h>
 #include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
 
+#include "property_service.h"
+
 using android::base::GetProperty;
 using android::base::SetProperty;
 
@@ -90,5 +96,28 @@ TEST(property_service, userspace_reboot_not_supported) {
     EXPECT_FALSE(SetProperty("sys.powerctl", "reboot,userspace"));
 }
 
+TEST(property_service, set_batch) {
+    if (getuid() != 0) {
+        GTEST_SKIP() << "Skipping test, must be run as root.";
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> properties = {
+            {"property_service_batch_test.a", "1"},
+            {"property_service_batch_test..invalid", "2"},
+            {"property_service_batch_test.b", "3"},
+    };
+
+    auto results = SetPropertiesBatch(properties);
+    ASSERT_RESULT_OK(results);
+    ASSERT_EQ(3U, results->size());
+    EXPECT_EQ(static_cast<uint32_t>(PROP_SUCCESS), (*results)[0]);
+    EXPECT_EQ(static_cast<uint32_t>(PROP_ERROR_INVALID_NAME), (*results)[1]);
+    EXPECT_EQ(static_cast<uint32_t>(PROP_SUCCESS), (*results)[2]);
+
+    EXPECT_EQ("1", GetProperty("property_service_batch_test.a", ""));
+    EXPECT_EQ("3", GetProperty("property_service_batch_test.b", ""));
+}
+
 }  // namespace init
 }  // namespace android
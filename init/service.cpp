@@ -18,9 +18,7 @@
 
 #include <fcntl.h>
 #include <inttypes.h>
-#include <linux/securebits.h>
 #include <sched.h>
-#include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <termios.h>
@@ -36,8 +34,10 @@
 #include <processgroup/processgroup.h>
 #include <selinux/selinux.h>
 
+#include "boot_trace.h"
 #include "lmkd_service.h"
 #include "service_list.h"
+#include "service_spawner.h"
 #include "util.h"
 
 #ifdef INIT_FULL_SOURCES
@@ -105,29 +105,6 @@ static Result<std::string> ComputeContextFromExecutable(const std::string& servi
     return computed_context;
 }
 
-static bool ExpandArgsAndExecv(const std::vector<std::string>& args, bool sigstop) {
-    std::vector<std::string> expanded_args;
-    std::vector<char*> c_strings;
-
-    expanded_args.resize(args.size());
-    c_strings.push_back(const_cast<char*>(args[0].data()));
-    for (std::size_t i = 1; i < args.size(); ++i) {
-        auto expanded_arg = ExpandProps(args[i]);
-        if (!expanded_arg.ok()) {
-            LOG(FATAL) << args[0] << ": cannot expand arguments': " << expanded_arg.error();
-        }
-        expanded_args[i] = *expanded_arg;
-        c_strings.push_back(expanded_args[i].data());
-    }
-    c_strings.push_back(nullptr);
-
-    if (sigstop) {
-        kill(getpid(), SIGSTOP);
-    }
-
-    return execv(c_strings[0], c_strings.data()) == 0;
-}
-
 static bool AreRuntimeApexesReady() {
     struct stat buf;
     return stat("/apex/com.android.art/", &buf) == 0 &&
@@ -224,44 +201,12 @@ void Service::KillProcessGroup(int signal, bool report_oneshot) {
     }
 }
 
-void Service::SetProcessAttributesAndCaps() {
-    // Keep capabilites on uid change.
-    if (capabilities_ && proc_attr_.uid) {
-        // If Android is running in a container, some securebits might already
-        // be locked, so don't change those.
-        unsigned long securebits = prctl(PR_GET_SECUREBITS);
-        if (securebits == -1UL) {
-            PLOG(FATAL) << "prctl(PR_GET_SECUREBITS) failed for " << name_;
-        }
-        securebits |= SECBIT_KEEP_CAPS | SECBIT_KEEP_CAPS_LOCKED;
-        if (prctl(PR_SET_SECUREBITS, securebits) != 0) {
-            PLOG(FATAL) << "prctl(PR_SET_SECUREBITS) failed for " << name_;
-        }
-    }
-
-    if (auto result = SetProcessAttributes(proc_attr_); !result.ok()) {
-        LOG(FATAL) << "cannot set attribute for " << name_ << ": " << result.error();
-    }
-
-    if (!seclabel_.empty()) {
-        if (setexeccon(seclabel_.c_str()) < 0) {
-            PLOG(FATAL) << "cannot setexeccon('" << seclabel_ << "') for " << name_;
-        }
-    }
-
-    if (capabilities_) {
-        if (!SetCapsForExec(*capabilities_)) {
-            LOG(FATAL) << "cannot set capabilities for " << name_;
-        }
-    } else if (proc_attr_.uid) {
-        // Inheritable caps can be non-zero when running in a container.
-        if (!DropInheritableCaps()) {
-            LOG(FATAL) << "cannot drop inheritable caps for " << name_;
-        }
+void Service::Reap(const siginfo_t& siginfo) {
+    if (IsBootTraceEnabled()) {
+        BootTraceComplete(BootTraceCategory::kService, name_, time_started_, boot_clock::now(),
+                          pid_);
     }
-}
 
-void Service::Reap(const siginfo_t& siginfo) {
     if (!(flags_ & SVC_ONESHOT) || (flags_ & SVC_RESTART)) {
         KillProcessGroup(SIGKILL, false);
     } else {
@@ -397,6 +342,7 @@ Result<void> Service::ExecStart() {
 }
 
 Result<void> Service::Start() {
+    auto start_requested = boot_clock::now();
     auto reboot_on_failure = make_scope_guard([this] {
         if (on_failure_reboot_target_) {
             trigger_shutdown(*on_failure_reboot_target_);
@@ -491,47 +437,48 @@ Result<void> Service::Start() {
         }
     }
 
-    pid_t pid = -1;
-    if (namespaces_.flags) {
-        pid = clone(nullptr, nullptr, namespaces_.flags | SIGCHLD, nullptr);
-    } else {
-        pid = fork();
-    }
-
-    if (pid == 0) {
-        umask(077);
-
-        if (auto result = EnterNamespaces(namespaces_, name_, pre_apexd_); !result.ok()) {
-            LOG(FATAL) << "Service '" << name_
-                       << "' failed to set up namespaces: " << result.error();
-        }
-
-        for (const auto& [key, value] : environment_vars_) {
-            setenv(key.c_str(), value.c_str(), 1);
-        }
+    auto exec_info = ServiceExecInfo{
+            .name = name_,
+            .args = args_,
+            .sigstop = sigstop_,
+            .namespaces = namespaces_,
+            .pre_apexd = pre_apexd_,
+            .environment_vars = environment_vars_,
+            .writepid_files = writepid_files_,
+            .task_profiles = task_profiles_,
+            .proc_attr = proc_attr_,
+            .seclabel = seclabel_,
+            .capabilities = capabilities_,
+    };
 
-        for (const auto& descriptor : descriptors) {
-            descriptor.Publish();
-        }
-
-        if (auto result = WritePidToFiles(&writepid_files_); !result.ok()) {
-            LOG(ERROR) << "failed to write pid to files: " << result.error();
+    // The spawner is a freshly exec'd init that never opened the bootstrap mount namespace, so it
+    // can't start pre-apexd services once init has moved to the default namespace.
+    pid_t pid = -1;
+    if (auto spawner = GetServiceSpawner(); spawner && !pre_apexd_) {
+        bool may_have_started = false;
+        if (auto result = spawner->Spawn(exec_info, descriptors, &may_have_started); result.ok()) {
+            pid = *result;
+        } else if (may_have_started) {
+            // A second copy would compete with the one that may be running for its sockets and
+            // files, so don't fork the service again.
+            return Error() << "Could not start service from the service spawner: "
+                           << result.error();
+        } else {
+            LOG(ERROR) << "Could not start service '" << name_
+                       << "' from the service spawner, forking it instead: " << result.error();
         }
+    }
 
-        if (task_profiles_.size() > 0 && !SetTaskProfiles(getpid(), task_profiles_)) {
-            LOG(ERROR) << "failed to set task profiles";
+    if (pid == -1) {
+        if (namespaces_.flags) {
+            pid = clone(nullptr, nullptr, namespaces_.flags | SIGCHLD, nullptr);
+        } else {
+            pid = fork();
         }
 
-        // As requested, set our gid, supplemental gids, uid, context, and
-        // priority. Aborts on failure.
-        SetProcessAttributesAndCaps();
-
-        if (!ExpandArgsAndExecv(args_, sigstop_)) {
-            PLOG(ERROR) << "cannot execv('" << args_[0]
-                        << "'). See the 'Debugging init' section of init's README.md for tips";
+        if (pid == 0) {
+            SetUpAndExecService(exec_info, descriptors);
         }
-
-        _exit(127);
     }
 
     if (pid < 0) {
@@ -549,6 +496,17 @@ Result<void> Service::Start() {
 
     time_started_ = boot_clock::now();
     pid_ = pid;
+    if (IsBootTraceEnabled()) {
+        BootTraceComplete(BootTraceCategory::kService, "start " + name_, start_requested,
+                          time_started_, pid_);
+    }
+    // Creating the sockets and files and forking dominate this, so report starts that are slow
+    // the same way slow commands are reported.
+    auto start_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            time_started_ - start_requested);
+    if (start_duration > 50ms) {
+        LOG(INFO) << "Starting service '" << name_ << "' took " << start_duration.count() << "ms";
+    }
     flags_ |= SVC_RUNNING;
     start_order_ = next_start_order_++;
     process_cgroup_empty_ = false;
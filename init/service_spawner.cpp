@@ -0,0 +1,526 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "service_spawner.h"
+
+#include <fcntl.h>
+#include <linux/securebits.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+
+#include <android-base/cmsg.h>
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <processgroup/processgroup.h>
+#include <selinux/selinux.h>
+
+#include "proto_utils.h"
+#include "system/core/init/service_spawner.pb.h"
+#include "util.h"
+
+using android::base::GetBoolProperty;
+using android::base::GetExecutablePath;
+using android::base::Readlink;
+using android::base::ReceiveFileDescriptorVector;
+using android::base::SendFileDescriptorVector;
+using android::base::Socketpair;
+using android::base::StringPrintf;
+using android::base::unique_fd;
+using namespace std::chrono_literals;
+
+extern char** environ;
+
+namespace android {
+namespace init {
+
+namespace {
+
+// Requests carry init's whole environment, which can be larger than the messages that
+// ReadMessage() expects, so the spawner uses its own limit for them.
+constexpr size_t kMaxRequestSize = 64 * 1024;
+constexpr size_t kMaxDescriptors = 64;
+
+// Forking a service takes the spawner well under a millisecond.  A spawner that has not replied
+// after this long is assumed to be wedged, and init forks the service itself instead of waiting.
+constexpr std::chrono::milliseconds kSpawnReplyTimeout = 1s;
+
+std::unique_ptr<ServiceSpawner> service_spawner;
+
+void SetProcessAttributesAndCaps(const ServiceExecInfo& info) {
+    // Keep capabilites on uid change.
+    if (info.capabilities && info.proc_attr.uid) {
+        // If Android is running in a container, some securebits might already
+        // be locked, so don't change those.
+        unsigned long securebits = prctl(PR_GET_SECUREBITS);
+        if (securebits == -1UL) {
+            PLOG(FATAL) << "prctl(PR_GET_SECUREBITS) failed for " << info.name;
+        }
+        securebits |= SECBIT_KEEP_CAPS | SECBIT_KEEP_CAPS_LOCKED;
+        if (prctl(PR_SET_SECUREBITS, securebits) != 0) {
+            PLOG(FATAL) << "prctl(PR_SET_SECUREBITS) failed for " << info.name;
+        }
+    }
+
+    if (auto result = SetProcessAttributes(info.proc_attr); !result.ok()) {
+        LOG(FATAL) << "cannot set attribute for " << info.name << ": " << result.error();
+    }
+
+    if (!info.seclabel.empty()) {
+        if (setexeccon(info.seclabel.c_str()) < 0) {
+            PLOG(FATAL) << "cannot setexeccon('" << info.seclabel << "') for " << info.name;
+        }
+    }
+
+    if (info.capabilities) {
+        if (!SetCapsForExec(*info.capabilities)) {
+            LOG(FATAL) << "cannot set capabilities for " << info.name;
+        }
+    } else if (info.proc_attr.uid) {
+        // Inheritable caps can be non-zero when running in a container.
+        if (!DropInheritableCaps()) {
+            LOG(FATAL) << "cannot drop inheritable caps for " << info.name;
+        }
+    }
+}
+
+bool ExpandArgsAndExecv(const std::vector<std::string>& args, bool sigstop) {
+    std::vector<std::string> expanded_args;
+    std::vector<char*> c_strings;
+
+    expanded_args.resize(args.size());
+    c_strings.push_back(const_cast<char*>(args[0].data()));
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        auto expanded_arg = ExpandProps(args[i]);
+        if (!expanded_arg.ok()) {
+            LOG(FATAL) << args[0] << ": cannot expand arguments': " << expanded_arg.error();
+        }
+        expanded_args[i] = *expanded_arg;
+        c_strings.push_back(expanded_args[i].data());
+    }
+    c_strings.push_back(nullptr);
+
+    if (sigstop) {
+        kill(getpid(), SIGSTOP);
+    }
+
+    return execv(c_strings[0], c_strings.data()) == 0;
+}
+
+ServiceSpawnRequest MakeSpawnRequest(const ServiceExecInfo& info,
+                                     const std::vector<Descriptor>& descriptors) {
+    auto request = ServiceSpawnRequest{};
+    request.set_name(info.name);
+    for (const auto& arg : info.args) {
+        request.add_args(arg);
+    }
+    request.set_sigstop(info.sigstop);
+    request.set_namespace_flags(info.namespaces.flags);
+    for (const auto& [type, path] : info.namespaces.namespaces_to_enter) {
+        auto* ns = request.add_namespaces_to_enter();
+        ns->set_type(type);
+        ns->set_path(path);
+    }
+    request.set_pre_apexd(info.pre_apexd);
+    for (const auto& [key, value] : info.environment_vars) {
+        auto* variable = request.add_environment_vars();
+        variable->set_key(key);
+        variable->set_value(value);
+    }
+    for (const auto& file : info.writepid_files) {
+        request.add_writepid_files(file);
+    }
+    for (const auto& profile : info.task_profiles) {
+        request.add_task_profiles(profile);
+    }
+
+    const auto& attr = info.proc_attr;
+    request.set_console(attr.console);
+    request.set_ioprio_class(attr.ioprio_class);
+    request.set_ioprio_pri(attr.ioprio_pri);
+    for (const auto& [resource, limit] : attr.rlimits) {
+        auto* rlimit = request.add_rlimits();
+        rlimit->set_resource(resource);
+        rlimit->set_cur(limit.rlim_cur);
+        rlimit->set_max(limit.rlim_max);
+    }
+    request.set_uid(attr.uid);
+    request.set_gid(attr.gid);
+    for (const auto& gid : attr.supp_gids) {
+        request.add_supp_gids(gid);
+    }
+    request.set_priority(attr.priority);
+    request.set_stdio_to_kmsg(attr.stdio_to_kmsg);
+
+    request.set_seclabel(info.seclabel);
+    if (info.capabilities) {
+        request.set_capabilities(info.capabilities->to_ullong());
+    }
+
+    for (const auto& descriptor : descriptors) {
+        request.add_descriptor_names(descriptor.name());
+    }
+    for (char** variable = environ; *variable != nullptr; ++variable) {
+        request.add_environ(*variable);
+    }
+    return request;
+}
+
+ServiceExecInfo ExecInfoFromRequest(const ServiceSpawnRequest& request) {
+    auto info = ServiceExecInfo{};
+    info.name = request.name();
+    info.args.assign(request.args().begin(), request.args().end());
+    info.sigstop = request.sigstop();
+    info.namespaces.flags = request.namespace_flags();
+    for (const auto& ns : request.namespaces_to_enter()) {
+        info.namespaces.namespaces_to_enter.emplace_back(ns.type(), ns.path());
+    }
+    info.pre_apexd = request.pre_apexd();
+    for (const auto& variable : request.environment_vars()) {
+        info.environment_vars.emplace_back(variable.key(), variable.value());
+    }
+    info.writepid_files.assign(request.writepid_files().begin(), request.writepid_files().end());
+    info.task_profiles.assign(request.task_profiles().begin(), request.task_profiles().end());
+
+    auto& attr = info.proc_attr;
+    attr.console = request.console();
+    attr.ioprio_class = static_cast<IoSchedClass>(request.ioprio_class());
+    attr.ioprio_pri = request.ioprio_pri();
+    for (const auto& limit : request.rlimits()) {
+        attr.rlimits.emplace_back(limit.resource(), rlimit{limit.cur(), limit.max()});
+    }
+    attr.uid = request.uid();
+    attr.gid = request.gid();
+    attr.supp_gids.assign(request.supp_gids().begin(), request.supp_gids().end());
+    attr.priority = request.priority();
+    attr.stdio_to_kmsg = request.stdio_to_kmsg();
+
+    info.seclabel = request.seclabel();
+    if (request.has_capabilities()) {
+        info.capabilities = CapSet(request.capabilities());
+    }
+    return info;
+}
+
+// Init moves itself into the default mount namespace once the APEXes are activated, which happens
+// after the spawner is forked, so the spawner follows it before forking each service.
+Result<void> FollowMountNamespace(pid_t init_pid) {
+    auto init_ns_path = StringPrintf("/proc/%d/ns/mnt", init_pid);
+    std::string init_ns_id;
+    std::string own_ns_id;
+    if (!Readlink(init_ns_path, &init_ns_id) || !Readlink("/proc/self/ns/mnt", &own_ns_id)) {
+        return ErrnoError() << "Could not read mount namespace ids";
+    }
+    if (init_ns_id == own_ns_id) {
+        return {};
+    }
+
+    auto fd = unique_fd{open(init_ns_path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd == -1) {
+        return ErrnoError() << "Could not open " << init_ns_path;
+    }
+    if (setns(fd, CLONE_NEWNS) == -1) {
+        return ErrnoError() << "Could not enter the mount namespace of init";
+    }
+    return {};
+}
+
+Result<pid_t> SpawnFromRequest(const ServiceSpawnRequest& request, std::vector<unique_fd> fds,
+                               pid_t init_pid) {
+    if (static_cast<size_t>(request.descriptor_names_size()) != fds.size()) {
+        return Error() << "Expected " << request.descriptor_names_size()
+                       << " descriptors but received " << fds.size();
+    }
+
+    if (auto result = FollowMountNamespace(init_pid); !result.ok()) {
+        return result.error();
+    }
+
+    auto info = ExecInfoFromRequest(request);
+    std::vector<Descriptor> descriptors;
+    for (size_t i = 0; i < fds.size(); ++i) {
+        descriptors.emplace_back(request.descriptor_names(i), std::move(fds[i]));
+    }
+
+    // CLONE_PARENT makes the service a child of init rather than of the spawner, so init tracks and
+    // reaps it exactly as it would one that it forked itself.
+    pid_t pid = clone(nullptr, nullptr, CLONE_PARENT | info.namespaces.flags | SIGCHLD, nullptr);
+    if (pid == -1) {
+        return ErrnoError() << "Failed to fork";
+    }
+
+    if (pid == 0) {
+        clearenv();
+        for (const auto& variable : request.environ()) {
+            auto separator = variable.find('=');
+            if (separator == std::string::npos) continue;
+            setenv(variable.substr(0, separator).c_str(), variable.c_str() + separator + 1, 1);
+        }
+        SetUpAndExecService(info, descriptors);
+    }
+
+    return pid;
+}
+
+[[noreturn]] void ServiceSpawnerLoop(int init_fd, pid_t init_pid) {
+    std::vector<char> buffer(kMaxRequestSize);
+    while (true) {
+        std::vector<unique_fd> fds;
+        ssize_t size = TEMP_FAILURE_RETRY(ReceiveFileDescriptorVector(
+                init_fd, buffer.data(), buffer.size(), kMaxDescriptors, &fds));
+        if (size == 0) {
+            // Init closed its end of the socket, so it will not send any more requests.
+            _exit(0);
+        }
+        if (size < 0) {
+            PLOG(FATAL) << "Could not read spawn request from init";
+        }
+
+        auto request = ServiceSpawnRequest{};
+        if (!request.ParseFromArray(buffer.data(), size)) {
+            LOG(FATAL) << "Unable to parse spawn request from init";
+        }
+
+        auto reply = ServiceSpawnReply{};
+        if (auto pid = SpawnFromRequest(request, std::move(fds), init_pid); pid.ok()) {
+            reply.set_pid(*pid);
+        } else {
+            auto* failure = reply.mutable_failure();
+            failure->set_error_string(pid.error().message());
+            failure->set_error_errno(pid.error().code());
+        }
+
+        if (auto result = SendMessage(init_fd, reply); !result.ok()) {
+            LOG(FATAL) << "Failed to send spawn reply to init: " << result.error();
+        }
+    }
+}
+
+}  // namespace
+
+void SetUpAndExecService(const ServiceExecInfo& info, const std::vector<Descriptor>& descriptors) {
+    umask(077);
+
+    if (auto result = EnterNamespaces(info.namespaces, info.name, info.pre_apexd); !result.ok()) {
+        LOG(FATAL) << "Service '" << info.name
+                   << "' failed to set up namespaces: " << result.error();
+    }
+
+    for (const auto& [key, value] : info.environment_vars) {
+        setenv(key.c_str(), value.c_str(), 1);
+    }
+
+    for (const auto& descriptor : descriptors) {
+        descriptor.Publish();
+    }
+
+    auto writepid_files = info.writepid_files;
+    if (auto result = WritePidToFiles(&writepid_files); !result.ok()) {
+        LOG(ERROR) << "failed to write pid to files: " << result.error();
+    }
+
+    if (info.task_profiles.size() > 0 && !SetTaskProfiles(getpid(), info.task_profiles)) {
+        LOG(ERROR) << "failed to set task profiles";
+    }
+
+    // As requested, set our gid, supplemental gids, uid, context, and
+    // priority. Aborts on failure.
+    SetProcessAttributesAndCaps(info);
+
+    if (!ExpandArgsAndExecv(info.args, info.sigstop)) {
+        PLOG(ERROR) << "cannot execv('" << info.args[0]
+                    << "'). See the 'Debugging init' section of init's README.md for tips";
+    }
+
+    _exit(127);
+}
+
+int ServiceSpawnerMain(int argc, char** argv) {
+    if (argc < 3) LOG(FATAL) << "Fewer than 3 args specified to service_spawner (" << argc << ")";
+
+    auto init_fd = std::atoi(argv[2]);
+
+    // The spawner is always exec'd directly by init, which also becomes the parent of every
+    // service that it forks.
+    ServiceSpawnerLoop(init_fd, getppid());
+}
+
+void ServiceSpawner::Fork() {
+    unique_fd spawner_socket;
+    if (!Socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, &socket_, &spawner_socket)) {
+        PLOG(ERROR) << "Could not create socket pair to communicate to the service spawner";
+        return;
+    }
+
+    // Init already has other threads running, which may hold locks at the time of the fork, so
+    // the child execs a new copy of init straight away, the same way that subcontexts are started.
+    // Everything that the child needs is prepared before forking.
+    auto init_path = GetExecutablePath();
+    char* context = nullptr;
+    if (is_selinux_enabled() > 0 && getcon(&context) < 0) {
+        PLOG(ERROR) << "Could not get the SELinux context of init for the service spawner";
+        socket_.reset();
+        return;
+    }
+    auto free_context = std::unique_ptr<char, decltype(&freecon)>{context, freecon};
+
+    auto result = fork();
+
+    if (result == -1) {
+        PLOG(ERROR) << "Could not fork the service spawner";
+        socket_.reset();
+    } else if (result == 0) {
+        socket_.reset();
+
+        // We explicitly do not use O_CLOEXEC here, such that we can reference this FD by number
+        // in the spawner process after we exec.
+        int child_fd = dup(spawner_socket);  // NOLINT(android-cloexec-dup)
+        if (child_fd < 0) {
+            _exit(127);
+        }
+
+        // The spawner stays in the context of init, which is what services transition from.
+        if (context != nullptr && setexeccon(context) < 0) {
+            _exit(127);
+        }
+
+        char child_fd_string[16];
+        snprintf(child_fd_string, sizeof(child_fd_string), "%d", child_fd);
+        const char* args[] = {init_path.c_str(), "service_spawner", child_fd_string, nullptr};
+        execv(init_path.c_str(), const_cast<char**>(args));
+        _exit(127);
+    } else {
+        pid_ = result;
+        LOG(INFO) << "Forked service spawner with pid " << pid_;
+    }
+}
+
+void ServiceSpawner::Kill() {
+    if (pid_) {
+        kill(pid_, SIGKILL);
+    }
+    socket_.reset();
+}
+
+Result<pid_t> ServiceSpawner::Spawn(const ServiceExecInfo& info,
+                                    const std::vector<Descriptor>& descriptors,
+                                    bool* may_have_started) {
+    *may_have_started = false;
+    if (socket_ == -1) {
+        return Error() << "Service spawner is not running";
+    }
+
+    std::string message;
+    if (!MakeSpawnRequest(info, descriptors).SerializeToString(&message)) {
+        return Error() << "Unable to serialize spawn request";
+    }
+    if (message.size() > kMaxRequestSize) {
+        return Error() << "Spawn request is too large (" << message.size() << " bytes)";
+    }
+    if (descriptors.size() > kMaxDescriptors) {
+        return Error() << "Too many descriptors (" << descriptors.size() << ")";
+    }
+
+    std::vector<int> fds;
+    for (const auto& descriptor : descriptors) {
+        fds.emplace_back(descriptor.fd());
+    }
+
+    // The spawner is stopped on any communication failure, since a request or reply may have been
+    // left half way through the socket.
+    if (auto result = TEMP_FAILURE_RETRY(
+                SendFileDescriptorVector(socket_, message.data(), message.size(), fds));
+        result != static_cast<ssize_t>(message.size())) {
+        Kill();
+        return ErrnoError() << "Failed to send spawn request";
+    }
+
+    // From here on, the spawner may have forked the service even if no usable reply arrives.  Such
+    // a service keeps running without init tracking it, which is still better than init blocking
+    // forever on a wedged spawner, and the timeout is generous enough that it should not happen.
+    *may_have_started = true;
+    auto ufd = pollfd{.fd = socket_, .events = POLLIN};
+    int nr = TEMP_FAILURE_RETRY(poll(&ufd, 1, kSpawnReplyTimeout.count()));
+    if (nr <= 0) {
+        Kill();
+        if (nr == 0) {
+            return Error() << "Timed out after " << kSpawnReplyTimeout.count()
+                           << "ms waiting for a reply from the service spawner";
+        }
+        return ErrnoError() << "Failed to poll the service spawner socket";
+    }
+
+    auto reply_message = ReadMessage(socket_);
+    if (!reply_message.ok()) {
+        Kill();
+        return Error() << "Failed to receive reply from the service spawner: "
+                       << reply_message.error();
+    }
+
+    auto reply = ServiceSpawnReply{};
+    if (!reply.ParseFromString(*reply_message)) {
+        Kill();
+        return Error() << "Unable to parse reply from the service spawner";
+    }
+
+    if (reply.reply_case() == ServiceSpawnReply::kFailure) {
+        // The spawner reports failures before anything was forked.
+        *may_have_started = false;
+        auto& failure = reply.failure();
+        return ResultError(failure.error_string(), failure.error_errno());
+    }
+
+    if (reply.reply_case() != ServiceSpawnReply::kPid) {
+        Kill();
+        return Error() << "Unexpected reply from the service spawner: " << reply.reply_case();
+    }
+
+    return reply.pid();
+}
+
+void InitializeServiceSpawner() {
+    if (GetBoolProperty("ro.boot.init_spawner", false)) {
+        service_spawner.reset(new ServiceSpawner());
+    }
+}
+
+ServiceSpawner* GetServiceSpawner() {
+    return service_spawner.get();
+}
+
+bool ServiceSpawnerChildReap(pid_t pid) {
+    if (service_spawner && service_spawner->pid() == pid) {
+        // The spawner is forked while init is still small, which is the reason it exists, so
+        // rather than forking a new one from the full init, services are forked by init from now on.
+        service_spawner.reset();
+        return true;
+    }
+    return false;
+}
+
+}  // namespace init
+}  // namespace android
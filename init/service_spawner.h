@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+
+#include "capabilities.h"
+#include "result.h"
+#include "service_utils.h"
+
+namespace android {
+namespace init {
+
+// Everything that a newly forked service process needs to set itself up and exec the service.
+struct ServiceExecInfo {
+    std::string name;
+    std::vector<std::string> args;
+    bool sigstop = false;
+    NamespaceInfo namespaces;
+    bool pre_apexd = false;
+    std::vector<std::pair<std::string, std::string>> environment_vars;
+    std::vector<std::string> writepid_files;
+    std::vector<std::string> task_profiles;
+    ProcessAttributes proc_attr;
+    std::string seclabel;
+    std::optional<CapSet> capabilities;
+};
+
+// Runs in the child after fork: enters namespaces, publishes |descriptors|, joins cgroups, sets
+// the process attributes, SELinux context and capabilities, then execs the service.
+[[noreturn]] void SetUpAndExecService(const ServiceExecInfo& info,
+                                      const std::vector<Descriptor>& descriptors);
+
+// The service spawner is a small helper process that init starts by exec'ing a new copy of itself,
+// so it has none of the address space that init grows by parsing its configuration, and no other
+// threads.  Init hands it a description of each service to start and it forks the service with
+// CLONE_PARENT, so that forking is cheap and the service is still a child of init that init reaps
+// as usual.
+class ServiceSpawner {
+  public:
+    ServiceSpawner() : pid_(0) { Fork(); }
+
+    // Starts a process for |info| and returns its pid.  Fails if the spawner is not usable or does
+    // not reply in time.  |may_have_started| is set if the spawner got the request but its reply
+    // was lost, so the service may be running untracked; the caller must not fork another copy
+    // then, but may fork the service itself after any other failure.
+    Result<pid_t> Spawn(const ServiceExecInfo& info, const std::vector<Descriptor>& descriptors,
+                        bool* may_have_started);
+
+    pid_t pid() const { return pid_; }
+
+  private:
+    void Fork();
+    void Kill();
+
+    pid_t pid_;
+    android::base::unique_fd socket_;
+};
+
+// Entry point of the spawner process, run as 'init service_spawner <fd>'.
+int ServiceSpawnerMain(int argc, char** argv);
+
+// Starts the spawner if it is enabled with androidboot.init_spawner=true.
+void InitializeServiceSpawner();
+ServiceSpawner* GetServiceSpawner();
+bool ServiceSpawnerChildReap(pid_t pid);
+
+}  // namespace init
+}  // namespace android
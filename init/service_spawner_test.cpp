@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "service_spawner.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace init {
+
+static ServiceExecInfo ShellServiceInfo(const std::string& command) {
+    auto info = ServiceExecInfo{};
+    info.name = "spawner_test";
+    info.args = {"/system/bin/sh", "-c", command};
+    info.namespaces.flags = 0;
+    info.proc_attr = ProcessAttributes{.ioprio_class = IoSchedClass_NONE,
+                                       .ioprio_pri = 0,
+                                       .uid = 0,
+                                       .gid = 0,
+                                       .priority = 0,
+                                       .stdio_to_kmsg = false};
+    return info;
+}
+
+TEST(service_spawner, SpawnsChildOfCaller) {
+    if (getuid() != 0) {
+        GTEST_SKIP() << "Skipping test, must be run as root.";
+        return;
+    }
+
+    auto spawner = ServiceSpawner();
+    ASSERT_GT(spawner.pid(), 0);
+
+    // The service sees both the environment of its caller and its own environment variables.
+    setenv("SPAWNER_TEST_INHERITED", "7", 1);
+    auto info = ShellServiceInfo("exit $$((SPAWNER_TEST_INHERITED + SPAWNER_TEST_SET))");
+    info.environment_vars.emplace_back("SPAWNER_TEST_SET", "35");
+    bool may_have_started;
+    auto pid = spawner.Spawn(info, {}, &may_have_started);
+    unsetenv("SPAWNER_TEST_INHERITED");
+    ASSERT_TRUE(pid.ok()) << pid.error();
+    EXPECT_NE(spawner.pid(), *pid);
+
+    // The service is a child of the caller, not of the spawner.
+    int status;
+    ASSERT_EQ(*pid, TEMP_FAILURE_RETRY(waitpid(*pid, &status, 0)));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(42, WEXITSTATUS(status));
+
+    kill(spawner.pid(), SIGKILL);
+    waitpid(spawner.pid(), nullptr, 0);
+}
+
+TEST(service_spawner, FailsOnceSpawnerIsGone) {
+    auto spawner = ServiceSpawner();
+    ASSERT_GT(spawner.pid(), 0);
+
+    kill(spawner.pid(), SIGKILL);
+    ASSERT_EQ(spawner.pid(), TEMP_FAILURE_RETRY(waitpid(spawner.pid(), nullptr, 0)));
+
+    // Nothing can have been started, so the caller is free to fork the service itself.
+    bool may_have_started = true;
+    EXPECT_FALSE(spawner.Spawn(ShellServiceInfo("exit 0"), {}, &may_have_started).ok());
+    EXPECT_FALSE(may_have_started);
+    EXPECT_FALSE(spawner.Spawn(ShellServiceInfo("exit 0"), {}, &may_have_started).ok());
+    EXPECT_FALSE(may_have_started);
+}
+
+TEST(service_spawner, TimesOutOnStuckSpawner) {
+    auto spawner = ServiceSpawner();
+    ASSERT_GT(spawner.pid(), 0);
+
+    // A stopped spawner never replies, which must not block the caller forever.
+    kill(spawner.pid(), SIGSTOP);
+    bool may_have_started = false;
+    auto pid = spawner.Spawn(ShellServiceInfo("exit 0"), {}, &may_have_started);
+    ASSERT_FALSE(pid.ok());
+    EXPECT_NE(std::string::npos, pid.error().message().find("Timed out")) << pid.error();
+    // The request was sent, so the service may be running and must not be forked again.
+    EXPECT_TRUE(may_have_started);
+
+    // The spawner is killed on the timeout, so further requests fail straight away.
+    ASSERT_EQ(spawner.pid(), TEMP_FAILURE_RETRY(waitpid(spawner.pid(), nullptr, 0)));
+    EXPECT_FALSE(spawner.Spawn(ShellServiceInfo("exit 0"), {}, &may_have_started).ok());
+    EXPECT_FALSE(may_have_started);
+}
+
+}  // namespace init
+}  // namespace android
@@ -37,6 +37,9 @@ class Descriptor {
 
     void Publish() const;
 
+    const std::string& name() const { return name_; }
+    int fd() const { return fd_.get(); }
+
   private:
     std::string name_;
     android::base::unique_fd fd_;
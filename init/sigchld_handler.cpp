@@ -33,6 +33,7 @@
 #include "init.h"
 #include "service.h"
 #include "service_list.h"
+#include "service_spawner.h"
 
 using android::base::boot_clock;
 using android::base::make_scope_guard;
@@ -66,6 +67,8 @@ static pid_t ReapOneProcess() {
 
     if (SubcontextChildReap(pid)) {
         name = "Subcontext";
+    } else if (ServiceSpawnerChildReap(pid)) {
+        name = "Service spawner";
     } else {
         service = ServiceList::GetInstance().FindService(pid, &Service::pid);
 
@@ -20,6 +20,7 @@
 #include <poll.h>
 #include <unistd.h>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -40,6 +41,7 @@
 #include "host_init_stubs.h"
 #endif
 
+using android::base::boot_clock;
 using android::base::GetExecutablePath;
 using android::base::Join;
 using android::base::Socketpair;
@@ -51,6 +53,11 @@ namespace android {
 namespace init {
 namespace {
 
+// A batch reply stops taking results once it is within this many bytes of kBufferSize, and the
+// errors in it are truncated so that the last result always fits.
+constexpr size_t kBatchReplyReserve = 1024;
+constexpr size_t kMaxBatchErrorSize = 512;
+
 std::string shutdown_command;
 static bool subcontext_terminated_by_shutdown;
 static std::unique_ptr<Subcontext> subcontext;
@@ -62,18 +69,19 @@ class SubcontextProcess {
     void MainLoop();
 
   private:
-    void RunCommand(const SubcontextCommand::ExecuteCommand& execute_command,
-                    SubcontextReply* reply) const;
+    Result<void> RunCommand(const SubcontextCommand::ExecuteCommand& execute_command) const;
     void ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
                     SubcontextReply* reply) const;
+    void RunBatch(const SubcontextCommand::ExecuteBatchCommand& execute_batch_command,
+                  SubcontextReply* reply) const;
 
     const BuiltinFunctionMap* function_map_;
     const std::string context_;
     const int init_fd_;
 };
 
-void SubcontextProcess::RunCommand(const SubcontextCommand::ExecuteCommand& execute_command,
-                                   SubcontextReply* reply) const {
+Result<void> SubcontextProcess::RunCommand(
+        const SubcontextCommand::ExecuteCommand& execute_command) const {
     // Need to use ArraySplice instead of this code.
     auto args = std::vector<std::string>();
     for (const auto& string : execute_command.args()) {
@@ -81,20 +89,10 @@ void SubcontextProcess::RunCommand(const SubcontextCommand::ExecuteCommand& exec
     }
 
     auto map_result = function_map_->Find(args);
-    Result<void> result;
     if (!map_result.ok()) {
-        result = Error() << "Cannot find command: " << map_result.error();
-    } else {
-        result = RunBuiltinFunction(map_result->function, args, context_);
-    }
-
-    if (result.ok()) {
-        reply->set_success(true);
-    } else {
-        auto* failure = reply->mutable_failure();
-        failure->set_error_string(result.error().message());
-        failure->set_error_errno(result.error().code());
+        return Error() << "Cannot find command: " << map_result.error();
     }
+    return RunBuiltinFunction(map_result->function, args, context_);
 }
 
 void SubcontextProcess::ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
@@ -113,6 +111,32 @@ void SubcontextProcess::ExpandArgs(const SubcontextCommand::ExpandArgsCommand& e
     }
 }
 
+void SubcontextProcess::RunBatch(const SubcontextCommand::ExecuteBatchCommand& execute_batch_command,
+                                 SubcontextReply* reply) const {
+    auto* batch_reply = reply->mutable_execute_batch_reply();
+    for (const auto& execute_command : execute_batch_command.commands()) {
+        if (reply->ByteSizeLong() + kBatchReplyReserve > kBufferSize) {
+            break;
+        }
+
+        auto* command_result = batch_reply->add_results();
+        command_result->set_start_ns(boot_clock::now().time_since_epoch().count());
+        auto result = RunCommand(execute_command);
+        command_result->set_end_ns(boot_clock::now().time_since_epoch().count());
+
+        if (!result.ok()) {
+            auto* failure = command_result->mutable_failure();
+            failure->set_error_string(result.error().message().substr(0, kMaxBatchErrorSize));
+            failure->set_error_errno(result.error().code());
+        }
+
+        // Init handles a shutdown before it runs anything else.
+        if (!shutdown_command.empty()) {
+            break;
+        }
+    }
+}
+
 void SubcontextProcess::MainLoop() {
     pollfd ufd[1];
     ufd[0].events = POLLIN;
@@ -145,13 +169,23 @@ void SubcontextProcess::MainLoop() {
         auto reply = SubcontextReply();
         switch (subcontext_command.command_case()) {
             case SubcontextCommand::kExecuteCommand: {
-                RunCommand(subcontext_command.execute_command(), &reply);
+                if (auto result = RunCommand(subcontext_command.execute_command()); result.ok()) {
+                    reply.set_success(true);
+                } else {
+                    auto* failure = reply.mutable_failure();
+                    failure->set_error_string(result.error().message());
+                    failure->set_error_errno(result.error().code());
+                }
                 break;
             }
             case SubcontextCommand::kExpandArgsCommand: {
                 ExpandArgs(subcontext_command.expand_args_command(), &reply);
                 break;
             }
+            case SubcontextCommand::kExecuteBatchCommand: {
+                RunBatch(subcontext_command.execute_batch_command(), &reply);
+                break;
+            }
             default:
                 LOG(FATAL) << "Unknown message type from init: "
                            << subcontext_command.command_case();
@@ -168,6 +202,57 @@ void SubcontextProcess::MainLoop() {
     }
 }
 
+SubcontextCommand BuildBatchCommand(const std::vector<std::vector<std::string>>& commands) {
+    auto subcontext_command = SubcontextCommand{};
+    auto* batch = subcontext_command.mutable_execute_batch_command();
+    for (const auto& args : commands) {
+        auto* execute_command = batch->add_commands();
+        std::copy(args.begin(), args.end(),
+                  RepeatedPtrFieldBackInserter(execute_command->mutable_args()));
+        // The commands that do not fit are left for the next batch.  A single command that is too
+        // large is still sent, so that it fails the same way it would on its own.
+        if (batch->commands_size() > 1 && subcontext_command.ByteSizeLong() > kBufferSize) {
+            batch->mutable_commands()->RemoveLast();
+            break;
+        }
+    }
+    return subcontext_command;
+}
+
+std::vector<SubcontextCommandResult> ToBatchResults(const Result<SubcontextReply>& subcontext_reply,
+                                                    boot_clock::time_point start) {
+    auto failed = [start](Result<void> error) {
+        return std::vector<SubcontextCommandResult>{{std::move(error), start, boot_clock::now()}};
+    };
+
+    if (!subcontext_reply.ok()) {
+        return failed(ResultError(subcontext_reply.error()));
+    }
+
+    if (subcontext_reply->reply_case() == SubcontextReply::kFailure) {
+        auto& failure = subcontext_reply->failure();
+        return failed(ResultError(failure.error_string(), failure.error_errno()));
+    }
+
+    if (subcontext_reply->reply_case() != SubcontextReply::kExecuteBatchReply ||
+        subcontext_reply->execute_batch_reply().results_size() == 0) {
+        return failed(Error() << "Unexpected message type from subcontext: "
+                              << subcontext_reply->reply_case());
+    }
+
+    auto results = std::vector<SubcontextCommandResult>{};
+    for (const auto& command_result : subcontext_reply->execute_batch_reply().results()) {
+        auto& result = results.emplace_back();
+        if (command_result.has_failure()) {
+            auto& failure = command_result.failure();
+            result.result = ResultError(failure.error_string(), failure.error_errno());
+        }
+        result.start = boot_clock::time_point(std::chrono::nanoseconds(command_result.start_ns()));
+        result.end = boot_clock::time_point(std::chrono::nanoseconds(command_result.end_ns()));
+    }
+    return results;
+}
+
 }  // namespace
 
 int SubcontextMain(int argc, char** argv, const BuiltinFunctionMap* function_map) {
@@ -225,6 +310,15 @@ void Subcontext::Fork() {
         subcontext_socket.reset();
         pid_ = result;
         LOG(INFO) << "Forked subcontext for '" << context_ << "' with pid " << pid_;
+
+        if (epoll_) {
+            if (auto registered = epoll_->RegisterHandler(socket_, [this] { HandleSocketReadable(); });
+                registered.ok()) {
+                socket_registered_ = true;
+            } else {
+                LOG(ERROR) << "Could not watch the subcontext socket: " << registered.error();
+            }
+        }
     }
 }
 
@@ -234,8 +328,19 @@ void Subcontext::Restart() {
         kill(pid_, SIGKILL);
     }
     pid_ = 0;
+    if (socket_registered_) {
+        epoll_->UnregisterHandler(socket_);
+        socket_registered_ = false;
+    }
     socket_.reset();
     Fork();
+
+    if (pending_batch_callback_) {
+        auto callback = std::move(pending_batch_callback_);
+        pending_batch_callback_ = nullptr;
+        callback({{Error() << "Subcontext restarted while running a batch", pending_batch_start_,
+                   boot_clock::now()}});
+    }
 }
 
 bool Subcontext::PathMatchesSubcontext(const std::string& path) {
@@ -248,11 +353,20 @@ bool Subcontext::PathMatchesSubcontext(const std::string& path) {
 }
 
 Result<SubcontextReply> Subcontext::TransmitMessage(const SubcontextCommand& subcontext_command) {
+    // The subcontext replies in order, so the reply to a batch still in flight comes first.
+    if (pending_batch_callback_) {
+        FinishPendingBatch();
+    }
+
     if (auto result = SendMessage(socket_, subcontext_command); !result.ok()) {
         Restart();
         return ErrnoError() << "Failed to send message to subcontext";
     }
 
+    return ReceiveReply();
+}
+
+Result<SubcontextReply> Subcontext::ReceiveReply() {
     auto subcontext_message = ReadMessage(socket_);
     if (!subcontext_message.ok()) {
         Restart();
@@ -325,10 +439,52 @@ Result<std::vector<std::string>> Subcontext::ExpandArgs(const std::vector<std::s
     return expanded_args;
 }
 
-void InitializeSubcontext() {
+std::vector<SubcontextCommandResult> Subcontext::ExecuteBatch(
+        const std::vector<std::vector<std::string>>& commands) {
+    auto start = boot_clock::now();
+    return ToBatchResults(TransmitMessage(BuildBatchCommand(commands)), start);
+}
+
+Result<void> Subcontext::ExecuteBatchAsync(const std::vector<std::vector<std::string>>& commands,
+                                           BatchCallback callback) {
+    if (!socket_registered_) {
+        return Error() << "Subcontext socket is not being watched";
+    }
+    if (pending_batch_callback_) {
+        return Error() << "Subcontext is already running a batch";
+    }
+
+    if (auto result = SendMessage(socket_, BuildBatchCommand(commands)); !result.ok()) {
+        return result.error();
+    }
+    pending_batch_start_ = boot_clock::now();
+    pending_batch_callback_ = std::move(callback);
+    return {};
+}
+
+void Subcontext::HandleSocketReadable() {
+    if (pending_batch_callback_) {
+        FinishPendingBatch();
+        return;
+    }
+
+    // Nothing was asked of the subcontext, so it has exited.  Stop watching its socket, which
+    // would otherwise wake up the epoll loop for the end of file until the subcontext is restarted.
+    epoll_->UnregisterHandler(socket_);
+    socket_registered_ = false;
+}
+
+void Subcontext::FinishPendingBatch() {
+    auto callback = std::move(pending_batch_callback_);
+    pending_batch_callback_ = nullptr;
+    auto subcontext_reply = ReceiveReply();
+    callback(ToBatchResults(subcontext_reply, pending_batch_start_));
+}
+
+void InitializeSubcontext(Epoll* epoll) {
     if (SelinuxGetVendorAndroidVersion() >= __ANDROID_API_P__) {
-        subcontext.reset(
-                new Subcontext(std::vector<std::string>{"/vendor", "/odm"}, kVendorContext));
+        subcontext.reset(new Subcontext(std::vector<std::string>{"/vendor", "/odm"},
+                                        kVendorContext, epoll));
     }
 }
 
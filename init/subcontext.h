@@ -18,12 +18,15 @@
 
 #include <signal.h>
 
+#include <functional>
 #include <string>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/unique_fd.h>
 
 #include "builtins.h"
+#include "epoll.h"
 #include "result.h"
 #include "system/core/init/subcontext.pb.h"
 
@@ -34,15 +37,42 @@ static constexpr const char kInitContext[] = "u:r:init:s0";
 static constexpr const char kVendorContext[] = "u:r:vendor_init:s0";
 static constexpr const char kTestContext[] = "test-test-test";
 
+// The outcome of one command of a batch run in a subcontext.
+struct SubcontextCommandResult {
+    Result<void> result;
+    android::base::boot_clock::time_point start;
+    android::base::boot_clock::time_point end;
+};
+
 class Subcontext {
   public:
-    Subcontext(std::vector<std::string> path_prefixes, std::string context)
-        : path_prefixes_(std::move(path_prefixes)), context_(std::move(context)), pid_(0) {
+    using BatchCallback = std::function<void(std::vector<SubcontextCommandResult>)>;
+
+    // If |epoll| is given, the subcontext's socket is watched with it so that batches can be run
+    // without blocking with ExecuteBatchAsync().
+    Subcontext(std::vector<std::string> path_prefixes, std::string context,
+               Epoll* epoll = nullptr)
+        : path_prefixes_(std::move(path_prefixes)),
+          context_(std::move(context)),
+          pid_(0),
+          epoll_(epoll) {
         Fork();
     }
 
     Result<void> Execute(const std::vector<std::string>& args);
     Result<std::vector<std::string>> ExpandArgs(const std::vector<std::string>& args);
+    // Runs |commands| one after the other with a single round trip to the subcontext.  Returns
+    // one result per command that ran, in order, which may be fewer than were given if the batch
+    // did not fit into one message or a command triggered a shutdown; the caller sends the rest
+    // again.  If the subcontext could not be reached, the first command is reported as failed.
+    std::vector<SubcontextCommandResult> ExecuteBatch(
+            const std::vector<std::vector<std::string>>& commands);
+    // Like ExecuteBatch(), but returns as soon as the batch is sent, and |callback| is called with
+    // the results from the epoll loop once they arrive.  Only one batch can be in flight, and any
+    // other call waits for it first.  Fails if the batch cannot be sent this way, in which case
+    // the caller should use ExecuteBatch() instead.
+    Result<void> ExecuteBatchAsync(const std::vector<std::vector<std::string>>& commands,
+                                   BatchCallback callback);
     void Restart();
     bool PathMatchesSubcontext(const std::string& path);
 
@@ -52,15 +82,22 @@ class Subcontext {
   private:
     void Fork();
     Result<SubcontextReply> TransmitMessage(const SubcontextCommand& subcontext_command);
+    Result<SubcontextReply> ReceiveReply();
+    void HandleSocketReadable();
+    void FinishPendingBatch();
 
     std::vector<std::string> path_prefixes_;
     std::string context_;
     pid_t pid_;
     android::base::unique_fd socket_;
+    Epoll* epoll_;
+    bool socket_registered_ = false;
+    BatchCallback pending_batch_callback_;
+    android::base::boot_clock::time_point pending_batch_start_;
 };
 
 int SubcontextMain(int argc, char** argv, const BuiltinFunctionMap* function_map);
-void InitializeSubcontext();
+void InitializeSubcontext(Epoll* epoll);
 Subcontext* GetSubcontext();
 bool SubcontextChildReap(pid_t pid);
 void SubcontextTerminate();
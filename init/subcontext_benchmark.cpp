@@ -16,38 +16,94 @@
 
 #include "subcontext.h"
 
+#include <memory>
+
 #include <benchmark/benchmark.h>
 #include <selinux/selinux.h>
 
 namespace android {
 namespace init {
 
-static void BenchmarkSuccess(benchmark::State& state) {
+static std::unique_ptr<Subcontext> StartBenchmarkSubcontext(benchmark::State& state) {
     if (getuid() != 0) {
         state.SkipWithError("Skipping benchmark, must be run as root.");
-        return;
+        return nullptr;
     }
     char* context;
     if (getcon(&context) != 0) {
         state.SkipWithError("getcon() failed");
-        return;
+        return nullptr;
     }
 
-    auto subcontext = Subcontext({"path"}, context);
+    auto subcontext = std::make_unique<Subcontext>(std::vector<std::string>{"path"}, context);
     free(context);
+    return subcontext;
+}
 
-    while (state.KeepRunning()) {
-        subcontext.Execute(std::vector<std::string>{"return_success"});
+static void StopBenchmarkSubcontext(Subcontext* subcontext) {
+    if (subcontext->pid() > 0) {
+        kill(subcontext->pid(), SIGTERM);
+        kill(subcontext->pid(), SIGKILL);
     }
+}
 
-    if (subcontext.pid() > 0) {
-        kill(subcontext.pid(), SIGTERM);
-        kill(subcontext.pid(), SIGKILL);
+static void BenchmarkSuccess(benchmark::State& state) {
+    auto subcontext = StartBenchmarkSubcontext(state);
+    if (!subcontext) return;
+
+    while (state.KeepRunning()) {
+        subcontext->Execute(std::vector<std::string>{"return_success"});
     }
+
+    StopBenchmarkSubcontext(subcontext.get());
 }
 
 BENCHMARK(BenchmarkSuccess);
 
+// An action with |state.range(0)| commands that run in the subcontext, one round trip each.
+static void BenchmarkActionOneByOne(benchmark::State& state) {
+    auto subcontext = StartBenchmarkSubcontext(state);
+    if (!subcontext) return;
+
+    const auto args = std::vector<std::string>{"return_success"};
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); ++i) {
+            subcontext->Execute(args);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+
+    StopBenchmarkSubcontext(subcontext.get());
+}
+
+BENCHMARK(BenchmarkActionOneByOne)->Arg(1)->Arg(10)->Arg(50);
+
+// The same action sent as batches, which takes one round trip unless it does not fit into one
+// message.
+static void BenchmarkActionBatched(benchmark::State& state) {
+    auto subcontext = StartBenchmarkSubcontext(state);
+    if (!subcontext) return;
+
+    const auto commands =
+            std::vector<std::vector<std::string>>(state.range(0), {"return_success"});
+    int64_t round_trips = 0;
+    for (auto _ : state) {
+        for (size_t done = 0; done < commands.size(); ++round_trips) {
+            done += subcontext
+                            ->ExecuteBatch(std::vector<std::vector<std::string>>(
+                                    commands.begin() + done, commands.end()))
+                            .size();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+    state.counters["round_trips"] =
+            benchmark::Counter(round_trips, benchmark::Counter::kAvgIterations);
+
+    StopBenchmarkSubcontext(subcontext.get());
+}
+
+BENCHMARK(BenchmarkActionBatched)->Arg(1)->Arg(10)->Arg(50);
+
 BuiltinFunctionMap BuildTestFunctionMap() {
     auto function = [](const BuiltinArguments& args) { return Result<void>{}; };
     BuiltinFunctionMap test_function_map = {
@@ -19,6 +19,7 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <optional>
 
 #include <android-base/properties.h>
 #include <android-base/strings.h>
@@ -148,6 +149,88 @@ TEST(subcontext, TriggerShutdown) {
     EXPECT_EQ(kTestShutdownCommand, trigger_shutdown_command);
 }
 
+TEST(subcontext, ExecuteBatch) {
+    RunTest([](auto& subcontext) {
+        auto first_pid = subcontext.pid();
+
+        auto commands = std::vector<std::vector<std::string>>{
+                {"add_word", "batched"},
+                {"add_word", "words"},
+                {"return_words_as_error"},
+                {"generate_sane_error"},
+                {"add_word", "after_errors"},
+        };
+        auto results = subcontext.ExecuteBatch(commands);
+
+        // Every command ran in order, and a failing one did not stop the ones after it.
+        ASSERT_EQ(commands.size(), results.size());
+        EXPECT_RESULT_OK(results[0].result);
+        EXPECT_RESULT_OK(results[1].result);
+        ASSERT_FALSE(results[2].result.ok());
+        EXPECT_EQ("batched words", results[2].result.error().message());
+        ASSERT_FALSE(results[3].result.ok());
+        EXPECT_EQ("Sane error!", results[3].result.error().message());
+        EXPECT_RESULT_OK(results[4].result);
+        for (size_t i = 1; i < results.size(); ++i) {
+            EXPECT_LE(results[i - 1].end, results[i].start);
+        }
+        EXPECT_EQ(first_pid, subcontext.pid());
+    });
+}
+
+TEST(subcontext, ExecuteBatchStopsAtShutdown) {
+    static constexpr const char kTestShutdownCommand[] = "reboot,test-batch-shutdown";
+    static std::string trigger_shutdown_command;
+    trigger_shutdown = [](const std::string& command) { trigger_shutdown_command = command; };
+    RunTest([](auto& subcontext) {
+        auto results = subcontext.ExecuteBatch(std::vector<std::vector<std::string>>{
+                {"trigger_shutdown", kTestShutdownCommand},
+                {"generate_sane_error"},
+        });
+        ASSERT_EQ(1U, results.size());
+        EXPECT_RESULT_OK(results[0].result);
+    });
+    EXPECT_EQ(kTestShutdownCommand, trigger_shutdown_command);
+}
+
+TEST(subcontext, ExecuteBatchAsync) {
+    Epoll epoll;
+    ASSERT_RESULT_OK(epoll.Open());
+    auto subcontext = Subcontext({"dummy_path"}, kTestContext, &epoll);
+    ASSERT_NE(0, subcontext.pid());
+
+    std::optional<std::vector<SubcontextCommandResult>> results;
+    auto commands = std::vector<std::vector<std::string>>{
+            {"generate_sane_error"},
+            {"return_context_as_error"},
+    };
+    ASSERT_RESULT_OK(subcontext.ExecuteBatchAsync(
+            commands, [&results](auto batch_results) { results = std::move(batch_results); }));
+    // Only one batch can be in flight.
+    EXPECT_FALSE(subcontext.ExecuteBatchAsync(commands, [](auto) {}).ok());
+
+    while (!results) {
+        auto pending_functions = epoll.Wait(10s);
+        ASSERT_RESULT_OK(pending_functions);
+        ASSERT_FALSE(pending_functions->empty());
+        for (const auto& function : *pending_functions) {
+            (*function)();
+        }
+    }
+
+    ASSERT_EQ(2U, results->size());
+    EXPECT_EQ("Sane error!", results->at(0).result.error().message());
+    EXPECT_EQ(kTestContext, results->at(1).result.error().message());
+
+    // A synchronous command after an asynchronous batch gets its own reply.
+    auto result = subcontext.Execute(std::vector<std::string>{"generate_sane_error"});
+    ASSERT_FALSE(result.ok());
+    EXPECT_EQ("Sane error!", result.error().message());
+
+    kill(subcontext.pid(), SIGTERM);
+    kill(subcontext.pid(), SIGKILL);
+}
+
 TEST(subcontext, ExpandArgs) {
     RunTest([](auto& subcontext) {
         auto args = std::vector<std::string>{
@@ -21,7 +21,11 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <cutils/uevent.h>
@@ -125,29 +129,39 @@ ReadUeventResult UeventListener::ReadUevent(Uevent* uevent) const {
 // make sure we don't overrun the socket's buffer.
 //
 
+static bool TriggerUevent(int dfd) {
+    int fd = openat(dfd, "uevent", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    write(fd, "add\n", 4);
+    close(fd);
+    return true;
+}
+
+ListenerAction UeventListener::DrainUevents(const ListenerCallback& callback) const {
+    Uevent uevent;
+    ReadUeventResult result;
+    while ((result = ReadUevent(&uevent)) != ReadUeventResult::kFailed) {
+        // Skip processing the uevent if it is invalid.
+        if (result == ReadUeventResult::kInvalid) continue;
+        if (callback(uevent) == ListenerAction::kStop) return ListenerAction::kStop;
+    }
+    return ListenerAction::kContinue;
+}
+
 ListenerAction UeventListener::RegenerateUeventsForDir(DIR* d,
                                                        const ListenerCallback& callback) const {
     int dfd = dirfd(d);
 
-    int fd = openat(dfd, "uevent", O_WRONLY | O_CLOEXEC);
-    if (fd >= 0) {
-        write(fd, "add\n", 4);
-        close(fd);
-
-        Uevent uevent;
-        ReadUeventResult result;
-        while ((result = ReadUevent(&uevent)) != ReadUeventResult::kFailed) {
-            // Skip processing the uevent if it is invalid.
-            if (result == ReadUeventResult::kInvalid) continue;
-            if (callback(uevent) == ListenerAction::kStop) return ListenerAction::kStop;
-        }
+    if (TriggerUevent(dfd) && DrainUevents(callback) == ListenerAction::kStop) {
+        return ListenerAction::kStop;
     }
 
     dirent* de;
     while ((de = readdir(d)) != nullptr) {
         if (de->d_type != DT_DIR || de->d_name[0] == '.') continue;
 
-        fd = openat(dfd, de->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        int fd = openat(dfd, de->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
         if (fd < 0) continue;
 
         std::unique_ptr<DIR, decltype(&closedir)> d2(fdopendir(fd), closedir);
@@ -180,6 +194,78 @@ void UeventListener::RegenerateUevents(const ListenerCallback& callback) const {
     }
 }
 
+// Writing to a uevent file is slow, as the kernel has to ask the driver to build the uevent, so the
+// parallel walk lets several threads do that at once.  The netlink socket is only ever drained
+// under |callback_lock|, which keeps the callback serialized and the uevents in kernel order.
+// Directories are handed out one at a time from a shared stack, so a thread that finishes a small
+// subtree picks up part of a larger one instead of going idle.
+void UeventListener::RegenerateUeventsParallel(const ListenerCallback& callback,
+                                               unsigned int num_threads) const {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::string> pending;
+    unsigned int busy = 0;
+    bool stop = false;
+
+    std::mutex callback_lock;
+
+    for (auto it = std::rbegin(kRegenerationPaths); it != std::rend(kRegenerationPaths); ++it) {
+        pending.emplace_back(*it);
+    }
+
+    auto visit = [&](const std::string& path, std::vector<std::string>* subdirs) {
+        std::unique_ptr<DIR, decltype(&closedir)> d(opendir(path.c_str()), closedir);
+        if (!d) return ListenerAction::kContinue;
+
+        if (TriggerUevent(dirfd(d.get()))) {
+            std::lock_guard<std::mutex> guard(callback_lock);
+            if (DrainUevents(callback) == ListenerAction::kStop) return ListenerAction::kStop;
+        }
+
+        dirent* de;
+        while ((de = readdir(d.get())) != nullptr) {
+            if (de->d_type != DT_DIR || de->d_name[0] == '.') continue;
+            subdirs->emplace_back(path + "/" + de->d_name);
+        }
+        return ListenerAction::kContinue;
+    };
+
+    auto worker = [&] {
+        std::vector<std::string> subdirs;
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            cv.wait(guard, [&] { return stop || !pending.empty() || busy == 0; });
+            // With nothing pending and nobody busy, nothing more can be pushed.
+            if (stop || pending.empty()) break;
+
+            std::string path = std::move(pending.back());
+            pending.pop_back();
+            ++busy;
+            guard.unlock();
+
+            subdirs.clear();
+            auto action = visit(path, &subdirs);
+
+            guard.lock();
+            --busy;
+            if (action == ListenerAction::kStop) stop = true;
+            // Push in reverse so that the stack pops them in directory order.
+            pending.insert(pending.end(), std::make_move_iterator(subdirs.rbegin()),
+                           std::make_move_iterator(subdirs.rend()));
+            if (stop || !subdirs.empty() || busy == 0) cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 void UeventListener::Poll(const ListenerCallback& callback,
                           const std::optional<std::chrono::milliseconds> relative_timeout) const {
     using namespace std::chrono;
@@ -50,6 +50,11 @@ class UeventListener {
     UeventListener(size_t uevent_socket_rcvbuf_size);
 
     void RegenerateUevents(const ListenerCallback& callback) const;
+    // Like RegenerateUevents(), but walks /sys on |num_threads| threads that share one queue of
+    // directories to visit.  |callback| is never called concurrently and sees uevents in the
+    // order the kernel sent them, so a device's uevent still comes before its children's.
+    void RegenerateUeventsParallel(const ListenerCallback& callback,
+                                   unsigned int num_threads) const;
     ListenerAction RegenerateUeventsForPath(const std::string& path,
                                             const ListenerCallback& callback) const;
     void Poll(const ListenerCallback& callback,
@@ -57,6 +62,7 @@ class UeventListener {
 
   private:
     ReadUeventResult ReadUevent(Uevent* uevent) const;
+    ListenerAction DrainUevents(const ListenerCallback& callback) const;
     ListenerAction RegenerateUeventsForDir(DIR* d, const ListenerCallback& callback) const;
 
     android::base::unique_fd device_fd_;
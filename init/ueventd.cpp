@@ -23,10 +23,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <set>
 #include <thread>
 
@@ -84,12 +86,13 @@
 // once that has completed, restorecon is done for each device as its uevent is handled.
 
 // With all of the above considered, the cold boot process has the below steps:
-// 1) ueventd regenerates uevents by doing the /sys traversal and listens to the netlink socket for
-//    the generated uevents.  It writes these uevents into a queue represented by a vector.
+// 1) ueventd regenerates uevents by doing the /sys traversal on 'n' threads and listens to the
+//    netlink socket for the generated uevents.  It writes these uevents into a queue represented by
+//    a vector.
 //
-// 2) ueventd forks 'n' separate uevent handler subprocesses and has each of them to handle the
-//    uevents in the queue based on a starting offset (their process number) and a stride (the total
-//    number of processes).  Note that no IPC happens at this point and only const functions from
+// 2) ueventd forks 'n' separate uevent handler subprocesses, which repeatedly claim the next
+//    unhandled uevent in the queue through a counter in shared memory until the queue is empty.
+//    Apart from that counter, no IPC happens at this point and only const functions from
 //    DeviceHandler should be called from this context.
 //
 // 3) In parallel to the subprocesses handling the uevents, the main thread of ueventd calls
@@ -123,11 +126,21 @@ class ColdBoot {
     void Run();
 
   private:
-    void UeventHandlerMain(unsigned int process_num, unsigned int total_processes);
+    // The index of the next uevent and restorecon directory to be handled.  This lives in memory
+    // shared with the subprocesses, which each claim one item at a time, so a subprocess that gets
+    // cheap items keeps taking more instead of idling while another handles an expensive one.
+    struct WorkQueue {
+        std::atomic<size_t> next_uevent;
+        std::atomic<size_t> next_restorecon;
+    };
+    static_assert(std::atomic<size_t>::is_always_lock_free,
+                  "WorkQueue must be usable from multiple processes");
+
+    void UeventHandlerMain();
     void RegenerateUevents();
     void ForkSubProcesses();
     void WaitForSubProcesses();
-    void RestoreConHandler(unsigned int process_num, unsigned int total_processes);
+    void RestoreConHandler();
     void GenerateRestoreCon(const std::string& directory);
 
     UeventListener& uevent_listener_;
@@ -142,10 +155,14 @@ class ColdBoot {
     std::set<pid_t> subprocess_pids_;
 
     std::vector<std::string> restorecon_queue_;
+
+    WorkQueue* work_queue_ = nullptr;
 };
 
-void ColdBoot::UeventHandlerMain(unsigned int process_num, unsigned int total_processes) {
-    for (unsigned int i = process_num; i < uevent_queue_.size(); i += total_processes) {
+void ColdBoot::UeventHandlerMain() {
+    size_t i;
+    while ((i = work_queue_->next_uevent.fetch_add(1, std::memory_order_relaxed)) <
+           uevent_queue_.size()) {
         auto& uevent = uevent_queue_[i];
 
         for (auto& uevent_handler : uevent_handlers_) {
@@ -154,8 +171,10 @@ void ColdBoot::UeventHandlerMain(unsigned int process_num, unsigned int total_pr
     }
 }
 
-void ColdBoot::RestoreConHandler(unsigned int process_num, unsigned int total_processes) {
-    for (unsigned int i = process_num; i < restorecon_queue_.size(); i += total_processes) {
+void ColdBoot::RestoreConHandler() {
+    size_t i;
+    while ((i = work_queue_->next_restorecon.fetch_add(1, std::memory_order_relaxed)) <
+           restorecon_queue_.size()) {
         auto& dir = restorecon_queue_[i];
 
         selinux_android_restorecon(dir.c_str(), SELINUX_ANDROID_RESTORECON_RECURSE);
@@ -184,7 +203,7 @@ void ColdBoot::GenerateRestoreCon(const std::string& directory) {
 }
 
 void ColdBoot::RegenerateUevents() {
-    uevent_listener_.RegenerateUevents([this](const Uevent& uevent) {
+    uevent_listener_.RegenerateUeventsParallel([this](const Uevent& uevent) {
         for (auto& uevent_handler : uevent_handlers_) {
             if (uevent_handler->IsUeventDeferred(uevent)) {
                 LOG(INFO) << "deferring uevent(action=" << uevent.action << ", modalias=" << uevent.modalias << ")";
@@ -194,10 +213,17 @@ void ColdBoot::RegenerateUevents() {
         }
         uevent_queue_.emplace_back(uevent);
         return ListenerAction::kContinue;
-    });
+    }, num_handler_subprocesses_);
 }
 
 void ColdBoot::ForkSubProcesses() {
+    void* shared = mmap(nullptr, sizeof(WorkQueue), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        PLOG(FATAL) << "mmap() of the coldboot work queue failed";
+    }
+    work_queue_ = new (shared) WorkQueue{0, 0};
+
     for (unsigned int i = 0; i < num_handler_subprocesses_; ++i) {
         auto pid = fork();
         if (pid < 0) {
@@ -205,9 +231,9 @@ void ColdBoot::ForkSubProcesses() {
         }
 
         if (pid == 0) {
-            UeventHandlerMain(i, num_handler_subprocesses_);
+            UeventHandlerMain();
             if (enable_parallel_restorecon_) {
-                RestoreConHandler(i, num_handler_subprocesses_);
+                RestoreConHandler();
             }
             _exit(EXIT_SUCCESS);
         }
@@ -247,21 +273,31 @@ void ColdBoot::WaitForSubProcesses() {
             LOG(FATAL) << "subprocess killed by signal " << WTERMSIG(status);
         }
     }
+
+    munmap(work_queue_, sizeof(WorkQueue));
+    work_queue_ = nullptr;
 }
 
 void ColdBoot::Run() {
     android::base::Timer cold_boot_timer;
 
+    android::base::Timer phase_timer;
     RegenerateUevents();
+    LOG(INFO) << "Coldboot regenerated " << uevent_queue_.size() << " uevents ("
+              << uevent_deferred_queue_.size() << " deferred) in " << phase_timer;
 
     if (enable_parallel_restorecon_) {
+        phase_timer = android::base::Timer();
         selinux_android_restorecon("/sys", 0);
         selinux_android_restorecon("/sys/devices", 0);
         GenerateRestoreCon("/sys");
         // takes long time for /sys/devices, parallelize it
         GenerateRestoreCon("/sys/devices");
+        LOG(INFO) << "Coldboot queued " << restorecon_queue_.size() << " restorecon directories in "
+                  << phase_timer;
     }
 
+    phase_timer = android::base::Timer();
     ForkSubProcesses();
 
     if (!enable_parallel_restorecon_) {
@@ -269,12 +305,16 @@ void ColdBoot::Run() {
     }
 
     WaitForSubProcesses();
+    LOG(INFO) << "Coldboot handled uevents on " << num_handler_subprocesses_ << " subprocesses in "
+              << phase_timer;
 
+    phase_timer = android::base::Timer();
     for (auto& uevent : uevent_deferred_queue_) {
         for (auto& uevent_handler : uevent_handlers_) {
             uevent_handler->HandleUevent(uevent);
         }
     }
+    LOG(INFO) << "Coldboot handled deferred uevents in " << phase_timer;
 
     android::base::SetProperty(kColdBootDoneProp, "true");
     LOG(INFO) << "Coldboot took " << cold_boot_timer.duration().count() / 1000.0f << " seconds";
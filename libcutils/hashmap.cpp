@@ -19,27 +19,77 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
-typedef struct Entry Entry;
-struct Entry {
+/*
+ * The map uses open addressing with linear probing.  Next to the slots there
+ * is one control byte per slot that is either EMPTY, DELETED or holds 7 bits
+ * of the key's hash.  Probes look at GROUP_SIZE control bytes at a time, so
+ * most lookups check a single word and only touch the slots whose control byte
+ * matches.
+ *
+ * Removal leaves a DELETED marker rather than moving entries, so that
+ * hashmapForEach() callbacks may remove entries while iterating, as they could
+ * with the old chained implementation.  Markers are dropped when the map is
+ * rehashed.
+ */
+
+#if defined(__BYTE_ORDER__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "group probing assumes little endian");
+#endif
+
+static const uint8_t EMPTY = 0x80;
+static const uint8_t DELETED = 0xfe;
+
+typedef uint64_t Group;
+static const size_t GROUP_SIZE = sizeof(Group);
+static const Group LSBS = 0x0101010101010101ULL;
+static const Group MSBS = 0x8080808080808080ULL;
+
+typedef struct Slot Slot;
+struct Slot {
     void* key;
-    int hash;
     void* value;
-    Entry* next;
+    int hash;
 };
 
 struct Hashmap {
-    Entry** buckets;
+    // Both in the same allocation, the control bytes after the slots.  The
+    // first GROUP_SIZE - 1 control bytes are repeated at the end, so that a
+    // group can always be loaded without wrapping around.
+    Slot* slots;
+    uint8_t* control;
     size_t bucketCount;
     int (*hash)(void* key);
     bool (*equals)(void* keyA, void* keyB);
     pthread_mutex_t lock;
     size_t size;
+    // Number of DELETED control bytes.
+    size_t deleted;
 };
 
+/**
+ * Gives the map bucketCount new, empty slots.  Leaves the map untouched if
+ * memory allocation fails.
+ */
+static bool allocateBuckets(Hashmap* map, size_t bucketCount) {
+    size_t controlSize = bucketCount + GROUP_SIZE - 1;
+    Slot* slots = static_cast<Slot*>(malloc(bucketCount * sizeof(Slot) + controlSize));
+    if (slots == NULL) {
+        return false;
+    }
+    map->slots = slots;
+    map->control = reinterpret_cast<uint8_t*>(slots + bucketCount);
+    memset(map->control, EMPTY, controlSize);
+    map->bucketCount = bucketCount;
+    map->size = 0;
+    map->deleted = 0;
+    return true;
+}
+
 Hashmap* hashmapCreate(size_t initialCapacity,
         int (*hash)(void* key), bool (*equals)(void* keyA, void* keyB)) {
     assert(hash != NULL);
@@ -52,20 +102,18 @@ Hashmap* hashmapCreate(size_t initialCapacity,
 
     // 0.75 load factor.
     size_t minimumBucketCount = initialCapacity * 4 / 3;
-    map->bucketCount = 1;
-    while (map->bucketCount <= minimumBucketCount) {
+    // At least one group, so the repeated control bytes never wrap twice.
+    size_t bucketCount = GROUP_SIZE;
+    while (bucketCount <= minimumBucketCount) {
         // Bucket count must be power of 2.
-        map->bucketCount <<= 1;
+        bucketCount <<= 1;
     }
 
-    map->buckets = static_cast<Entry**>(calloc(map->bucketCount, sizeof(Entry*)));
-    if (map->buckets == NULL) {
+    if (!allocateBuckets(map, bucketCount)) {
         free(map);
         return NULL;
     }
 
-    map->size = 0;
-
     map->hash = hash;
     map->equals = equals;
 
@@ -97,34 +145,104 @@ static inline size_t calculateIndex(size_t bucketCount, int hash) {
     return ((size_t) hash) & (bucketCount - 1);
 }
 
+/**
+ * The control byte for a full slot, taken from the top bits of the hash since
+ * the bottom ones pick the slot.
+ */
+static inline uint8_t controlByte(int hash) {
+    return ((unsigned int) hash) >> 25;
+}
+
+static inline void setControl(Hashmap* map, size_t index, uint8_t control) {
+    map->control[index] = control;
+    if (index < GROUP_SIZE - 1) {
+        map->control[map->bucketCount + index] = control;
+    }
+}
+
+static inline Group loadGroup(Hashmap* map, size_t index) {
+    Group group;
+    memcpy(&group, map->control + index, sizeof(group));
+    return group;
+}
+
+/**
+ * Returns a mask with the top bit set in each byte of the group that may equal
+ * control.  There can be false positives, which the caller has to check.
+ */
+static inline Group matchControl(Group group, uint8_t control) {
+    Group x = group ^ (LSBS * control);
+    return (x - LSBS) & ~x & MSBS;
+}
+
+/**
+ * Returns a mask with the top bit set in each EMPTY byte of the group.
+ */
+static inline Group matchEmpty(Group group) {
+    // Only EMPTY has the top bit set and bit 1 clear.
+    return group & ~(group << 6) & MSBS;
+}
+
+/**
+ * Returns a mask with the top bit set in each EMPTY or DELETED byte of the
+ * group.
+ */
+static inline Group matchFree(Group group) {
+    return group & MSBS;
+}
+
+/**
+ * Returns the slot index for the lowest byte set in mask, a group loaded from
+ * index.
+ */
+static inline size_t maskIndex(Hashmap* map, size_t index, Group mask) {
+    return (index + __builtin_ctzll(mask) / 8) & (map->bucketCount - 1);
+}
+
+/**
+ * Returns the index of the first EMPTY or DELETED slot, probing from the
+ * key's home slot.  The map must not be full.
+ */
+static size_t findFree(Hashmap* map, int hash) {
+    size_t index = calculateIndex(map->bucketCount, hash);
+    while (true) {
+        Group free = matchFree(loadGroup(map, index));
+        if (free != 0) {
+            return maskIndex(map, index, free);
+        }
+        index = (index + GROUP_SIZE) & (map->bucketCount - 1);
+    }
+}
+
 static void expandIfNecessary(Hashmap* map) {
-    // If the load factor exceeds 0.75...
-    if (map->size > (map->bucketCount * 3 / 4)) {
-        // Start off with a 0.33 load factor.
-        size_t newBucketCount = map->bucketCount << 1;
-        Entry** newBuckets = static_cast<Entry**>(calloc(newBucketCount, sizeof(Entry*)));
-        if (newBuckets == NULL) {
-            // Abort expansion.
+    // If the load factor, counting deleted slots, exceeds 0.75...
+    if (map->size + map->deleted > (map->bucketCount * 3 / 4)) {
+        // Start off with a 0.33 load factor, or just drop the deleted slots
+        // if that gets us back down to it.
+        size_t newBucketCount = map->bucketCount;
+        if (map->size > map->bucketCount * 3 / 8) {
+            newBucketCount <<= 1;
+        }
+
+        Slot* oldSlots = map->slots;
+        uint8_t* oldControl = map->control;
+        size_t oldBucketCount = map->bucketCount;
+        if (!allocateBuckets(map, newBucketCount)) {
+            // Abort expansion, the map is left untouched.
             return;
         }
 
         // Move over existing entries.
-        size_t i;
-        for (i = 0; i < map->bucketCount; i++) {
-            Entry* entry = map->buckets[i];
-            while (entry != NULL) {
-                Entry* next = entry->next;
-                size_t index = calculateIndex(newBucketCount, entry->hash);
-                entry->next = newBuckets[index];
-                newBuckets[index] = entry;
-                entry = next;
+        for (size_t i = 0; i < oldBucketCount; i++) {
+            if (!(oldControl[i] & EMPTY)) {
+                Slot* slot = &oldSlots[i];
+                size_t index = findFree(map, slot->hash);
+                setControl(map, index, oldControl[i]);
+                map->slots[index] = *slot;
+                map->size++;
             }
         }
-
-        // Copy over internals.
-        free(map->buckets);
-        map->buckets = newBuckets;
-        map->bucketCount = newBucketCount;
+        free(oldSlots);
     }
 }
 
@@ -137,16 +255,7 @@ void hashmapUnlock(Hashmap* map) {
 }
 
 void hashmapFree(Hashmap* map) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry* next = entry->next;
-            free(entry);
-            entry = next;
-        }
-    }
-    free(map->buckets);
+    free(map->slots);
     pthread_mutex_destroy(&map->lock);
     free(map);
 }
@@ -166,18 +275,6 @@ int hashmapHash(void* key, size_t keySize) {
     return h;
 }
 
-static Entry* createEntry(void* key, int hash, void* value) {
-    Entry* entry = static_cast<Entry*>(malloc(sizeof(Entry)));
-    if (entry == NULL) {
-        return NULL;
-    }
-    entry->key = key;
-    entry->hash = hash;
-    entry->value = value;
-    entry->next = NULL;
-    return entry;
-}
-
 static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
         bool (*equals)(void*, void*)) {
     if (keyA == keyB) {
@@ -189,86 +286,106 @@ static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
     return equals(keyA, keyB);
 }
 
-void* hashmapPut(Hashmap* map, void* key, void* value) {
-    int hash = hashKey(map, key);
+/**
+ * Returns the index of the slot holding key, or -1 if it is not in the map.
+ */
+static ssize_t findIndex(Hashmap* map, void* key, int hash) {
     size_t index = calculateIndex(map->bucketCount, hash);
+    uint8_t control = controlByte(hash);
 
-    Entry** p = &(map->buckets[index]);
-    while (true) {
-        Entry* current = *p;
-
-        // Add a new entry.
-        if (current == NULL) {
-            *p = createEntry(key, hash, value);
-            if (*p == NULL) {
-                errno = ENOMEM;
-                return NULL;
-            }
-            map->size++;
-            expandIfNecessary(map);
-            return NULL;
+    // Most keys are in their home slot.
+    if (map->control[index] == control) {
+        Slot* slot = &map->slots[index];
+        if (equalKeys(slot->key, slot->hash, key, hash, map->equals)) {
+            return index;
         }
+    }
 
-        // Replace existing entry.
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* oldValue = current->value;
-            current->value = value;
-            return oldValue;
+    // Bounded in case there are no EMPTY slots left.
+    for (size_t probed = 0; probed < map->bucketCount; probed += GROUP_SIZE) {
+        Group group = loadGroup(map, index);
+        for (Group match = matchControl(group, control); match != 0; match &= match - 1) {
+            size_t i = maskIndex(map, index, match);
+            Slot* slot = &map->slots[i];
+            if (equalKeys(slot->key, slot->hash, key, hash, map->equals)) {
+                return i;
+            }
         }
-
-        // Move to next entry.
-        p = &current->next;
+        // Keys are never stored past an EMPTY slot on their probe sequence.
+        if (matchEmpty(group) != 0) {
+            break;
+        }
+        index = (index + GROUP_SIZE) & (map->bucketCount - 1);
     }
+    return -1;
 }
 
-void* hashmapGet(Hashmap* map, void* key) {
+void* hashmapPut(Hashmap* map, void* key, void* value) {
     int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
 
-    Entry* entry = map->buckets[index];
-    while (entry != NULL) {
-        if (equalKeys(entry->key, entry->hash, key, hash, map->equals)) {
-            return entry->value;
-        }
-        entry = entry->next;
+    // Replace existing entry.
+    ssize_t existing = findIndex(map, key, hash);
+    if (existing >= 0) {
+        void* oldValue = map->slots[existing].value;
+        map->slots[existing].value = value;
+        return oldValue;
+    }
+
+    // Only possible if expanding the map failed before.
+    if (map->size == map->bucketCount) {
+        errno = ENOMEM;
+        return NULL;
     }
 
+    // Add a new entry.
+    size_t index = findFree(map, hash);
+    if (map->control[index] == DELETED) {
+        map->deleted--;
+    }
+    setControl(map, index, controlByte(hash));
+    map->slots[index].key = key;
+    map->slots[index].value = value;
+    map->slots[index].hash = hash;
+    map->size++;
+    expandIfNecessary(map);
     return NULL;
 }
 
-void* hashmapRemove(Hashmap* map, void* key) {
-    int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    // Pointer to the current entry.
-    Entry** p = &(map->buckets[index]);
-    Entry* current;
-    while ((current = *p) != NULL) {
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* value = current->value;
-            *p = current->next;
-            free(current);
-            map->size--;
-            return value;
-        }
+void* hashmapGet(Hashmap* map, void* key) {
+    ssize_t index = findIndex(map, key, hashKey(map, key));
+    if (index < 0) {
+        return NULL;
+    }
+    return map->slots[index].value;
+}
 
-        p = &current->next;
+void* hashmapRemove(Hashmap* map, void* key) {
+    ssize_t index = findIndex(map, key, hashKey(map, key));
+    if (index < 0) {
+        return NULL;
     }
 
-    return NULL;
+    // Probes stop at the next slot anyway if it is empty, so this one can be
+    // marked empty rather than deleted.
+    size_t next = (index + 1) & (map->bucketCount - 1);
+    if (map->control[next] == EMPTY) {
+        setControl(map, index, EMPTY);
+    } else {
+        setControl(map, index, DELETED);
+        map->deleted++;
+    }
+    map->size--;
+    return map->slots[index].value;
 }
 
 void hashmapForEach(Hashmap* map, bool (*callback)(void* key, void* value, void* context),
                     void* context) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry *next = entry->next;
-            if (!callback(entry->key, entry->value, context)) {
+    // Removing entries never moves the others, so the callback may do that.
+    for (size_t i = 0; i < map->bucketCount; i++) {
+        if (!(map->control[i] & EMPTY)) {
+            if (!callback(map->slots[i].key, map->slots[i].value, context)) {
                 return;
             }
-            entry = next;
         }
     }
 }
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/hashmap.h>
+
+#include <stdint.h>
+
+#include <benchmark/benchmark.h>
+
+static void* Key(intptr_t i) {
+    return reinterpret_cast<void*>(i);
+}
+
+static int IntHash(void* key) {
+    return static_cast<int>(reinterpret_cast<intptr_t>(key));
+}
+
+static bool IntEquals(void* a, void* b) {
+    return a == b;
+}
+
+static Hashmap* CreateFilledMap(intptr_t count) {
+    Hashmap* map = hashmapCreate(0, IntHash, IntEquals);
+    for (intptr_t i = 1; i <= count; i++) {
+        hashmapPut(map, Key(i), Key(i));
+    }
+    return map;
+}
+
+// Builds a map of state.range(0) entries from empty, including all the resizing.
+static void BM_hashmap_put(benchmark::State& state) {
+    for (auto _ : state) {
+        Hashmap* map = CreateFilledMap(state.range(0));
+        hashmapFree(map);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_hashmap_put)->Range(1 << 10, 1 << 20);
+
+static void BM_hashmap_get(benchmark::State& state) {
+    Hashmap* map = CreateFilledMap(state.range(0));
+    intptr_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hashmapGet(map, Key(i % state.range(0) + 1)));
+        i += 7919;
+    }
+    hashmapFree(map);
+}
+BENCHMARK(BM_hashmap_get)->Range(1 << 10, 1 << 20);
+
+static void BM_hashmap_get_missing(benchmark::State& state) {
+    Hashmap* map = CreateFilledMap(state.range(0));
+    intptr_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hashmapGet(map, Key(-(i % state.range(0)) - 1)));
+        i += 7919;
+    }
+    hashmapFree(map);
+}
+BENCHMARK(BM_hashmap_get_missing)->Range(1 << 10, 1 << 20);
+
+// Removes and re-adds entries of a map of state.range(0) entries.
+static void BM_hashmap_remove_put(benchmark::State& state) {
+    Hashmap* map = CreateFilledMap(state.range(0));
+    intptr_t i = 0;
+    for (auto _ : state) {
+        void* key = Key(i % state.range(0) + 1);
+        hashmapPut(map, key, hashmapRemove(map, key));
+        i += 7919;
+    }
+    hashmapFree(map);
+}
+BENCHMARK(BM_hashmap_remove_put)->Range(1 << 10, 1 << 20);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/hashmap.h>
+
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+
+static void* Key(intptr_t i) {
+    return reinterpret_cast<void*>(i);
+}
+
+static int IntHash(void* key) {
+    return static_cast<int>(reinterpret_cast<intptr_t>(key));
+}
+
+static int ConstantHash(void*) {
+    return 42;
+}
+
+static bool IntEquals(void* a, void* b) {
+    return a == b;
+}
+
+TEST(hashmap, put_get_remove) {
+    Hashmap* map = hashmapCreate(0, IntHash, IntEquals);
+    ASSERT_NE(nullptr, map);
+
+    EXPECT_EQ(nullptr, hashmapPut(map, Key(1), Key(10)));
+    EXPECT_EQ(nullptr, hashmapPut(map, Key(2), Key(20)));
+    EXPECT_EQ(Key(10), hashmapGet(map, Key(1)));
+    EXPECT_EQ(Key(20), hashmapGet(map, Key(2)));
+    EXPECT_EQ(nullptr, hashmapGet(map, Key(3)));
+
+    EXPECT_EQ(Key(10), hashmapPut(map, Key(1), Key(11)));
+    EXPECT_EQ(Key(11), hashmapGet(map, Key(1)));
+
+    EXPECT_EQ(Key(11), hashmapRemove(map, Key(1)));
+    EXPECT_EQ(nullptr, hashmapGet(map, Key(1)));
+    EXPECT_EQ(nullptr, hashmapRemove(map, Key(1)));
+    EXPECT_EQ(Key(20), hashmapGet(map, Key(2)));
+
+    hashmapFree(map);
+}
+
+static void CheckManyEntries(Hashmap* map, intptr_t count) {
+    for (intptr_t i = 1; i <= count; i++) {
+        ASSERT_EQ(nullptr, hashmapPut(map, Key(i), Key(-i)));
+    }
+    for (intptr_t i = 1; i <= count; i++) {
+        ASSERT_EQ(Key(-i), hashmapGet(map, Key(i))) << i;
+    }
+
+    // Remove every other entry, then add them back.  This must not lose any of the others.
+    for (intptr_t i = 1; i <= count; i += 2) {
+        ASSERT_EQ(Key(-i), hashmapRemove(map, Key(i))) << i;
+    }
+    for (intptr_t i = 1; i <= count; i++) {
+        ASSERT_EQ(i % 2 ? nullptr : Key(-i), hashmapGet(map, Key(i))) << i;
+    }
+    for (intptr_t i = 1; i <= count; i += 2) {
+        ASSERT_EQ(nullptr, hashmapPut(map, Key(i), Key(i))) << i;
+    }
+    for (intptr_t i = 1; i <= count; i++) {
+        ASSERT_EQ(i % 2 ? Key(i) : Key(-i), hashmapGet(map, Key(i))) << i;
+    }
+}
+
+TEST(hashmap, many_entries) {
+    Hashmap* map = hashmapCreate(5, IntHash, IntEquals);
+    ASSERT_NE(nullptr, map);
+    CheckManyEntries(map, 10000);
+    hashmapFree(map);
+}
+
+TEST(hashmap, colliding_hashes) {
+    Hashmap* map = hashmapCreate(5, ConstantHash, IntEquals);
+    ASSERT_NE(nullptr, map);
+    CheckManyEntries(map, 500);
+    hashmapFree(map);
+}
+
+struct RemoveContext {
+    Hashmap* map;
+    size_t visited;
+};
+
+static bool RemoveEntry(void* key, void*, void* context) {
+    RemoveContext* ctx = static_cast<RemoveContext*>(context);
+    hashmapRemove(ctx->map, key);
+    ctx->visited++;
+    return true;
+}
+
+TEST(hashmap, remove_while_iterating) {
+    Hashmap* map = hashmapCreate(5, IntHash, IntEquals);
+    ASSERT_NE(nullptr, map);
+    for (intptr_t i = 1; i <= 1000; i++) {
+        ASSERT_EQ(nullptr, hashmapPut(map, Key(i), Key(i)));
+    }
+
+    // This is how str_parms clears itself.
+    RemoveContext ctx = {map, 0};
+    hashmapForEach(map, RemoveEntry, &ctx);
+    EXPECT_EQ(1000U, ctx.visited);
+    for (intptr_t i = 1; i <= 1000; i++) {
+        ASSERT_EQ(nullptr, hashmapGet(map, Key(i))) << i;
+    }
+
+    hashmapFree(map);
+}
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <functional>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -27,6 +29,10 @@ class Modprobe {
     Modprobe(const std::vector<std::string>&, const std::string load_file = "modules.load");
 
     bool LoadListedModules(bool strict = true);
+    // Loads the same modules as LoadListedModules(), but on up to |num_threads| threads. A module
+    // is only loaded once its dependencies and soft pre-dependencies have been, so modules that
+    // don't depend on each other load concurrently.
+    bool LoadModulesParallel(int num_threads, bool strict = true);
     bool LoadWithAliases(const std::string& module_name, bool strict,
                          const std::string& parameters = "");
     bool Remove(const std::string& module_name);
@@ -42,7 +48,22 @@ class Modprobe {
     void EnableDeferred(bool enable);
 
   private:
+    // The modules that LoadModulesParallel() will load, each with the modules that must be loaded
+    // before it.  Only a failure of a hard prerequisite stops a module from being loaded.
+    struct LoadGraph {
+        struct Node {
+            std::string path;
+            std::vector<std::pair<size_t, bool>> prerequisites;  // (node, is hard dependency)
+            bool missing_dependency;
+        };
+        std::vector<Node> nodes;
+        std::unordered_map<std::string, size_t> index;
+    };
+
     std::string MakeCanonical(const std::string& module_path);
+    bool AddToLoadGraph(const std::string& module_name, bool strict, LoadGraph* graph,
+                        std::vector<size_t>* nodes);
+    size_t AddModuleToLoadGraph(const std::string& module, LoadGraph* graph);
     bool InsmodWithDeps(const std::string& module_name, const std::string& parameters);
     bool Insmod(const std::string& path_name, const std::string& parameters);
     bool Rmmod(const std::string& module_name);
@@ -69,6 +90,7 @@ class Modprobe {
     std::unordered_map<std::string, std::string> module_options_;
     std::set<std::string> module_blocklist_;
     std::vector<std::string> module_deferred_aliases_;
+    std::mutex module_loaded_lock_;
     std::unordered_set<std::string> module_loaded_;
     int module_count_ = 0;
     bool blocklist_enabled = false;
@@ -23,8 +23,11 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -477,6 +480,169 @@ bool Modprobe::LoadListedModules(bool strict) {
     return ret;
 }
 
+// Mirrors LoadWithAliases(), but records the modules that would be loaded in |graph| instead of
+// loading them.  |nodes| receives the nodes that |module_name| resolved to.
+bool Modprobe::AddToLoadGraph(const std::string& module_name, bool strict, LoadGraph* graph,
+                              std::vector<size_t>* nodes) {
+    auto canonical_name = MakeCanonical(module_name);
+    if (module_loaded_.count(canonical_name)) {
+        return true;
+    }
+
+    std::set<std::string> modules_to_load = {canonical_name};
+    for (const auto& [alias, aliased_module] : module_aliases_) {
+        if (fnmatch(alias.c_str(), module_name.c_str(), 0) != 0) continue;
+        LOG(VERBOSE) << "Found alias for '" << module_name << "': '" << aliased_module;
+        if (module_loaded_.count(MakeCanonical(aliased_module))) continue;
+        modules_to_load.emplace(aliased_module);
+    }
+
+    for (const auto& module : modules_to_load) {
+        if (!ModuleExists(module)) continue;
+        nodes->emplace_back(AddModuleToLoadGraph(module, graph));
+    }
+
+    if (strict && nodes->empty()) {
+        LOG(ERROR) << "LoadModulesParallel was unable to load " << module_name;
+        return false;
+    }
+    return true;
+}
+
+// Mirrors InsmodWithDeps().
+size_t Modprobe::AddModuleToLoadGraph(const std::string& module, LoadGraph* graph) {
+    if (auto it = graph->index.find(module); it != graph->index.end()) {
+        return it->second;
+    }
+
+    auto dependencies = GetDependencies(module);
+    size_t node = graph->nodes.size();
+    graph->nodes.push_back({dependencies[0], {}, false});
+    graph->index.emplace(module, node);
+
+    std::vector<std::pair<size_t, bool>> prerequisites;
+    for (auto dep = dependencies.rbegin(); dep != dependencies.rend() - 1; ++dep) {
+        std::vector<size_t> dep_nodes;
+        if (!AddToLoadGraph(*dep, true, graph, &dep_nodes)) {
+            graph->nodes[node].missing_dependency = true;
+        }
+        for (size_t dep_node : dep_nodes) prerequisites.emplace_back(dep_node, true);
+    }
+
+    for (const auto& [it_module, softdep] : module_pre_softdep_) {
+        if (module != it_module) continue;
+        std::vector<size_t> dep_nodes;
+        AddToLoadGraph(softdep, false, graph, &dep_nodes);
+        for (size_t dep_node : dep_nodes) prerequisites.emplace_back(dep_node, false);
+    }
+    graph->nodes[node].prerequisites = std::move(prerequisites);
+
+    for (const auto& [it_module, softdep] : module_post_softdep_) {
+        if (module != it_module) continue;
+        size_t first_new_node = graph->nodes.size();
+        std::vector<size_t> dep_nodes;
+        AddToLoadGraph(softdep, false, graph, &dep_nodes);
+        // Only order modules that weren't already going to be loaded earlier, to avoid cycles.
+        for (size_t dep_node : dep_nodes) {
+            if (dep_node >= first_new_node) {
+                graph->nodes[dep_node].prerequisites.emplace_back(node, false);
+            }
+        }
+    }
+
+    return node;
+}
+
+bool Modprobe::LoadModulesParallel(int num_threads, bool strict) {
+    LoadGraph graph;
+    std::vector<std::vector<size_t>> listed_nodes;
+    bool ret = true;
+    for (const auto& module : module_load_) {
+        std::vector<size_t> nodes;
+        if (!AddToLoadGraph(module, true, &graph, &nodes)) {
+            ret = false;
+            if (strict) break;
+        }
+        listed_nodes.emplace_back(std::move(nodes));
+    }
+
+    enum class State { kPending, kLoaded, kFailed };
+    std::vector<State> states(graph.nodes.size(), State::kPending);
+    std::vector<size_t> unmet(graph.nodes.size());
+    std::vector<bool> hard_failure(graph.nodes.size());
+    std::vector<std::vector<std::pair<size_t, bool>>> dependents(graph.nodes.size());
+    std::deque<size_t> ready;
+    for (size_t i = 0; i < graph.nodes.size(); ++i) {
+        for (const auto& [prerequisite, hard] : graph.nodes[i].prerequisites) {
+            dependents[prerequisite].emplace_back(i, hard);
+        }
+        unmet[i] = graph.nodes[i].prerequisites.size();
+        hard_failure[i] = graph.nodes[i].missing_dependency;
+        if (unmet[i] == 0) ready.emplace_back(i);
+    }
+
+    std::mutex lock;
+    std::condition_variable cv;
+    int in_flight = 0;
+    bool stop = false;
+
+    auto worker = [&] {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            cv.wait(guard, [&] { return !ready.empty() || in_flight == 0; });
+            if (ready.empty()) break;
+
+            size_t node = ready.front();
+            ready.pop_front();
+            const auto& path = graph.nodes[node].path;
+            bool loaded = false;
+            if (hard_failure[node]) {
+                LOG(ERROR) << "Not loading " << path << " as a dependency failed to load";
+            } else if (!stop) {
+                ++in_flight;
+                guard.unlock();
+                loaded = Insmod(path, "");
+                guard.lock();
+                --in_flight;
+                if (!loaded && strict) stop = true;
+            }
+
+            states[node] = loaded ? State::kLoaded : State::kFailed;
+            for (const auto& [dependent, hard] : dependents[node]) {
+                if (!loaded && hard) hard_failure[dependent] = true;
+                if (--unmet[dependent] == 0) ready.emplace_back(dependent);
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < graph.nodes.size(); ++i) {
+        if (states[i] == State::kPending) {
+            LOG(ERROR) << "Not loading " << graph.nodes[i].path << " due to a dependency cycle";
+        }
+    }
+
+    for (size_t i = 0; i < listed_nodes.size(); ++i) {
+        const auto& nodes = listed_nodes[i];
+        if (nodes.empty()) continue;
+        if (std::none_of(nodes.begin(), nodes.end(),
+                         [&](size_t node) { return states[node] == State::kLoaded; })) {
+            LOG(ERROR) << "LoadModulesParallel was unable to load " << module_load_[i];
+            ret = false;
+        }
+    }
+    return ret;
+}
+
 bool Modprobe::Remove(const std::string& module_name) {
     auto dependencies = GetDependencies(MakeCanonical(module_name));
     if (dependencies.empty()) {
@@ -34,6 +34,7 @@ std::string Modprobe::GetKernelCmdline(void) {
 }
 
 bool Modprobe::Insmod(const std::string& path_name, const std::string& parameters) {
+    std::lock_guard guard(module_loaded_lock_);
     auto deps = GetDependencies(MakeCanonical(path_name));
     if (deps.empty()) {
         return false;
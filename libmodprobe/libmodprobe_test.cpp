@@ -14,10 +14,12 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <functional>
 
 #include <android-base/file.h>
 #include <android-base/macros.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <gtest/gtest.h>
 
@@ -179,3 +181,83 @@ TEST(libmodprobe, Test) {
     m.EnableBlocklist(true);
     EXPECT_FALSE(m.LoadWithAliases("test4", true));
 }
+
+TEST(libmodprobe, LoadModulesParallel) {
+    kernel_cmdline = "test1.option1=50";
+    test_modules = {
+            "/test1.ko", "/test2.ko", "/test3.ko", "/test4.ko", "/test5.ko",
+            "/test6.ko", "/test7.ko", "/test8.ko", "/test9.ko", "/test10.ko",
+    };
+    modules_loaded.clear();
+
+    // test10 depends on test11, which is listed in modules.dep but missing, so it can't be loaded.
+    const std::string modules_dep =
+            "test1.ko:\n"
+            "test2.ko: test1.ko\n"
+            "test3.ko: test2.ko test1.ko\n"
+            "test4.ko:\n"
+            "test5.ko:\n"
+            "test6.ko:\n"
+            "test7.ko:\n"
+            "test8.ko:\n"
+            "test9.ko:\n"
+            "test10.ko: test11.ko\n"
+            "test11.ko:\n";
+
+    const std::string modules_softdep =
+            "softdep test4 pre: test5 post: test6\n"
+            "softdep test7 pre: test89\n";
+
+    const std::string modules_alias =
+            "alias test89 test8\n"
+            "alias test89 test9\n";
+
+    const std::string modules_load =
+            "test3.ko\n"
+            "test4.ko\n"
+            "test7.ko\n"
+            "test1.ko\n";
+
+    TemporaryDir dir;
+    auto dir_path = std::string(dir.path);
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_alias, dir_path + "/modules.alias", 0600,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_dep, dir_path + "/modules.dep", 0600,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_softdep, dir_path + "/modules.softdep",
+                                                 0600, getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_load, dir_path + "/modules.load", 0600,
+                                                 getuid(), getgid()));
+
+    for (auto i = test_modules.begin(); i != test_modules.end(); ++i) {
+        *i = dir.path + *i;
+    }
+
+    Modprobe m({dir.path});
+    EXPECT_TRUE(m.LoadModulesParallel(4));
+    EXPECT_EQ(9, m.GetModuleCount());
+
+    auto position = [&](const std::string& module) {
+        auto it = std::find_if(modules_loaded.begin(), modules_loaded.end(), [&](const auto& m) {
+            return android::base::StartsWith(m, dir_path + module);
+        });
+        EXPECT_NE(modules_loaded.end(), it) << module << " was not loaded";
+        return it - modules_loaded.begin();
+    };
+    EXPECT_LT(position("/test1.ko"), position("/test2.ko"));
+    EXPECT_LT(position("/test2.ko"), position("/test3.ko"));
+    EXPECT_LT(position("/test5.ko"), position("/test4.ko"));
+    EXPECT_LT(position("/test4.ko"), position("/test6.ko"));
+    EXPECT_LT(position("/test8.ko"), position("/test7.ko"));
+    EXPECT_LT(position("/test9.ko"), position("/test7.ko"));
+    EXPECT_NE(modules_loaded.end(),
+              std::find(modules_loaded.begin(), modules_loaded.end(),
+                        dir_path + "/test1.ko option1=50"));
+
+    // A module whose dependency can't be loaded isn't loaded either.
+    ASSERT_TRUE(android::base::WriteStringToFile("test10.ko\n", dir_path + "/modules.load", 0600,
+                                                 getuid(), getgid()));
+    Modprobe m2({dir.path});
+    EXPECT_FALSE(m2.LoadModulesParallel(4));
+    EXPECT_EQ(0, m2.GetModuleCount());
+}
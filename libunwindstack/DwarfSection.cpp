@@ -53,6 +53,7 @@ bool DwarfSection::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
       return false;
     }
     loc_regs.cie = fde->cie;
+    loc_regs.Compile();
 
     // Store it in the cache.
     it = loc_regs_.emplace(loc_regs.pc_end, std::move(loc_regs)).first;
@@ -62,6 +63,45 @@ bool DwarfSection::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
   return Eval(it->second.cie, process_memory, it->second, regs, finished);
 }
 
+bool DwarfLocations::Compile() {
+  compiled.valid = false;
+  compiled.num_rules = 0;
+
+  auto cfa_entry = find(CFA_REG);
+  if (cfa_entry == end() || cfa_entry->second.type != DWARF_LOCATION_REGISTER) {
+    return false;
+  }
+  compiled.cfa_reg = cfa_entry->second.values[0];
+  compiled.cfa_offset = cfa_entry->second.values[1];
+
+  for (const auto& entry : *this) {
+    if (entry.first == CFA_REG) {
+      continue;
+    }
+    switch (entry.second.type) {
+      case DWARF_LOCATION_INVALID:
+        // Evaluating this location does nothing.
+        continue;
+      case DWARF_LOCATION_UNDEFINED:
+      case DWARF_LOCATION_OFFSET:
+      case DWARF_LOCATION_VAL_OFFSET:
+        break;
+      default:
+        // Register rules need the original register values, and expressions
+        // need the full evaluator.
+        return false;
+    }
+    if (compiled.num_rules == DwarfCompiledRow::kMaxRules) {
+      return false;
+    }
+    compiled.rules[compiled.num_rules++] = {
+        .reg = entry.first, .type = entry.second.type, .offset = entry.second.values[0]};
+  }
+
+  compiled.valid = true;
+  return true;
+}
+
 template <typename AddressType>
 const DwarfCie* DwarfSectionImpl<AddressType>::GetCieFromOffset(uint64_t offset) {
   auto cie_entry = cie_entries_.find(offset);
@@ -481,6 +521,10 @@ bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_me
     return false;
   }
 
+  if (loc_regs.compiled.valid) {
+    return EvalCompiled(cie, regular_memory, loc_regs.compiled, cur_regs, finished);
+  }
+
   // Get the cfa value;
   auto cfa_entry = loc_regs.find(CFA_REG);
   if (cfa_entry == loc_regs.end()) {
@@ -552,6 +596,68 @@ bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_me
   return true;
 }
 
+template <typename AddressType>
+bool DwarfSectionImpl<AddressType>::EvalCompiled(const DwarfCie* cie, Memory* regular_memory,
+                                                 const DwarfCompiledRow& row,
+                                                 RegsImpl<AddressType>* cur_regs, bool* finished) {
+  if (row.cfa_reg >= cur_regs->total_regs()) {
+    last_error_.code = DWARF_ERROR_ILLEGAL_VALUE;
+    return false;
+  }
+
+  // Always set the dex pc to zero when evaluating.
+  cur_regs->set_dex_pc(0);
+
+  // None of the compiled rules read registers, so the cfa is the only value
+  // that has to be computed before any register is modified.
+  AddressType cfa = (*cur_regs)[row.cfa_reg];
+  cfa += row.cfa_offset;
+
+  bool return_address_undefined = false;
+  for (size_t i = 0; i < row.num_rules; i++) {
+    const DwarfCompiledRow::Rule& rule = row.rules[i];
+    if (rule.reg >= cur_regs->total_regs()) {
+      // Skip this unknown register.
+      continue;
+    }
+
+    AddressType* reg_ptr = &(*cur_regs)[rule.reg];
+    switch (rule.type) {
+      case DWARF_LOCATION_OFFSET:
+        if (!regular_memory->ReadFully(cfa + rule.offset, reg_ptr, sizeof(AddressType))) {
+          last_error_.code = DWARF_ERROR_MEMORY_INVALID;
+          last_error_.address = cfa + rule.offset;
+          return false;
+        }
+        break;
+      case DWARF_LOCATION_VAL_OFFSET:
+        *reg_ptr = cfa + rule.offset;
+        break;
+      case DWARF_LOCATION_UNDEFINED:
+        if (rule.reg == cie->return_address_register) {
+          return_address_undefined = true;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Find the return address location.
+  if (return_address_undefined) {
+    cur_regs->set_pc(0);
+  } else {
+    cur_regs->set_pc((*cur_regs)[cie->return_address_register]);
+  }
+
+  // If the pc was set to zero, consider this the final frame.
+  *finished = (cur_regs->pc() == 0) ? true : false;
+
+  cur_regs->set_sp(cfa);
+
+  return true;
+}
+
 template <typename AddressType>
 bool DwarfSectionImpl<AddressType>::GetCfaLocationInfo(uint64_t pc, const DwarfFde* fde,
                                                        dwarf_loc_regs_t* loc_regs) {
@@ -28,13 +28,18 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include <unwindstack/Elf.h>
 #include <unwindstack/LocalUnwinder.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86.h>
+#include <unwindstack/MachineX86_64.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
@@ -43,6 +48,30 @@
 
 namespace unwindstack {
 
+// The register holding the frame pointer. On these architectures a frame
+// record is the caller's frame pointer followed by the return address. On
+// arm, the frame pointer register and the record layout depend on whether
+// the code is arm or thumb, so frame pointer unwinding is not supported.
+//
+// On x86 and x86_64 the frame record is pushed right below the return
+// address, so the caller's sp is just above the record. On arm64 the record
+// can be anywhere in the frame, so the caller's sp is not known after
+// following it, and neither the unwind information nor a signal frame can be
+// used to unwind the frames above.
+#if defined(__aarch64__)
+static constexpr int kFramePointerReg = ARM64_REG_R29;
+static constexpr bool kFramePointerStepRestoresSp = false;
+#elif defined(__x86_64__)
+static constexpr int kFramePointerReg = X86_64_REG_RBP;
+static constexpr bool kFramePointerStepRestoresSp = true;
+#elif defined(__i386__)
+static constexpr int kFramePointerReg = X86_REG_EBP;
+static constexpr bool kFramePointerStepRestoresSp = true;
+#else
+static constexpr int kFramePointerReg = -1;
+static constexpr bool kFramePointerStepRestoresSp = false;
+#endif
+
 bool LocalUnwinder::Init() {
   pthread_rwlock_init(&maps_rwlock_, nullptr);
 
@@ -67,6 +96,56 @@ bool LocalUnwinder::ShouldSkipLibrary(const std::string& map_name) {
   return false;
 }
 
+bool LocalUnwinder::IsFramePointerLibrary(MapInfo* map_info) {
+  std::lock_guard<std::mutex> guard(frame_pointer_maps_mutex_);
+  auto entry = frame_pointer_maps_.find(map_info);
+  if (entry != frame_pointer_maps_.end()) {
+    return entry->second;
+  }
+
+  bool is_frame_pointer_library = false;
+  for (const std::string& library : frame_pointer_libraries_) {
+    if (library == map_info->name) {
+      is_frame_pointer_library = true;
+      break;
+    }
+  }
+  frame_pointer_maps_.emplace(map_info, is_frame_pointer_library);
+  return is_frame_pointer_library;
+}
+
+bool LocalUnwinder::StepFramePointer(Regs* regs, uint64_t stack_start, uint64_t stack_end,
+                                     bool* finished) {
+  if (kFramePointerReg < 0) {
+    return false;
+  }
+
+  // Local registers are always the native size.
+  uintptr_t* raw_regs = reinterpret_cast<uintptr_t*>(regs->RawData());
+  uintptr_t fp = raw_regs[kFramePointerReg];
+  if (fp < regs->sp() || fp < stack_start || stack_end - stack_start < 2 * sizeof(uintptr_t) ||
+      fp > stack_end - 2 * sizeof(uintptr_t) || (fp & (sizeof(uintptr_t) - 1)) != 0) {
+    return false;
+  }
+
+  // The record is within the readable stack map, so read it directly.
+  const uintptr_t* frame_record = reinterpret_cast<const uintptr_t*>(fp);
+  uintptr_t next_fp = frame_record[0];
+  uintptr_t return_address = frame_record[1];
+
+  // The chain has to move up the stack, unless this is the last record.
+  if (next_fp != 0 && next_fp <= fp) {
+    return false;
+  }
+
+  raw_regs[kFramePointerReg] = next_fp;
+  // This is only a lower bound of the caller's sp on arm64, see above.
+  regs->set_sp(fp + 2 * sizeof(uintptr_t));
+  regs->set_pc(return_address);
+  *finished = return_address == 0;
+  return true;
+}
+
 MapInfo* LocalUnwinder::GetMapInfo(uint64_t pc) {
   pthread_rwlock_rdlock(&maps_rwlock_);
   MapInfo* map_info = maps_->Find(pc);
@@ -90,8 +169,27 @@ bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_f
   unwindstack::RegsGetLocal(regs.get());
   ArchEnum arch = regs->Arch();
 
+  // Frame records are only followed if they lie within the current stack.
+  bool use_frame_pointers = kFramePointerReg >= 0 && !frame_pointer_libraries_.empty();
+  uint64_t stack_start = 0;
+  uint64_t stack_end = 0;
+  if (use_frame_pointers) {
+    MapInfo* stack_map = GetMapInfo(regs->sp());
+    if (stack_map != nullptr && (stack_map->flags & PROT_READ)) {
+      stack_start = stack_map->start;
+      stack_end = stack_map->end;
+    } else {
+      use_frame_pointers = false;
+    }
+  }
+
   size_t num_frames = 0;
   bool adjust_pc = false;
+  // The first frame, and a frame interrupted by a signal, may be a leaf
+  // function or one that has not set up its frame record yet.
+  bool may_lack_frame_record = true;
+  // Whether the sp of the current frame is known, see kFramePointerStepRestoresSp.
+  bool sp_valid = true;
   while (true) {
     uint64_t cur_pc = regs->pc();
     uint64_t cur_sp = regs->sp();
@@ -113,10 +211,20 @@ bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_f
     step_pc -= pc_adjustment;
 
     bool finished = false;
-    if (elf->StepIfSignalHandler(rel_pc, regs.get(), process_memory_.get())) {
+    bool frame_pointer_step = false;
+    if (sp_valid && elf->StepIfSignalHandler(rel_pc, regs.get(), process_memory_.get())) {
       step_pc = rel_pc;
-    } else if (!elf->Step(step_pc, regs.get(), process_memory_.get(), &finished)) {
-      finished = true;
+      may_lack_frame_record = true;
+    } else {
+      if (use_frame_pointers && !may_lack_frame_record && IsFramePointerLibrary(map_info)) {
+        frame_pointer_step = StepFramePointer(regs.get(), stack_start, stack_end, &finished);
+      }
+      if (frame_pointer_step) {
+        sp_valid = sp_valid && kFramePointerStepRestoresSp;
+      } else if (!sp_valid || !elf->Step(step_pc, regs.get(), process_memory_.get(), &finished)) {
+        finished = true;
+      }
+      may_lack_frame_record = false;
     }
 
     // Skip any locations that are within this library.
@@ -130,6 +238,7 @@ bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_f
       } else {
         frame_info->emplace_back(map_info, cur_pc - pc_adjustment, rel_pc - pc_adjustment, "", 0);
       }
+      frame_info->back().frame_pointer_step = frame_pointer_step;
       num_frames++;
     }
 
@@ -22,8 +22,10 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <android-base/file.h>
 #include <android-base/unique_fd.h>
 #include <procinfo/process_map.h>
 
@@ -136,72 +138,90 @@ const std::string LocalUpdatableMaps::GetMapsFile() const {
   return "/proc/self/maps";
 }
 
+void LocalUpdatableMaps::SetMinReparseInterval(uint64_t interval_ns) {
+  min_reparse_interval_ns_ = interval_ns;
+}
+
 bool LocalUpdatableMaps::Reparse() {
-  // New maps will be added at the end without deleting the old ones.
-  size_t last_map_idx = maps_.size();
-  if (!Parse()) {
-    maps_.resize(last_map_idx);
+  if (min_reparse_interval_ns_ != 0) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    if (last_reparse_ns_ != 0 && now_ns - last_reparse_ns_ < min_reparse_interval_ns_) {
+      return false;
+    }
+    last_reparse_ns_ = now_ns;
+  }
+
+  // The buffer keeps its capacity between calls, so steady state reparses
+  // don't need to reallocate it.
+  if (!android::base::ReadFileToString(GetMapsFile(), &maps_buffer_)) {
     return false;
   }
 
-  size_t total_entries = maps_.size();
-  size_t search_map_idx = 0;
-  for (size_t new_map_idx = last_map_idx; new_map_idx < maps_.size(); new_map_idx++) {
-    auto& new_map_info = maps_[new_map_idx];
-    uint64_t start = new_map_info->start;
-    uint64_t end = new_map_info->end;
-    uint64_t flags = new_map_info->flags;
-    std::string* name = &new_map_info->name;
-    for (size_t old_map_idx = search_map_idx; old_map_idx < last_map_idx; old_map_idx++) {
-      auto& info = maps_[old_map_idx];
-      if (start == info->start && end == info->end && flags == info->flags && *name == info->name) {
-        // No need to check
-        search_map_idx = old_map_idx + 1;
-        if (new_map_idx + 1 < maps_.size()) {
-          maps_[new_map_idx + 1]->prev_map = info.get();
-          maps_[new_map_idx + 1]->prev_real_map =
-              info->IsBlank() ? info->prev_real_map : info.get();
+  // Merge the new entries with the current sorted list in a single pass.
+  // Entries that are unchanged keep their existing MapInfo object, and
+  // new_maps holds a nullptr for them until the merge is committed, so
+  // that nothing is modified if the parse fails.
+  std::vector<std::unique_ptr<MapInfo>> new_maps;
+  std::vector<size_t> reused_indices;
+  new_maps.reserve(maps_.size());
+  reused_indices.reserve(maps_.size());
+
+  size_t old_map_idx = 0;
+  MapInfo* prev_map = nullptr;
+  MapInfo* prev_real_map = nullptr;
+  bool parsed = android::procinfo::ReadMapFileContent(
+      &maps_buffer_[0],
+      [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t, const char* name) {
+        // Mark a device map in /dev/ and not in /dev/ashmem/ specially.
+        if (strncmp(name, "/dev/", 5) == 0 && strncmp(name + 5, "ashmem/", 7) != 0) {
+          flags |= unwindstack::MAPS_FLAGS_DEVICE_MAP;
+        }
+
+        while (old_map_idx < maps_.size() && maps_[old_map_idx]->start < start) {
+          old_map_idx++;
         }
-        maps_[new_map_idx] = nullptr;
-        total_entries--;
-        break;
-      } else if (info->start > start) {
-        // Stop, there isn't going to be a match.
-        search_map_idx = old_map_idx;
-        break;
-      }
-
-      // Never delete these maps, they may be in use. The assumption is
-      // that there will only every be a handful of these so waiting
-      // to destroy them is not too expensive.
-      saved_maps_.emplace_back(std::move(info));
-      search_map_idx = old_map_idx + 1;
-      maps_[old_map_idx] = nullptr;
-      total_entries--;
-    }
-    if (search_map_idx >= last_map_idx) {
-      break;
-    }
-  }
 
-  // Now move out any of the maps that never were found.
-  for (size_t i = search_map_idx; i < last_map_idx; i++) {
-    saved_maps_.emplace_back(std::move(maps_[i]));
-    maps_[i] = nullptr;
-    total_entries--;
+        MapInfo* info;
+        if (old_map_idx < maps_.size() && maps_[old_map_idx]->start == start &&
+            maps_[old_map_idx]->end == end && maps_[old_map_idx]->flags == flags &&
+            maps_[old_map_idx]->name == name) {
+          info = maps_[old_map_idx].get();
+          new_maps.emplace_back(nullptr);
+          reused_indices.push_back(old_map_idx++);
+        } else {
+          info = new MapInfo(prev_map, prev_real_map, start, end, pgoff, flags, name);
+          new_maps.emplace_back(info);
+          reused_indices.push_back(SIZE_MAX);
+        }
+
+        prev_map = info;
+        if (!info->IsBlank()) {
+          prev_real_map = info;
+        }
+      });
+  if (!parsed) {
+    return false;
   }
 
-  // Sort all of the values such that the nullptrs wind up at the end, then
-  // resize them away.
-  std::sort(maps_.begin(), maps_.end(), [](const auto& a, const auto& b) {
-    if (a == nullptr) {
-      return false;
-    } else if (b == nullptr) {
-      return true;
+  old_map_idx = 0;
+  for (size_t i = 0; i < new_maps.size(); i++) {
+    if (reused_indices[i] == SIZE_MAX) {
+      continue;
     }
-    return a->start < b->start;
-  });
-  maps_.resize(total_entries);
+    // Never delete the maps that went away, they may be in use. The
+    // assumption is that there will only ever be a handful of these so
+    // waiting to destroy them is not too expensive.
+    for (; old_map_idx < reused_indices[i]; old_map_idx++) {
+      saved_maps_.emplace_back(std::move(maps_[old_map_idx]));
+    }
+    new_maps[i] = std::move(maps_[old_map_idx++]);
+  }
+  for (; old_map_idx < maps_.size(); old_map_idx++) {
+    saved_maps_.emplace_back(std::move(maps_[old_map_idx]));
+  }
+  maps_ = std::move(new_maps);
 
   return true;
 }
@@ -17,12 +17,15 @@
 #include <stdint.h>
 
 #include <memory>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 
 #include <unwindstack/Elf.h>
+#include <unwindstack/LocalUnwinder.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
@@ -83,6 +86,71 @@ static void BM_cached_unwind(benchmark::State& state) {
 }
 BENCHMARK(BM_cached_unwind);
 
+// Each of these functions must keep its own frame so that both local unwind
+// benchmarks go through the same number of frames in this executable. Using
+// the result after each call keeps the calls from becoming tail calls.
+static __attribute__((noinline)) size_t LocalCall6(unwindstack::LocalUnwinder* unwinder) {
+  std::vector<unwindstack::LocalFrameData> frame_info;
+  unwinder->Unwind(&frame_info, 32);
+  return frame_info.size();
+}
+
+static __attribute__((noinline)) size_t LocalCall5(unwindstack::LocalUnwinder* unwinder) {
+  size_t num_frames = LocalCall6(unwinder);
+  benchmark::DoNotOptimize(num_frames);
+  return num_frames;
+}
+
+static __attribute__((noinline)) size_t LocalCall4(unwindstack::LocalUnwinder* unwinder) {
+  size_t num_frames = LocalCall5(unwinder);
+  benchmark::DoNotOptimize(num_frames);
+  return num_frames;
+}
+
+static __attribute__((noinline)) size_t LocalCall3(unwindstack::LocalUnwinder* unwinder) {
+  size_t num_frames = LocalCall4(unwinder);
+  benchmark::DoNotOptimize(num_frames);
+  return num_frames;
+}
+
+static __attribute__((noinline)) size_t LocalCall2(unwindstack::LocalUnwinder* unwinder) {
+  size_t num_frames = LocalCall3(unwinder);
+  benchmark::DoNotOptimize(num_frames);
+  return num_frames;
+}
+
+static __attribute__((noinline)) size_t LocalCall1(unwindstack::LocalUnwinder* unwinder) {
+  size_t num_frames = LocalCall2(unwinder);
+  benchmark::DoNotOptimize(num_frames);
+  return num_frames;
+}
+
+static void BM_local_unwind(benchmark::State& state) {
+  unwindstack::LocalUnwinder unwinder;
+  if (!unwinder.Init()) {
+    state.SkipWithError("Failed to init local unwinder.");
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(LocalCall1(&unwinder));
+  }
+}
+BENCHMARK(BM_local_unwind);
+
+static void BM_local_unwind_frame_pointer(benchmark::State& state) {
+  unwindstack::LocalUnwinder unwinder;
+  if (!unwinder.Init()) {
+    state.SkipWithError("Failed to init local unwinder.");
+  }
+  // This benchmark is built with -fno-omit-frame-pointer.
+  unwinder.SetFramePointerLibraries({android::base::GetExecutablePath()});
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(LocalCall1(&unwinder));
+  }
+}
+BENCHMARK(BM_local_unwind_frame_pointer);
+
 static void Initialize(benchmark::State& state, unwindstack::Maps& maps,
                        unwindstack::MapInfo** build_id_map_info) {
   if (!maps.Parse()) {
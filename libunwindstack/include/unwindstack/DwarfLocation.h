@@ -17,6 +17,7 @@
 #ifndef _LIBUNWINDSTACK_DWARF_LOCATION_H
 #define _LIBUNWINDSTACK_DWARF_LOCATION_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <unordered_map>
@@ -40,11 +41,40 @@ struct DwarfLocation {
   uint64_t values[2];
 };
 
+// A compact copy of a row of register rules, used when the CFA is a register
+// plus an offset and every other rule is undefined, offset (the register was
+// saved in memory at CFA + offset) or val_offset (the register's value is
+// CFA + offset itself). Applying such a row does not need the generic
+// evaluator.
+struct DwarfCompiledRow {
+  static constexpr size_t kMaxRules = 16;
+
+  struct Rule {
+    uint32_t reg;
+    DwarfLocationEnum type;
+    uint64_t offset;
+  };
+
+  bool valid = false;
+  uint32_t cfa_reg = 0;
+  uint64_t cfa_offset = 0;
+  size_t num_rules = 0;
+  Rule rules[kMaxRules];
+};
+
 struct DwarfLocations : public std::unordered_map<uint32_t, DwarfLocation> {
   const DwarfCie* cie;
   // The range of PCs where the locations are valid (end is exclusive).
   uint64_t pc_start = 0;
   uint64_t pc_end = 0;
+
+  // Only valid after a call to Compile, which must be repeated if the
+  // locations are modified afterwards.
+  DwarfCompiledRow compiled;
+
+  // Fills in compiled if every location can be represented in it.
+  // Returns whether compiled is now valid.
+  bool Compile();
 };
 typedef DwarfLocations dwarf_loc_regs_t;
 
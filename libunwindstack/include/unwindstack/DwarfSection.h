@@ -34,6 +34,8 @@ namespace unwindstack {
 class Memory;
 class Regs;
 template <typename AddressType>
+class RegsImpl;
+template <typename AddressType>
 struct RegsInfo;
 
 class DwarfSection {
@@ -158,6 +160,9 @@ class DwarfSectionImpl : public DwarfSection {
   bool EvalExpression(const DwarfLocation& loc, Memory* regular_memory, AddressType* value,
                       RegsInfo<AddressType>* regs_info, bool* is_dex_pc);
 
+  bool EvalCompiled(const DwarfCie* cie, Memory* regular_memory, const DwarfCompiledRow& row,
+                    RegsImpl<AddressType>* cur_regs, bool* finished);
+
   void InsertFde(const DwarfFde* fde);
 
   int64_t section_bias_ = 0;
@@ -22,7 +22,9 @@
 #include <sys/types.h>
 
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <unwindstack/Error.h>
@@ -33,6 +35,7 @@ namespace unwindstack {
 
 // Forward declarations.
 class Elf;
+class Regs;
 struct MapInfo;
 
 struct LocalFrameData {
@@ -49,6 +52,9 @@ struct LocalFrameData {
   uint64_t rel_pc;
   std::string function_name;
   uint64_t function_offset;
+  // Whether the caller of this frame was found by following its frame record
+  // rather than by using the unwind information.
+  bool frame_pointer_step = false;
 };
 
 // This is a specialized class that should only be used for doing local unwinds.
@@ -64,6 +70,19 @@ class LocalUnwinder {
 
   bool Init();
 
+  // Unwind frames in the given libraries by following the frame pointer chain
+  // instead of evaluating the unwind information. Only use this for libraries
+  // known to be built with frame pointers (-fno-omit-frame-pointer). The first
+  // frame, a frame interrupted by a signal and a frame whose frame record
+  // doesn't look valid are unwound using the unwind information instead. This
+  // is only supported on arm64, x86 and x86_64, and must be called before any
+  // call to Unwind. On arm64 the caller's sp can't be recovered from a frame
+  // record, so once one has been followed, the unwind ends at the first frame
+  // that can't be unwound by its frame record.
+  void SetFramePointerLibraries(const std::vector<std::string>& libraries) {
+    frame_pointer_libraries_ = libraries;
+  }
+
   bool Unwind(std::vector<LocalFrameData>* frame_info, size_t max_frames);
 
   bool ShouldSkipLibrary(const std::string& map_name);
@@ -74,10 +93,18 @@ class LocalUnwinder {
   uint64_t LastErrorAddress() { return last_error_.address; }
 
  private:
+  bool IsFramePointerLibrary(MapInfo* map_info);
+
+  static bool StepFramePointer(Regs* regs, uint64_t stack_start, uint64_t stack_end,
+                               bool* finished);
+
   pthread_rwlock_t maps_rwlock_;
   std::unique_ptr<LocalUpdatableMaps> maps_ = nullptr;
   std::shared_ptr<Memory> process_memory_;
   std::vector<std::string> skip_libraries_;
+  std::vector<std::string> frame_pointer_libraries_;
+  std::mutex frame_pointer_maps_mutex_;
+  std::unordered_map<MapInfo*, bool> frame_pointer_maps_;
   ErrorData last_error_;
 };
 
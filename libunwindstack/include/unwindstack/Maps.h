@@ -101,12 +101,23 @@ class LocalUpdatableMaps : public Maps {
   LocalUpdatableMaps() : Maps() {}
   virtual ~LocalUpdatableMaps() = default;
 
+  // Re-reads the maps, keeping the existing MapInfo objects for entries that
+  // did not change. Maps that disappeared are kept alive in saved_maps_.
   bool Reparse();
 
+  // Reparse returns false without reading the maps if it is called again
+  // within interval_ns of the last reparse. Zero (the default) disables this.
+  void SetMinReparseInterval(uint64_t interval_ns);
+
   const std::string GetMapsFile() const override;
 
  protected:
   std::vector<std::unique_ptr<MapInfo>> saved_maps_;
+
+ private:
+  std::string maps_buffer_;
+  uint64_t min_reparse_interval_ns_ = 0;
+  uint64_t last_reparse_ns_ = 0;
 };
 
 class BufferMaps : public Maps {
@@ -571,6 +571,129 @@ TYPED_TEST_P(DwarfSectionImplTest, Log) {
   ASSERT_EQ("", GetFakeLogBuf());
 }
 
+TYPED_TEST_P(DwarfSectionImplTest, Compile_supported_locations) {
+  dwarf_loc_regs_t loc_regs;
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {8, 0x20}};
+  loc_regs[1] = DwarfLocation{DWARF_LOCATION_VAL_OFFSET, {0x100, 0}};
+  loc_regs[2] = DwarfLocation{DWARF_LOCATION_OFFSET, {0x50, 0}};
+  loc_regs[3] = DwarfLocation{DWARF_LOCATION_UNDEFINED, {0, 0}};
+  loc_regs[4] = DwarfLocation{DWARF_LOCATION_INVALID, {0, 0}};
+  ASSERT_TRUE(loc_regs.Compile());
+  EXPECT_TRUE(loc_regs.compiled.valid);
+  EXPECT_EQ(8U, loc_regs.compiled.cfa_reg);
+  EXPECT_EQ(0x20U, loc_regs.compiled.cfa_offset);
+  EXPECT_EQ(3U, loc_regs.compiled.num_rules);
+}
+
+TYPED_TEST_P(DwarfSectionImplTest, Compile_unsupported_locations) {
+  dwarf_loc_regs_t loc_regs;
+  ASSERT_FALSE(loc_regs.Compile());
+
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_VAL_EXPRESSION, {0x4, 0x5004}};
+  ASSERT_FALSE(loc_regs.Compile());
+
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {8, 0}};
+  loc_regs[1] = DwarfLocation{DWARF_LOCATION_REGISTER, {2, 0}};
+  ASSERT_FALSE(loc_regs.Compile());
+
+  loc_regs[1] = DwarfLocation{DWARF_LOCATION_EXPRESSION, {0x4, 0x5004}};
+  ASSERT_FALSE(loc_regs.Compile());
+
+  loc_regs.erase(1);
+  for (uint32_t reg = 0; reg <= DwarfCompiledRow::kMaxRules; reg++) {
+    loc_regs[reg] = DwarfLocation{DWARF_LOCATION_OFFSET, {reg * 8, 0}};
+  }
+  ASSERT_FALSE(loc_regs.Compile());
+  EXPECT_FALSE(loc_regs.compiled.valid);
+}
+
+TYPED_TEST_P(DwarfSectionImplTest, Eval_compiled_matches_generic) {
+  DwarfCie cie{.return_address_register = 5};
+  dwarf_loc_regs_t loc_regs;
+
+  if (sizeof(TypeParam) == sizeof(uint64_t)) {
+    this->memory_.SetData64(0x2150, 0x12345678abcdef00ULL);
+    this->memory_.SetData64(0x2160, 0x3000);
+  } else {
+    this->memory_.SetData32(0x2150, 0x12345678);
+    this->memory_.SetData32(0x2160, 0x3000);
+  }
+
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {8, 0x10}};
+  loc_regs[1] = DwarfLocation{DWARF_LOCATION_VAL_OFFSET, {0x100, 0}};
+  loc_regs[2] = DwarfLocation{DWARF_LOCATION_OFFSET, {0x40, 0}};
+  loc_regs[3] = DwarfLocation{DWARF_LOCATION_UNDEFINED, {0, 0}};
+  loc_regs[5] = DwarfLocation{DWARF_LOCATION_OFFSET, {0x50, 0}};
+  loc_regs[20] = DwarfLocation{DWARF_LOCATION_OFFSET, {0x50, 0}};
+
+  RegsImplFake<TypeParam> generic_regs(10);
+  generic_regs.set_pc(0x100);
+  generic_regs.set_sp(0x2000);
+  generic_regs[3] = 0x234;
+  generic_regs[8] = 0x2100;
+  RegsImplFake<TypeParam> compiled_regs(generic_regs);
+
+  bool generic_finished;
+  ASSERT_TRUE(
+      this->section_->Eval(&cie, &this->memory_, loc_regs, &generic_regs, &generic_finished));
+
+  ASSERT_TRUE(loc_regs.Compile());
+  bool compiled_finished;
+  ASSERT_TRUE(
+      this->section_->Eval(&cie, &this->memory_, loc_regs, &compiled_regs, &compiled_finished));
+
+  EXPECT_EQ(generic_finished, compiled_finished);
+  EXPECT_FALSE(compiled_finished);
+  EXPECT_EQ(0x3000U, compiled_regs.pc());
+  EXPECT_EQ(0x2110U, compiled_regs.sp());
+  for (size_t i = 0; i < 10; i++) {
+    EXPECT_EQ(generic_regs[i], compiled_regs[i]) << "Register " << i;
+  }
+  EXPECT_EQ(generic_regs.pc(), compiled_regs.pc());
+  EXPECT_EQ(generic_regs.sp(), compiled_regs.sp());
+}
+
+TYPED_TEST_P(DwarfSectionImplTest, Eval_compiled_return_address_undefined) {
+  DwarfCie cie{.return_address_register = 5};
+  RegsImplFake<TypeParam> regs(10);
+  dwarf_loc_regs_t loc_regs;
+
+  regs.set_pc(0x100);
+  regs.set_sp(0x2000);
+  regs[5] = 0x20;
+  regs[8] = 0x10;
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {8, 0}};
+  loc_regs[5] = DwarfLocation{DWARF_LOCATION_UNDEFINED, {0, 0}};
+  ASSERT_TRUE(loc_regs.Compile());
+  bool finished;
+  ASSERT_TRUE(this->section_->Eval(&cie, &this->memory_, loc_regs, &regs, &finished));
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(0U, regs.pc());
+  EXPECT_EQ(0x10U, regs.sp());
+}
+
+TYPED_TEST_P(DwarfSectionImplTest, Eval_compiled_errors) {
+  DwarfCie cie{.return_address_register = 5};
+  RegsImplFake<TypeParam> regs(10);
+  dwarf_loc_regs_t loc_regs;
+
+  regs.set_pc(0x100);
+  regs.set_sp(0x2000);
+  regs[8] = 0x5000;
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {20, 0}};
+  ASSERT_TRUE(loc_regs.Compile());
+  bool finished;
+  ASSERT_FALSE(this->section_->Eval(&cie, &this->memory_, loc_regs, &regs, &finished));
+  EXPECT_EQ(DWARF_ERROR_ILLEGAL_VALUE, this->section_->LastErrorCode());
+
+  loc_regs[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {8, 0}};
+  loc_regs[1] = DwarfLocation{DWARF_LOCATION_OFFSET, {0x10, 0}};
+  ASSERT_TRUE(loc_regs.Compile());
+  ASSERT_FALSE(this->section_->Eval(&cie, &this->memory_, loc_regs, &regs, &finished));
+  EXPECT_EQ(DWARF_ERROR_MEMORY_INVALID, this->section_->LastErrorCode());
+  EXPECT_EQ(0x5010U, this->section_->LastErrorAddress());
+}
+
 REGISTER_TYPED_TEST_SUITE_P(DwarfSectionImplTest, GetCieFromOffset_fail_should_not_cache,
                             GetFdeFromOffset_fail_should_not_cache, Eval_cfa_expr_eval_fail,
                             Eval_cfa_expr_no_stack, Eval_cfa_expr_is_register, Eval_cfa_expr,
@@ -580,7 +703,10 @@ REGISTER_TYPED_TEST_SUITE_P(DwarfSectionImplTest, GetCieFromOffset_fail_should_n
                             Eval_invalid_register, Eval_different_reg_locations,
                             Eval_return_address_undefined, Eval_pc_zero, Eval_return_address,
                             Eval_ignore_large_reg_loc, Eval_reg_expr, Eval_reg_val_expr,
-                            GetCfaLocationInfo_cie_not_cached, GetCfaLocationInfo_cie_cached, Log);
+                            Compile_supported_locations, Compile_unsupported_locations,
+                            Eval_compiled_matches_generic, Eval_compiled_return_address_undefined,
+                            Eval_compiled_errors, GetCfaLocationInfo_cie_not_cached,
+                            GetCfaLocationInfo_cie_cached, Log);
 
 typedef ::testing::Types<uint32_t, uint64_t> DwarfSectionImplTestTypes;
 INSTANTIATE_TYPED_TEST_SUITE_P(Libunwindstack, DwarfSectionImplTest, DwarfSectionImplTestTypes);
@@ -25,6 +25,7 @@
 
 #include <gtest/gtest.h>
 
+#include <android-base/file.h>
 #include <android-base/stringprintf.h>
 
 #include <unwindstack/LocalUnwinder.h>
@@ -132,6 +133,16 @@ extern "C" void LocalOuterFunction(LocalUnwinder* unwinder, bool unwind_through_
   LocalMiddleFunction(unwinder, unwind_through_signal);
 }
 
+extern "C" void FramePointerInnerFunction(LocalUnwinder* unwinder,
+                                          std::vector<LocalFrameData>* frame_info) {
+  ASSERT_TRUE(unwinder->Unwind(frame_info, 256));
+}
+
+extern "C" void FramePointerOuterFunction(LocalUnwinder* unwinder,
+                                          std::vector<LocalFrameData>* frame_info) {
+  FramePointerInnerFunction(unwinder, frame_info);
+}
+
 class LocalUnwinderTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -160,6 +171,37 @@ TEST_F(LocalUnwinderTest, local_multiple) {
   ASSERT_NO_FATAL_FAILURE(LocalOuterFunction(unwinder_.get(), true));
 }
 
+TEST_F(LocalUnwinderTest, local_frame_pointer) {
+#if defined(__aarch64__) || defined(__i386__) || defined(__x86_64__)
+  // This test is built with -fno-omit-frame-pointer.
+  unwinder_->SetFramePointerLibraries({android::base::GetExecutablePath()});
+  ASSERT_NO_FATAL_FAILURE(LocalOuterFunction(unwinder_.get(), false));
+#if !defined(__aarch64__)
+  // On arm64 the sp isn't known once a frame record has been followed, so
+  // the unwind can't continue through the signal frame.
+  ASSERT_NO_FATAL_FAILURE(LocalOuterFunction(unwinder_.get(), true));
+#endif
+
+  // Verify that frames of this executable were unwound using their frame records.
+  std::vector<LocalFrameData> frame_info;
+  ASSERT_NO_FATAL_FAILURE(FramePointerOuterFunction(unwinder_.get(), &frame_info));
+  std::vector<const char*> expected_function_names{"FramePointerOuterFunction",
+                                                   "FramePointerInnerFunction"};
+  for (const auto& frame : frame_info) {
+    if (frame.function_name == expected_function_names.back()) {
+      EXPECT_TRUE(frame.frame_pointer_step) << frame.function_name;
+      expected_function_names.pop_back();
+      if (expected_function_names.empty()) {
+        break;
+      }
+    }
+  }
+  ASSERT_TRUE(expected_function_names.empty()) << ErrorMsg(expected_function_names, frame_info);
+#else
+  GTEST_SKIP() << "Frame pointer unwinding is not supported on this architecture";
+#endif
+}
+
 // This test verifies that doing an unwind before and after a dlopen
 // works. It's verifying that the maps read during the first unwind
 // do not cause a problem when doing the unwind using the code in
@@ -370,4 +370,73 @@ TEST_F(LocalUpdatableMapsTest, add_map_prev_real_name_updated) {
   EXPECT_EQ(maps_.Get(4), map_info->prev_real_map);
 }
 
+TEST_F(LocalUpdatableMapsTest, unchanged_maps_reuse_objects) {
+  MapInfo* map_info1 = maps_.Get(0);
+  MapInfo* map_info2 = maps_.Get(1);
+
+  TemporaryFile tf;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000 00:00 0\n"
+                                       "3000-4000 r-xp 00000 00:00 0\n"
+                                       "5000-6000 r-xp 00000 00:00 0\n"
+                                       "8000-9000 r-xp 00000 00:00 0\n",
+                                       tf.path));
+
+  maps_.TestSetMapsFile(tf.path);
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(4U, maps_.Total());
+  EXPECT_EQ(0U, maps_.TestGetSavedMaps().size());
+
+  EXPECT_EQ(map_info1, maps_.Get(1));
+  EXPECT_EQ(map_info2, maps_.Get(3));
+
+  MapInfo* map_info = maps_.Get(2);
+  ASSERT_TRUE(map_info != nullptr);
+  EXPECT_EQ(0x5000U, map_info->start);
+  EXPECT_EQ(0x6000U, map_info->end);
+  EXPECT_EQ(map_info1, map_info->prev_map);
+  EXPECT_EQ(map_info1, map_info->prev_real_map);
+}
+
+TEST_F(LocalUpdatableMapsTest, failed_parse_keeps_maps) {
+  MapInfo* map_info1 = maps_.Get(0);
+  MapInfo* map_info2 = maps_.Get(1);
+
+  TemporaryFile tf;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000 00:00 0\n"
+                                       "3000-4000 bad\n",
+                                       tf.path));
+
+  maps_.TestSetMapsFile(tf.path);
+  ASSERT_FALSE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  EXPECT_EQ(map_info1, maps_.Get(0));
+  EXPECT_EQ(map_info2, maps_.Get(1));
+  EXPECT_EQ(0U, maps_.TestGetSavedMaps().size());
+}
+
+TEST_F(LocalUpdatableMapsTest, min_reparse_interval) {
+  TemporaryFile tf;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r-xp 00000 00:00 0\n"
+                                       "8000-9000 r-xp 00000 00:00 0\n"
+                                       "a000-f000 r-xp 00000 00:00 0\n",
+                                       tf.path));
+  maps_.TestSetMapsFile(tf.path);
+
+  // An hour is long enough that the second reparse is always rate limited.
+  maps_.SetMinReparseInterval(3600ULL * 1000000000ULL);
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(3U, maps_.Total());
+
+  ASSERT_TRUE(android::base::WriteStringToFile("3000-4000 r-xp 00000 00:00 0\n", tf.path));
+  ASSERT_FALSE(maps_.Reparse());
+  ASSERT_EQ(3U, maps_.Total());
+
+  maps_.SetMinReparseInterval(0);
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(1U, maps_.Total());
+}
+
 }  // namespace unwindstack
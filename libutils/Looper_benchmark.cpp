@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utils/Looper.h>
+#include <vector>
+
+using android::Looper;
+using android::Message;
+using android::MessageHandler;
+using android::sp;
+
+namespace {
+
+class NullMessageHandler : public MessageHandler {
+  public:
+    void handleMessage(const Message&) override {}
+};
+
+int NullCallback(int, int, void*) {
+    return 1;
+}
+
+}  // namespace
+
+// Registers and unregisters one fd while state.range(0) other fds are registered.
+void BM_looper_add_remove_fd(benchmark::State& state) {
+    sp<Looper> looper = new Looper(false);
+    std::vector<int> fds;
+    for (int i = 0; i < state.range(0); i++) {
+        int fd = eventfd(0, EFD_CLOEXEC);
+        fds.push_back(fd);
+        looper->addFd(fd, Looper::POLL_CALLBACK, Looper::EVENT_INPUT, NullCallback, nullptr);
+    }
+
+    int fd = eventfd(0, EFD_CLOEXEC);
+    while (state.KeepRunning()) {
+        looper->addFd(fd, Looper::POLL_CALLBACK, Looper::EVENT_INPUT, NullCallback, nullptr);
+        looper->removeFd(fd);
+    }
+
+    close(fd);
+    for (int registered_fd : fds) {
+        looper->removeFd(registered_fd);
+        close(registered_fd);
+    }
+}
+BENCHMARK(BM_looper_add_remove_fd)->Arg(1)->Arg(100)->Arg(1000);
+
+// Queues state.range(0) delayed messages out of order, then removes them all.
+void BM_looper_send_message_delayed(benchmark::State& state) {
+    sp<Looper> looper = new Looper(false);
+    sp<MessageHandler> handler = new NullMessageHandler();
+    while (state.KeepRunning()) {
+        for (int i = 0; i < state.range(0); i++) {
+            // Far enough in the future to never be delivered, in a scattered order.
+            nsecs_t delay = s2ns(100) + (i * 7919) % state.range(0);
+            looper->sendMessageDelayed(delay, handler, Message(i));
+        }
+        looper->removeMessages(handler);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_looper_send_message_delayed)->Arg(10)->Arg(100)->Arg(1000);
+
+// Queues state.range(0) messages that are already due and delivers them.
+void BM_looper_dispatch_messages(benchmark::State& state) {
+    sp<Looper> looper = new Looper(false);
+    sp<MessageHandler> handler = new NullMessageHandler();
+    while (state.KeepRunning()) {
+        for (int i = 0; i < state.range(0); i++) {
+            looper->sendMessage(handler, Message(i));
+        }
+        looper->pollAll(0);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_looper_dispatch_messages)->Arg(1)->Arg(100);
@@ -744,4 +744,28 @@ TEST_F(LooperTest, RemoveMessage_WhenRemovingSomeMessagesForHandler_ShouldRemove
             << "no more messages to handle";
 }
 
+TEST_F(LooperTest, SendMessageAtTime_WhenSentOutOfOrder_ShouldInvokeHandlersByTimeThenSendOrder) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    sp<StubMessageHandler> handler = new StubMessageHandler();
+    mLooper->sendMessageAtTime(now - ms2ns(10), handler, Message(MSG_TEST3));
+    mLooper->sendMessageAtTime(now - ms2ns(30), handler, Message(MSG_TEST1));
+    mLooper->sendMessageAtTime(now - ms2ns(20), handler, Message(MSG_TEST2));
+    mLooper->sendMessageAtTime(now - ms2ns(10), handler, Message(MSG_TEST4));
+
+    int result = mLooper->pollOnce(0);
+
+    EXPECT_EQ(Looper::POLL_CALLBACK, result)
+            << "pollOnce result should be Looper::POLL_CALLBACK because messages were sent";
+    EXPECT_EQ(size_t(4), handler->messages.size())
+            << "handled all messages";
+    EXPECT_EQ(MSG_TEST1, handler->messages[0].what)
+            << "handled earliest message first";
+    EXPECT_EQ(MSG_TEST2, handler->messages[1].what)
+            << "handled message";
+    EXPECT_EQ(MSG_TEST3, handler->messages[2].what)
+            << "handled messages with the same time in the order they were sent";
+    EXPECT_EQ(MSG_TEST4, handler->messages[3].what)
+            << "handled messages with the same time in the order they were sent";
+}
+
 } // namespace android
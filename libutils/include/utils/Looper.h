@@ -26,6 +26,9 @@
 
 #include <android-base/unique_fd.h>
 
+#include <unordered_map>
+#include <vector>
+
 namespace android {
 
 /*
@@ -436,23 +439,34 @@ private:
     };
 
     struct MessageEnvelope {
-        MessageEnvelope() : uptime(0) { }
+        MessageEnvelope() : uptime(0), seq(0) { }
 
-        MessageEnvelope(nsecs_t u, const sp<MessageHandler> h,
-                const Message& m) : uptime(u), handler(h), message(m) {
+        MessageEnvelope(nsecs_t u, uint64_t s, const sp<MessageHandler> h,
+                const Message& m) : uptime(u), seq(s), handler(h), message(m) {
         }
 
         nsecs_t uptime;
+        // Orders messages with the same uptime by the order in which they were sent.
+        uint64_t seq;
         sp<MessageHandler> handler;
         Message message;
     };
 
+    // Heap ordering that puts the earliest message at the front of mMessageEnvelopes.
+    struct MessageEnvelopeLater {
+        bool operator()(const MessageEnvelope& lhs, const MessageEnvelope& rhs) const {
+            return lhs.uptime != rhs.uptime ? lhs.uptime > rhs.uptime : lhs.seq > rhs.seq;
+        }
+    };
+
     const bool mAllowNonCallbacks; // immutable
 
     android::base::unique_fd mWakeEventFd;  // immutable
     Mutex mLock;
 
-    Vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    // Binary heap ordered by MessageEnvelopeLater.
+    std::vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    uint64_t mNextMessageSeq; // guarded by mLock
     bool mSendingMessage; // guarded by mLock
 
     // Whether we are currently waiting for work.  Not protected by a lock,
@@ -462,8 +476,8 @@ private:
     android::base::unique_fd mEpollFd;  // guarded by mLock but only modified on the looper thread
     bool mEpollRebuildRequired; // guarded by mLock
 
-    // Locked list of file descriptor monitoring requests.
-    KeyedVector<int, Request> mRequests;  // guarded by mLock
+    // Locked map of file descriptor monitoring requests.
+    std::unordered_map<int, Request> mRequests;  // guarded by mLock
     int mNextRequestSeq;
 
     // This state is only used privately by pollOnce and does not require a lock since
@@ -478,6 +492,7 @@ private:
     void pushResponse(int events, const Request& request);
     void rebuildEpollLocked();
     void scheduleEpollRebuildLocked();
+    void removeMessagesLocked(const sp<MessageHandler>& handler, bool matchWhat, int what);
 
     static void initTLSKey();
     static void threadDestructor(void *st);